@@ -1,17 +1,98 @@
+#define _GNU_SOURCE
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <sys/socket.h>
 #include <netinet/in.h>
 #include <arpa/inet.h>
 #include <string.h>
+#include <strings.h>
 
 #define BUFF_SIZE 1024
 #define PORT 1234
 #define HOST "127.0.0.1"
+/* Pipelined requests in flight, the server stops reading past a few dozen unanswered */
+#define WINDOW 32
+
+/*
+  Fetches path count times over one kept alive connection and prints the
+  responses. With --pipeline up to WINDOW requests are sent ahead of the
+  responses read.
+
+  usage: client [path] [count] [--pipeline]
+*/
+
+typedef struct Response
+{
+  char *data;
+  size_t length;
+  size_t capacity;
+} Response;
+
+/* Sends all of data, however many calls that takes. Returns -1 with errno set on failure */
+int sendAll(int clientSocket, const char *data, size_t length)
+{
+  while (length > 0)
+  {
+    ssize_t bytesSent = send(clientSocket, data, length, 0);
+
+    if (bytesSent < 0)
+      return -1;
+
+    data += bytesSent;
+
+    length -= bytesSent;
+  }
+
+  return 0;
+}
+
+/* Reads until buffer holds a whole response, returns its length or 0 when the server closed first */
+size_t readResponse(int clientSocket, Response *buffer)
+{
+  while (1)
+  {
+    char *headerEnd = memmem(buffer->data, buffer->length, "\r\n\r\n", 4);
+
+    if (headerEnd != NULL)
+    {
+      size_t headerLength = headerEnd + 4 - buffer->data;
+
+      size_t contentLength = 0;
+
+      for (char *line = buffer->data; line < headerEnd; line = strstr(line, "\r\n") + 2)
+        if (strncasecmp(line, "Content-Length:", 15) == 0)
+          contentLength = strtoul(line + 15, NULL, 10);
+
+      if (buffer->length >= headerLength + contentLength)
+        return headerLength + contentLength;
+    }
+
+    if (buffer->capacity - buffer->length < BUFF_SIZE)
+    {
+      buffer->capacity = buffer->capacity * 2 + BUFF_SIZE;
+
+      buffer->data = realloc(buffer->data, buffer->capacity + 1);
+    }
+
+    ssize_t bytesRecieved = recv(clientSocket, buffer->data + buffer->length, buffer->capacity - buffer->length, 0);
+
+    if (bytesRecieved <= 0)
+      return 0;
+
+    buffer->length += bytesRecieved;
+
+    buffer->data[buffer->length] = '\0';
+  }
+}
 
 int main(int argc, char *argv[])
 {
-  char *message = argv[1];
+  char *path = argc > 1 ? argv[1] : "/";
+
+  int count = argc > 2 ? atoi(argv[2]) : 1;
+
+  int pipeline = argc > 3 && strcmp(argv[3], "--pipeline") == 0;
 
   int clientSocket;
 
@@ -26,7 +107,7 @@ int main(int argc, char *argv[])
     return EXIT_FAILURE;
   }
 
-  char *host = "127.0.0.1";
+  char *host = HOST;
 
   clientAddress.sin_family = AF_INET;
   clientAddress.sin_port = htons(PORT);
@@ -40,23 +121,48 @@ int main(int argc, char *argv[])
     return EXIT_FAILURE;
   }
 
-  char *request;
+  char request[BUFF_SIZE];
+
+  int requestLength = snprintf(request, sizeof(request), "GET %s HTTP/1.1\r\nHost: localhost\r\n\r\n", path);
+
+  Response buffer = {malloc(BUFF_SIZE + 1), 0, BUFF_SIZE};
 
-  request = "GET / HTTP/1.1\r\nHost: localhost\r\n\r\n";
+  buffer.data[0] = '\0';
 
-  ssize_t bytesSend = send(clientSocket, request, strlen(request), 0);
+  int sent = 0;
+
+  for (int received = 0; received < count; received++)
+  {
+    /* Pipelined requests go out a window ahead of the responses, otherwise one per response */
+    while (sent < count && sent - received < (pipeline ? WINDOW : 1))
+    {
+      if (sendAll(clientSocket, request, requestLength) < 0)
+      {
+        perror("Could not send request\n");
 
-  printf("%lu\n", bytesSend);
+        return EXIT_FAILURE;
+      }
 
-  char buffer[BUFF_SIZE];
+      sent++;
+    }
 
-  ssize_t bytesRecieved = recv(clientSocket, buffer, BUFF_SIZE, 0);
+    size_t length = readResponse(clientSocket, &buffer);
 
-  printf("%lu\n", bytesRecieved);
+    if (length == 0)
+    {
+      fprintf(stderr, "Connection closed after %d responses\n", received);
 
-  buffer[bytesRecieved] = '\0';
+      return EXIT_FAILURE;
+    }
+
+    printf("%.*s\n", (int)length, buffer.data);
+
+    memmove(buffer.data, buffer.data + length, buffer.length - length);
+
+    buffer.length -= length;
+  }
 
-  printf("%s\n", buffer);
+  free(buffer.data);
 
   return 0;
-}
\ No newline at end of file
+}
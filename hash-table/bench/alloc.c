@@ -0,0 +1,73 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+
+#include "hash-table.h"
+#include "bench.h"
+
+/*
+  Insert, churn and destroy cost with entries and keys from malloc against
+  the table owned arena. The churn phase removes every other key and adds
+  as many new ones, so the arena free lists get reused.
+
+  usage: bench-alloc [keys]
+*/
+
+static void run(const char *name, HashTableType type, bool arena, char **keys, char **extra, size_t count)
+{
+  HashTableOptions options = {.type = type, .arena = arena};
+
+  HashTable *ht = hashTableCreateWithOptions(16, &options);
+
+  uint64_t start = benchNow();
+
+  for (size_t i = 0; i < count; i++)
+    hashTableAdd(ht, keys[i], NULL);
+
+  uint64_t inserted = benchNow();
+
+  for (size_t i = 0; i < count; i += 2)
+  {
+    hashTableRemove(ht, keys[i]);
+
+    hashTableAdd(ht, extra[i], NULL);
+  }
+
+  uint64_t churned = benchNow();
+
+  hashTableDestroy(ht);
+
+  uint64_t destroyed = benchNow();
+
+  printf("%-16s %12.2f %12.2f %12.2f\n", name,
+         count / ((inserted - start) / 1e3),
+         count / ((churned - inserted) / 1e3),
+         (destroyed - churned) / 1e6);
+}
+
+int main(int argc, char *argv[])
+{
+  size_t count = argc > 1 ? (size_t)atol(argv[1]) : 1000000;
+
+  char **keys = benchKeys("key-", count);
+
+  char **extra = benchKeys("extra-", count);
+
+  printf("%zu keys\n\n", count);
+
+  printf("%-16s %12s %12s %12s\n", "table", "insert Mop/s", "churn Mop/s", "destroy ms");
+
+  run("chained malloc", HashTableChained, false, keys, extra, count);
+
+  run("chained arena", HashTableChained, true, keys, extra, count);
+
+  run("swiss malloc", HashTableSwiss, false, keys, extra, count);
+
+  run("swiss arena", HashTableSwiss, true, keys, extra, count);
+
+  benchFreeKeys(keys, count);
+
+  benchFreeKeys(extra, count);
+
+  return 0;
+}
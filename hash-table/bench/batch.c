@@ -0,0 +1,141 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+
+#include "hash-table.h"
+#include "bench.h"
+
+/*
+  hashTableGetMany and hashTableAddMany against one call per key, on a
+  table much larger than the last level cache so every lookup misses.
+  Batch 1 is the plain hashTableGet / hashTableAdd loop. Tables are sized
+  up front so the add column does not include resizes.
+
+  usage: bench-batch [log2 keys]
+*/
+
+#define LOOKUPS 4000000
+
+static volatile uintptr_t sink;
+
+static double getNs(HashTable *ht, char **keys, size_t count, size_t batch)
+{
+  void *values[64];
+
+  uintptr_t sum = 0;
+
+  size_t done = 0;
+
+  uint64_t start = benchNow();
+
+  while (done < LOOKUPS)
+  {
+    for (size_t i = 0; i + batch <= count && done < LOOKUPS; i += batch, done += batch)
+    {
+      if (batch == 1)
+      {
+        sum += (uintptr_t)hashTableGet(ht, keys[i]);
+
+        continue;
+      }
+
+      hashTableGetMany(ht, (const char *const *)keys + i, batch, values);
+
+      for (size_t j = 0; j < batch; j++)
+        sum += (uintptr_t)values[j];
+    }
+  }
+
+  uint64_t elapsed = benchNow() - start;
+
+  sink = sum;
+
+  return (double)elapsed / done;
+}
+
+static double addNs(HashTableType type, char **keys, void **values, size_t count, size_t batch)
+{
+  HashTableOptions options = {.type = type};
+
+  /* The chained table resizes above 0.75, the swiss table above 7/8 */
+  HashTable *ht = hashTableCreateWithOptions((uint32_t)(count / 0.75) + 1, &options);
+
+  uint64_t start = benchNow();
+
+  for (size_t i = 0; i + batch <= count; i += batch)
+  {
+    if (batch == 1)
+      hashTableAdd(ht, keys[i], values[i]);
+    else
+      hashTableAddMany(ht, (const char *const *)keys + i, values + i, batch);
+  }
+
+  uint64_t elapsed = benchNow() - start;
+
+  hashTableDestroy(ht);
+
+  return (double)elapsed / count;
+}
+
+static void run(const char *name, HashTableType type, char **keys, void **values, size_t count)
+{
+  const size_t batches[] = {1, 2, 4, 8, 16, 32, 64};
+
+  HashTableOptions options = {.type = type};
+
+  HashTable *ht = hashTableCreateWithOptions((uint32_t)count, &options);
+
+  for (size_t i = 0; i < count; i++)
+    hashTableAdd(ht, keys[i], values[i]);
+
+  /* Lookups in an order unrelated to the insertion order */
+  benchShuffle(keys, count, 7);
+
+  printf("%s\n", name);
+
+  printf("%6s %12s %12s %10s\n", "batch", "get ns/key", "add ns/key", "get speedup");
+
+  double base = 0;
+
+  for (size_t b = 0; b < sizeof(batches) / sizeof(batches[0]); b++)
+  {
+    double get = getNs(ht, keys, count, batches[b]);
+
+    double add = addNs(type, keys, values, count, batches[b]);
+
+    if (b == 0)
+      base = get;
+
+    printf("%6zu %12.1f %12.1f %10.2fx\n", batches[b], get, add, base / get);
+  }
+
+  printf("\n");
+
+  hashTableDestroy(ht);
+}
+
+int main(int argc, char *argv[])
+{
+  uint32_t bits = argc > 1 ? (uint32_t)atoi(argv[1]) : 22;
+
+  size_t count = (size_t)1 << bits;
+
+  char **keys = benchKeys("key-", count);
+
+  void **values = malloc(sizeof(void *) * count);
+
+  for (size_t i = 0; i < count; i++)
+    values[i] = (void *)(uintptr_t)(i + 1);
+
+  printf("%zu keys\n\n", count);
+
+  run("chained", HashTableChained, keys, values, count);
+
+  run("swiss", HashTableSwiss, keys, values, count);
+
+  free(values);
+
+  benchFreeKeys(keys, count);
+
+  return 0;
+}
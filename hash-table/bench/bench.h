@@ -0,0 +1,75 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <time.h>
+
+/* Helpers shared by the benchmark programs */
+
+static inline uint64_t benchNow(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+
+  return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+static inline uint64_t benchRandom(uint64_t *state)
+{
+  /* splitmix64 */
+  uint64_t z = (*state += 0x9E3779B97F4A7C15ULL);
+
+  z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+
+  z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+
+  return z ^ (z >> 31);
+}
+
+static inline void benchShuffle(char **keys, size_t count, uint64_t seed)
+{
+  for (size_t i = count; i > 1; i--)
+  {
+    size_t j = benchRandom(&seed) % i;
+
+    char *tmp = keys[i - 1];
+
+    keys[i - 1] = keys[j];
+
+    keys[j] = tmp;
+  }
+}
+
+/*
+  Returns count keys "<prefix><n>", all stored in one block that is
+  remembered past the end of the array so shuffling does not lose it
+*/
+static inline char **benchKeys(const char *prefix, size_t count)
+{
+  char **keys = malloc(sizeof(char *) * (count + 1));
+
+  char *block = malloc(count * 32);
+
+  keys[count] = block;
+
+  for (size_t i = 0; i < count; i++)
+  {
+    keys[i] = block + i * 32;
+
+    snprintf(keys[i], 32, "%s%zu", prefix, i);
+  }
+
+  return keys;
+}
+
+static inline void benchFreeKeys(char **keys, size_t count)
+{
+  free(keys[count]);
+
+  free(keys);
+}
+
+#endif
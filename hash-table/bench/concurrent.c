@@ -0,0 +1,201 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#include "hash-table.h"
+#include "concurrent-hash-table.h"
+#include "bench.h"
+
+/*
+  Throughput of the concurrent table against a HashTable behind one global
+  mutex, for a read-mostly and a 50/50 workload from 1 to N threads. Writes
+  are split evenly between adds and removes over a key space that starts
+  half full, so the table size stays about the same.
+
+  usage: bench-concurrent [milliseconds per run] [max threads]
+*/
+
+#define KEYS (1 << 20)
+
+typedef struct Shared
+{
+  ConcurrentHashTable *cht;
+  HashTable *ht;
+  pthread_mutex_t lock;
+  char **keys;
+  uint32_t readPercent;
+  atomic_bool stop;
+} Shared;
+
+typedef struct Worker
+{
+  pthread_t thread;
+  Shared *shared;
+  uint64_t seed;
+  uint64_t ops;
+} Worker;
+
+static volatile uintptr_t sink;
+
+static void *concurrentWorker(void *arg)
+{
+  Worker *w = arg;
+
+  Shared *s = w->shared;
+
+  uintptr_t sum = 0;
+
+  while (!atomic_load_explicit(&s->stop, memory_order_relaxed))
+  {
+    uint64_t r = benchRandom(&w->seed);
+
+    char *key = s->keys[(r >> 8) % KEYS];
+
+    uint32_t roll = r % 100;
+
+    if (roll < s->readPercent)
+      sum += (uintptr_t)concurrentHashTableGet(s->cht, key);
+    else if (roll & 1)
+      concurrentHashTableAdd(s->cht, key, key);
+    else
+      concurrentHashTableRemove(s->cht, key);
+
+    w->ops++;
+  }
+
+  sink = sum;
+
+  return NULL;
+}
+
+static void *mutexWorker(void *arg)
+{
+  Worker *w = arg;
+
+  Shared *s = w->shared;
+
+  uintptr_t sum = 0;
+
+  while (!atomic_load_explicit(&s->stop, memory_order_relaxed))
+  {
+    uint64_t r = benchRandom(&w->seed);
+
+    char *key = s->keys[(r >> 8) % KEYS];
+
+    uint32_t roll = r % 100;
+
+    pthread_mutex_lock(&s->lock);
+
+    if (roll < s->readPercent)
+      sum += (uintptr_t)hashTableGet(s->ht, key);
+    else if (roll & 1)
+      hashTableAdd(s->ht, key, key);
+    else
+      hashTableRemove(s->ht, key);
+
+    pthread_mutex_unlock(&s->lock);
+
+    w->ops++;
+  }
+
+  sink = sum;
+
+  return NULL;
+}
+
+static double run(Shared *s, void *(*worker)(void *), uint32_t threads, uint32_t millis)
+{
+  Worker *workers = calloc(threads, sizeof(Worker));
+
+  atomic_store(&s->stop, false);
+
+  for (uint32_t i = 0; i < threads; i++)
+  {
+    workers[i].shared = s;
+
+    workers[i].seed = i + 1;
+
+    pthread_create(&workers[i].thread, NULL, worker, &workers[i]);
+  }
+
+  uint64_t start = benchNow();
+
+  usleep(millis * 1000);
+
+  atomic_store(&s->stop, true);
+
+  uint64_t ops = 0;
+
+  for (uint32_t i = 0; i < threads; i++)
+  {
+    pthread_join(workers[i].thread, NULL);
+
+    ops += workers[i].ops;
+  }
+
+  uint64_t elapsed = benchNow() - start;
+
+  free(workers);
+
+  return ops * 1e3 / elapsed;
+}
+
+int main(int argc, char *argv[])
+{
+  uint32_t millis = argc > 1 ? (uint32_t)atoi(argv[1]) : 500;
+
+  uint32_t maxThreads = argc > 2 ? (uint32_t)atoi(argv[2]) : (uint32_t)sysconf(_SC_NPROCESSORS_ONLN);
+
+  const uint32_t readPercents[] = {90, 50};
+
+  Shared s;
+
+  s.keys = benchKeys("key-", KEYS);
+
+  pthread_mutex_init(&s.lock, NULL);
+
+  printf("%u keys, Mops/s\n\n", KEYS);
+
+  printf("%8s %8s %12s %12s\n", "reads", "threads", "concurrent", "mutex");
+
+  for (size_t i = 0; i < sizeof(readPercents) / sizeof(readPercents[0]); i++)
+  {
+    s.readPercent = readPercents[i];
+
+    s.cht = concurrentHashTableCreate(KEYS, NULL);
+
+    s.ht = hashTableCreate(KEYS, NULL);
+
+    for (uint32_t k = 0; k < KEYS; k += 2)
+    {
+      concurrentHashTableAdd(s.cht, s.keys[k], s.keys[k]);
+
+      hashTableAdd(s.ht, s.keys[k], s.keys[k]);
+    }
+
+    for (uint32_t threads = 1;; threads = threads * 2 > maxThreads ? maxThreads : threads * 2)
+    {
+      double concurrent = run(&s, concurrentWorker, threads, millis);
+
+      double mutex = run(&s, mutexWorker, threads, millis);
+
+      printf("%7u%% %8u %12.2f %12.2f\n", s.readPercent, threads, concurrent, mutex);
+
+      if (threads == maxThreads)
+        break;
+    }
+
+    concurrentHashTableDestroy(s.cht);
+
+    hashTableDestroy(s.ht);
+  }
+
+  pthread_mutex_destroy(&s.lock);
+
+  benchFreeKeys(s.keys, KEYS);
+
+  return 0;
+}
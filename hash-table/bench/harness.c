@@ -0,0 +1,374 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+
+#include "hash-table.h"
+#include "bench.h"
+
+/*
+  Runs the same generated operation stream against every table layout and
+  reports throughput, the probe length histogram of hits and misses after
+  the run and the bytes held per entry. Probe lengths count what a layout
+  looks at: entries for chained, groups for swiss, slots for robin hood
+  and the mapped snapshot, buckets for cuckoo.
+
+  Workloads, over a universe of 2 * keys keys, or ops keys when that is
+  more so every add of the insert workload has a new key:
+    uniform  lookups of present keys, every key equally likely
+    zipf     lookups of present keys, key ranks drawn with exponent -s
+    insert   starts empty, 80% adds of new keys, 20% lookups
+    delete   60% removes, 20% adds, 20% lookups over the whole universe
+    miss     90% lookups of absent keys, 10% of present ones
+
+  usage: bench-harness [-w workload|all] [-t table|all] [-n keys] [-o ops] [-s zipf exponent]
+*/
+
+typedef enum
+{
+  OpGet,
+  OpAdd,
+  OpRemove
+} OpKind;
+
+typedef struct Op
+{
+  uint32_t kind;
+  uint32_t key;
+} Op;
+
+typedef struct Workload
+{
+  const char *name;
+  /* Keys 0 .. prefill - 1 are added before the clock starts */
+  size_t prefill;
+  Op *ops;
+  size_t count;
+} Workload;
+
+typedef struct Table
+{
+  const char *name;
+  HashTableType type;
+} Table;
+
+static const Table tables[] = {
+    {"chained", HashTableChained},
+    {"swiss", HashTableSwiss},
+    {"robinhood", HashTableRobinHood},
+    {"cuckoo", HashTableCuckoo},
+};
+
+static const char *workloads[] = {"uniform", "zipf", "insert", "delete", "miss"};
+
+/* Upper bounds of the histogram columns, the last one takes the rest */
+static const uint32_t histogramBounds[] = {1, 2, 3, 4, 8, 16, UINT32_MAX};
+
+#define HISTOGRAM_COLUMNS (sizeof(histogramBounds) / sizeof(histogramBounds[0]))
+
+#define HISTOGRAM_SAMPLES 100000
+
+static volatile uintptr_t sink;
+
+/* Inverse CDF table for ranks 1 .. count with probability proportional to rank^-s */
+static double *zipfTable(size_t count, double s)
+{
+  double *cdf = malloc(sizeof(double) * count);
+
+  double sum = 0;
+
+  for (size_t i = 0; i < count; i++)
+  {
+    sum += 1.0 / pow((double)(i + 1), s);
+
+    cdf[i] = sum;
+  }
+
+  for (size_t i = 0; i < count; i++)
+    cdf[i] /= sum;
+
+  return cdf;
+}
+
+static size_t zipfDraw(const double *cdf, size_t count, uint64_t *state)
+{
+  double u = (double)(benchRandom(state) >> 11) / (double)(1ULL << 53);
+
+  size_t low = 0;
+
+  size_t high = count - 1;
+
+  while (low < high)
+  {
+    size_t mid = (low + high) / 2;
+
+    if (cdf[mid] < u)
+      low = mid + 1;
+    else
+      high = mid;
+  }
+
+  return low;
+}
+
+static Workload makeWorkload(const char *name, size_t keys, size_t universe, size_t ops, double s)
+{
+  Workload w = {.name = name, .prefill = keys, .ops = malloc(sizeof(Op) * ops), .count = ops};
+
+  uint64_t state = 12345;
+
+  if (strcmp(name, "uniform") == 0)
+  {
+    for (size_t i = 0; i < ops; i++)
+      w.ops[i] = (Op){OpGet, (uint32_t)(benchRandom(&state) % keys)};
+  }
+  else if (strcmp(name, "zipf") == 0)
+  {
+    double *cdf = zipfTable(keys, s);
+
+    /* Hot ranks land on random keys, not on the first ones inserted */
+    uint32_t *rankToKey = malloc(sizeof(uint32_t) * keys);
+
+    for (size_t i = 0; i < keys; i++)
+      rankToKey[i] = (uint32_t)i;
+
+    for (size_t i = keys; i > 1; i--)
+    {
+      size_t j = benchRandom(&state) % i;
+
+      uint32_t tmp = rankToKey[i - 1];
+
+      rankToKey[i - 1] = rankToKey[j];
+
+      rankToKey[j] = tmp;
+    }
+
+    for (size_t i = 0; i < ops; i++)
+      w.ops[i] = (Op){OpGet, rankToKey[zipfDraw(cdf, keys, &state)]};
+
+    free(rankToKey);
+
+    free(cdf);
+  }
+  else if (strcmp(name, "insert") == 0)
+  {
+    size_t next = 0;
+
+    w.prefill = 0;
+
+    for (size_t i = 0; i < ops; i++)
+    {
+      /* Lookups are of keys added before them, so the first op has to be an add */
+      if (next < universe && (next == 0 || benchRandom(&state) % 10 < 8))
+        w.ops[i] = (Op){OpAdd, (uint32_t)next++};
+      else
+        w.ops[i] = (Op){OpGet, (uint32_t)(benchRandom(&state) % next)};
+    }
+  }
+  else if (strcmp(name, "delete") == 0)
+  {
+    for (size_t i = 0; i < ops; i++)
+    {
+      uint64_t roll = benchRandom(&state) % 10;
+
+      uint32_t key = (uint32_t)(benchRandom(&state) % (keys * 2));
+
+      w.ops[i] = (Op){roll < 6 ? OpRemove : roll < 8 ? OpAdd : OpGet, key};
+    }
+  }
+  else
+  {
+    for (size_t i = 0; i < ops; i++)
+    {
+      /* Keys from keys on are never added in this workload */
+      uint32_t key = benchRandom(&state) % 10 == 0 ? benchRandom(&state) % keys : keys + benchRandom(&state) % keys;
+
+      w.ops[i] = (Op){OpGet, key};
+    }
+  }
+
+  return w;
+}
+
+static void printHistogram(const char *label, HashTable *ht, char **keys, size_t from, size_t to)
+{
+  uint64_t counts[HISTOGRAM_COLUMNS] = {0};
+
+  size_t samples = 0;
+
+  size_t step = (to - from) / HISTOGRAM_SAMPLES + 1;
+
+  for (size_t i = from; i < to; i += step, samples++)
+  {
+    uint32_t probes = hashTableProbeLength(ht, keys[i]);
+
+    size_t column = 0;
+
+    while (probes > histogramBounds[column])
+      column++;
+
+    counts[column]++;
+  }
+
+  printf("  %-6s", label);
+
+  for (size_t c = 0; c < HISTOGRAM_COLUMNS; c++)
+    printf(" %6.1f%%", samples == 0 ? 0.0 : 100.0 * counts[c] / samples);
+
+  printf("\n");
+}
+
+static void run(const Table *table, const Workload *w, char **keys, size_t universe)
+{
+  HashTableOptions options = {.type = table->type};
+
+  HashTable *ht = hashTableCreateWithOptions(8, &options);
+
+  for (size_t i = 0; i < w->prefill; i++)
+    hashTableAdd(ht, keys[i], (void *)(uintptr_t)(i + 1));
+
+  uintptr_t sum = 0;
+
+  uint64_t start = benchNow();
+
+  for (size_t i = 0; i < w->count; i++)
+  {
+    const Op *op = &w->ops[i];
+
+    switch (op->kind)
+    {
+    case OpGet:
+      sum += (uintptr_t)hashTableGet(ht, keys[op->key]);
+      break;
+    case OpAdd:
+      sum += hashTableAdd(ht, keys[op->key], (void *)(uintptr_t)(op->key + 1));
+      break;
+    case OpRemove:
+      sum += hashTableRemove(ht, keys[op->key]);
+      break;
+    }
+  }
+
+  uint64_t elapsed = benchNow() - start;
+
+  sink = sum;
+
+  uint32_t count = hashTableCount(ht);
+
+  size_t bytes = hashTableMemoryUsage(ht);
+
+  printf("%-9s %8s %10.2f Mops/s %9u entries %8.1f bytes/entry\n", w->name, table->name,
+         w->count / (elapsed / 1000.0), count, count == 0 ? 0.0 : (double)bytes / count);
+
+  HashTableStats stats;
+
+  hashTableStats(ht, &stats);
+
+  uint64_t positions = 0;
+
+  for (size_t c = 0; c < HASH_TABLE_STATS_CHAINS; c++)
+    positions += stats.chains[c];
+
+  /* The counters stay 0 unless the library is built with HASH_TABLE_STATS */
+  printf("  longest chain %u, %.1f%% empty positions, %lu resizes in %.2f ms, %.2f probes per lookup\n",
+         stats.longestChain, positions == 0 ? 0.0 : 100.0 * stats.chains[0] / positions, (unsigned long)stats.resizes,
+         stats.resizeNs / 1e6, stats.lookups == 0 ? 0.0 : (double)stats.probes / stats.lookups);
+
+  /* Sort the universe into present and absent keys for the histograms */
+  size_t present = 0;
+
+  for (size_t i = 0; i < universe; i++)
+  {
+    if (hashTableGet(ht, keys[i]) != NULL)
+    {
+      char *tmp = keys[present];
+
+      keys[present++] = keys[i];
+
+      keys[i] = tmp;
+    }
+  }
+
+  printHistogram("hit", ht, keys, 0, present);
+
+  printHistogram("miss", ht, keys, present, universe);
+
+  hashTableDestroy(ht);
+}
+
+int main(int argc, char *argv[])
+{
+  const char *workload = "all";
+
+  const char *table = "all";
+
+  size_t keys = 1 << 20;
+
+  size_t ops = 4000000;
+
+  double s = 0.99;
+
+  for (int i = 1; i + 1 < argc; i += 2)
+  {
+    if (strcmp(argv[i], "-w") == 0)
+      workload = argv[i + 1];
+    else if (strcmp(argv[i], "-t") == 0)
+      table = argv[i + 1];
+    else if (strcmp(argv[i], "-n") == 0)
+      keys = (size_t)atol(argv[i + 1]);
+    else if (strcmp(argv[i], "-o") == 0)
+      ops = (size_t)atol(argv[i + 1]);
+    else if (strcmp(argv[i], "-s") == 0)
+      s = atof(argv[i + 1]);
+  }
+
+  size_t universe = keys * 2 > ops ? keys * 2 : ops;
+
+  /* The histogram pass reorders keys, each run gets them in this order again */
+  char **original = benchKeys("key-", universe);
+
+  char **scratch = malloc(sizeof(char *) * universe);
+
+  printf("%zu keys, %zu ops\n", keys, ops);
+
+  printf("probe histogram columns:");
+
+  for (size_t c = 0; c < HISTOGRAM_COLUMNS; c++)
+  {
+    if (histogramBounds[c] == UINT32_MAX)
+      printf(" >%u", histogramBounds[c - 1]);
+    else
+      printf(" <=%u", histogramBounds[c]);
+  }
+
+  printf("\n\n");
+
+  for (size_t i = 0; i < sizeof(workloads) / sizeof(workloads[0]); i++)
+  {
+    if (strcmp(workload, "all") != 0 && strcmp(workload, workloads[i]) != 0)
+      continue;
+
+    Workload w = makeWorkload(workloads[i], keys, universe, ops, s);
+
+    for (size_t t = 0; t < sizeof(tables) / sizeof(tables[0]); t++)
+    {
+      if (strcmp(table, "all") != 0 && strcmp(table, tables[t].name) != 0)
+        continue;
+
+      memcpy(scratch, original, sizeof(char *) * universe);
+
+      run(&tables[t], &w, scratch, universe);
+    }
+
+    printf("\n");
+
+    free(w.ops);
+  }
+
+  free(scratch);
+
+  benchFreeKeys(original, universe);
+
+  return 0;
+}
@@ -0,0 +1,79 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+
+#include "hash-table.h"
+#include "bench.h"
+
+/*
+  Throughput of the built-in hash functions through the hashFunction hook
+  (strlen included) for short and long keys. Keys are cache resident, so
+  this measures the hashing and not the memory.
+
+  usage: bench-hash
+*/
+
+#define KEY_COUNT 1024
+
+typedef struct Function
+{
+  const char *name;
+  hashFunction *hash;
+} Function;
+
+static volatile uint64_t sink;
+
+int main(void)
+{
+  const Function functions[] = {
+      {"djb2", djb2HashFunction},
+      {"wyhash", wyhashHashFunction},
+      {"xxh3", xxh3HashFunction}};
+
+  const size_t lengths[] = {4, 8, 16, 32, 64, 128, 256, 1024, 4096};
+
+  uint64_t seed = 1;
+
+  printf("%-8s %6s %14s %10s\n", "hash", "length", "Mkeys/s", "GB/s");
+
+  for (size_t l = 0; l < sizeof(lengths) / sizeof(lengths[0]); l++)
+  {
+    size_t len = lengths[l];
+
+    char *block = malloc(KEY_COUNT * (len + 1));
+
+    for (size_t i = 0; i < KEY_COUNT * (len + 1); i++)
+      block[i] = (i + 1) % (len + 1) == 0 ? '\0' : 'a' + benchRandom(&seed) % 26;
+
+    /* Enough rounds for about 256 MB of input, at least 4M keys */
+    size_t rounds = (256u << 20) / (KEY_COUNT * len);
+
+    if (rounds * KEY_COUNT < (4u << 20))
+      rounds = (4u << 20) / KEY_COUNT;
+
+    for (size_t f = 0; f < sizeof(functions) / sizeof(functions[0]); f++)
+    {
+      uint64_t sum = 0;
+
+      uint64_t start = benchNow();
+
+      for (size_t r = 0; r < rounds; r++)
+      {
+        for (size_t i = 0; i < KEY_COUNT; i++)
+          sum += functions[f].hash(block + i * (len + 1));
+      }
+
+      uint64_t elapsed = benchNow() - start;
+
+      sink = sum;
+
+      double keys = (double)rounds * KEY_COUNT;
+
+      printf("%-8s %6zu %14.2f %10.2f\n", functions[f].name, len, keys * 1e3 / elapsed, keys * len / elapsed);
+    }
+
+    free(block);
+  }
+
+  return 0;
+}
@@ -0,0 +1,136 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <inttypes.h>
+
+#include "hash-table.h"
+#include "int-hash-table.h"
+#include "bench.h"
+
+INT_HASH_TABLE_DEFINE(IdTable, idTable, uint64_t, void *)
+
+/*
+  64 bit ids in the generated integer table against the same ids printed
+  into strings for a HashTable, the way they were stored before. Adds
+  start from an empty table, lookups draw ids uniformly.
+
+  usage: bench-int [keys] [lookups]
+*/
+
+typedef struct Table
+{
+  const char *name;
+  HashTableType type;
+} Table;
+
+static const Table tables[] = {
+    {"chained", HashTableChained},
+    {"swiss", HashTableSwiss},
+};
+
+static volatile uintptr_t sink;
+
+static void runInt(const uint64_t *ids, size_t count, const uint32_t *picks, size_t lookups)
+{
+  IdTable *t = idTableCreate(8);
+
+  uint64_t start = benchNow();
+
+  for (size_t i = 0; i < count; i++)
+    idTableAdd(t, ids[i], (void *)(uintptr_t)(i + 1));
+
+  uint64_t added = benchNow();
+
+  uintptr_t sum = 0;
+
+  for (size_t i = 0; i < lookups; i++)
+  {
+    void *value = NULL;
+
+    idTableGet(t, ids[picks[i]], &value);
+
+    sum += (uintptr_t)value;
+  }
+
+  uint64_t done = benchNow();
+
+  sink = sum;
+
+  printf("%-9s %10.1f %10.1f %10.1f\n", "int", (double)(added - start) / count, (double)(done - added) / lookups,
+         (double)idTableMemoryUsage(t) / count);
+
+  idTableDestroy(t);
+}
+
+static void runString(const Table *table, const uint64_t *ids, size_t count, const uint32_t *picks, size_t lookups)
+{
+  HashTableOptions options = {.type = table->type};
+
+  HashTable *ht = hashTableCreateWithOptions(8, &options);
+
+  char key[24];
+
+  uint64_t start = benchNow();
+
+  for (size_t i = 0; i < count; i++)
+  {
+    snprintf(key, sizeof(key), "%" PRIu64, ids[i]);
+
+    hashTableAdd(ht, key, (void *)(uintptr_t)(i + 1));
+  }
+
+  uint64_t added = benchNow();
+
+  uintptr_t sum = 0;
+
+  for (size_t i = 0; i < lookups; i++)
+  {
+    snprintf(key, sizeof(key), "%" PRIu64, ids[picks[i]]);
+
+    sum += (uintptr_t)hashTableGet(ht, key);
+  }
+
+  uint64_t done = benchNow();
+
+  sink = sum;
+
+  printf("%-9s %10.1f %10.1f %10.1f\n", table->name, (double)(added - start) / count, (double)(done - added) / lookups,
+         (double)hashTableMemoryUsage(ht) / count);
+
+  hashTableDestroy(ht);
+}
+
+int main(int argc, char *argv[])
+{
+  size_t count = argc > 1 ? (size_t)atol(argv[1]) : 1000000;
+
+  size_t lookups = argc > 2 ? (size_t)atol(argv[2]) : 4000000;
+
+  uint64_t state = 99;
+
+  uint64_t *ids = malloc(sizeof(uint64_t) * count);
+
+  /* Random ids, not 1 .. count, so the string keys are all 19 or 20 digits */
+  for (size_t i = 0; i < count; i++)
+    ids[i] = benchRandom(&state) | 1ULL << 63;
+
+  uint32_t *picks = malloc(sizeof(uint32_t) * lookups);
+
+  for (size_t i = 0; i < lookups; i++)
+    picks[i] = (uint32_t)(benchRandom(&state) % count);
+
+  printf("%zu ids, %zu lookups\n\n", count, lookups);
+
+  printf("%-9s %10s %10s %10s\n", "table", "add ns", "get ns", "bytes/id");
+
+  runInt(ids, count, picks, lookups);
+
+  for (size_t t = 0; t < sizeof(tables) / sizeof(tables[0]); t++)
+    runString(&tables[t], ids, count, picks, lookups);
+
+  free(picks);
+
+  free(ids);
+
+  return 0;
+}
@@ -0,0 +1,107 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+
+#include "hash-table.h"
+#include "bench.h"
+
+/*
+  Lookup latency of the swiss layout against the chained one as the table
+  fills up. The swiss table keeps one capacity for every row, so the load
+  column is its real load. The chained table is sized for its own 0.75
+  limit, otherwise it resizes while being filled.
+
+  usage: bench-layout [log2 capacity]
+*/
+
+#define LOOKUPS 4000000
+
+static volatile uintptr_t sink;
+
+static double lookupNs(HashTable *ht, char **keys, size_t count)
+{
+  uintptr_t sum = 0;
+
+  size_t done = 0;
+
+  uint64_t start = benchNow();
+
+  while (done < LOOKUPS)
+  {
+    for (size_t i = 0; i < count && done < LOOKUPS; i++, done++)
+      sum += (uintptr_t)hashTableGet(ht, keys[i]);
+  }
+
+  uint64_t elapsed = benchNow() - start;
+
+  sink = sum;
+
+  return (double)elapsed / done;
+}
+
+/* slots, when not 0, is the size the table has to have for the load column to be right */
+static void run(HashTableType type, uint32_t size, uint32_t slots, char **keys, char **misses, size_t count, double *hit,
+                double *miss)
+{
+  HashTableOptions options = {.type = type};
+
+  HashTable *ht = hashTableCreateWithOptions(size, &options);
+
+  for (size_t i = 0; i < count; i++)
+    hashTableAdd(ht, keys[i], (void *)(uintptr_t)(i + 1));
+
+  if (hashTableCount(ht) != count)
+    fprintf(stderr, "lost entries: %u of %zu\n", hashTableCount(ht), count);
+
+  HashTableStats stats;
+
+  if (slots != 0 && hashTableStats(ht, &stats) && stats.size != slots)
+    fprintf(stderr, "table has %u slots instead of %u\n", stats.size, slots);
+
+  benchShuffle(keys, count, 42);
+
+  *hit = lookupNs(ht, keys, count);
+
+  *miss = lookupNs(ht, misses, count);
+
+  hashTableDestroy(ht);
+}
+
+int main(int argc, char *argv[])
+{
+  uint32_t bits = argc > 1 ? (uint32_t)atoi(argv[1]) : 20;
+
+  uint32_t capacity = 1u << bits;
+
+  const double loads[] = {0.25, 0.5, 0.625, 0.75, 0.875};
+
+  size_t maxCount = (size_t)(capacity * 0.875);
+
+  char **keys = benchKeys("key-", maxCount);
+
+  char **misses = benchKeys("miss-", maxCount);
+
+  printf("capacity %u, ns per lookup\n\n", capacity);
+
+  printf("%6s %10s %10s %10s %10s\n", "load", "swiss hit", "swiss miss", "chain hit", "chain miss");
+
+  for (size_t i = 0; i < sizeof(loads) / sizeof(loads[0]); i++)
+  {
+    size_t count = (size_t)(capacity * loads[i]);
+
+    double swissHit, swissMiss, chainHit, chainMiss;
+
+    /* Asked for as many entries as fit at its 7/8 limit, the swiss table takes exactly capacity slots */
+    run(HashTableSwiss, capacity / 8 * 7, capacity, keys, misses, count, &swissHit, &swissMiss);
+
+    run(HashTableChained, (uint32_t)(count / 0.75) + 2, 0, keys, misses, count, &chainHit, &chainMiss);
+
+    printf("%6.3f %10.1f %10.1f %10.1f %10.1f\n", loads[i], swissHit, swissMiss, chainHit, chainMiss);
+  }
+
+  benchFreeKeys(keys, maxCount);
+
+  benchFreeKeys(misses, maxCount);
+
+  return 0;
+}
@@ -0,0 +1,105 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+#include "hash-table.h"
+#include "bench.h"
+
+/*
+  Per insert latency of the chained table growing from a small size, with
+  the whole rehash done in one call against the incremental mode. Each
+  mode runs in a child of its own, so its max is not the allocator
+  consolidating what the mode before it freed.
+
+  usage: bench-resize [keys]
+*/
+
+static int compareU64(const void *a, const void *b)
+{
+  uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+
+  return (x > y) - (x < y);
+}
+
+static void run(const char *name, bool incremental, size_t count)
+{
+  char **keys = benchKeys("key-", count);
+
+  uint64_t *latencies = malloc(sizeof(uint64_t) * count);
+
+  HashTableOptions options = {.type = HashTableChained, .incrementalResize = incremental};
+
+  HashTable *ht = hashTableCreateWithOptions(16, &options);
+
+  uint64_t start = benchNow();
+
+  for (size_t i = 0; i < count; i++)
+  {
+    uint64_t before = benchNow();
+
+    hashTableAdd(ht, keys[i], NULL);
+
+    latencies[i] = benchNow() - before;
+  }
+
+  uint64_t total = benchNow() - start;
+
+  if (hashTableCount(ht) != count)
+    fprintf(stderr, "%s: lost entries: %u of %zu\n", name, hashTableCount(ht), count);
+
+  qsort(latencies, count, sizeof(uint64_t), compareU64);
+
+  printf("%-12s %10.1f %8lu %8lu %8lu %10lu\n", name, (double)total / 1e6,
+         (unsigned long)latencies[count / 2],
+         (unsigned long)latencies[count * 99 / 100],
+         (unsigned long)latencies[count * 999 / 1000],
+         (unsigned long)latencies[count - 1]);
+
+  hashTableDestroy(ht);
+
+  free(latencies);
+
+  benchFreeKeys(keys, count);
+}
+
+static void runInChild(const char *name, bool incremental, size_t count)
+{
+  fflush(stdout);
+
+  pid_t pid = fork();
+
+  if (pid < 0)
+  {
+    perror("fork");
+
+    exit(EXIT_FAILURE);
+  }
+
+  if (pid == 0)
+  {
+    run(name, incremental, count);
+
+    fflush(stdout);
+
+    _exit(EXIT_SUCCESS);
+  }
+
+  waitpid(pid, NULL, 0);
+}
+
+int main(int argc, char *argv[])
+{
+  size_t count = argc > 1 ? (size_t)atol(argv[1]) : 2000000;
+
+  printf("%zu inserts, latency in ns\n\n", count);
+
+  printf("%-12s %10s %8s %8s %8s %10s\n", "mode", "total ms", "p50", "p99", "p99.9", "max");
+
+  runInChild("full", false, count);
+
+  runInChild("incremental", true, count);
+
+  return 0;
+}
@@ -0,0 +1,154 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#include "hash-table.h"
+#include "sharded-hash-table.h"
+#include "bench.h"
+
+/*
+  Counting, the group by loop: every thread bumps the counters of its
+  slice of a stream of keys. The sharded builder with its merge against
+  one HashTable behind a mutex, from 1 to N threads. The stream draws
+  from a fixed set of distinct keys, so most increments hit a key that
+  is already there.
+
+  usage: bench-sharded [distinct keys] [increments] [max threads]
+*/
+
+typedef struct Worker
+{
+  pthread_t thread;
+  uint32_t id;
+  char **keys;
+  const uint32_t *stream;
+  size_t from;
+  size_t to;
+  ShardedHashTable *sht;
+  HashTable *ht;
+  pthread_mutex_t *lock;
+} Worker;
+
+static void *shardedWorker(void *arg)
+{
+  Worker *w = arg;
+
+  for (size_t i = w->from; i < w->to; i++)
+  {
+    void **slot = shardedHashTableGetOrInsert(w->sht, w->id, w->keys[w->stream[i]], NULL, NULL);
+
+    *slot = (void *)((uintptr_t)*slot + 1);
+  }
+
+  return NULL;
+}
+
+static void *lockedWorker(void *arg)
+{
+  Worker *w = arg;
+
+  for (size_t i = w->from; i < w->to; i++)
+  {
+    pthread_mutex_lock(w->lock);
+
+    void **slot = hashTableGetOrInsert(w->ht, w->keys[w->stream[i]], NULL, NULL);
+
+    *slot = (void *)((uintptr_t)*slot + 1);
+
+    pthread_mutex_unlock(w->lock);
+  }
+
+  return NULL;
+}
+
+static void sumCounts(void *ctx, const char *key, size_t len, void **slot, void *value)
+{
+  *slot = (void *)((uintptr_t)*slot + (uintptr_t)value);
+}
+
+static void runWorkers(Worker *workers, uint32_t threads, void *(*body)(void *))
+{
+  for (uint32_t i = 0; i < threads; i++)
+    pthread_create(&workers[i].thread, NULL, body, &workers[i]);
+
+  for (uint32_t i = 0; i < threads; i++)
+    pthread_join(workers[i].thread, NULL);
+}
+
+static void run(uint32_t threads, char **keys, const uint32_t *stream, size_t increments)
+{
+  Worker *workers = calloc(threads, sizeof(Worker));
+
+  ShardedHashTable *sht = shardedHashTableCreate(threads, 0, NULL);
+
+  HashTable *ht = hashTableCreateWithOptions(64, NULL);
+
+  pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+
+  for (uint32_t i = 0; i < threads; i++)
+  {
+    workers[i] = (Worker){.id = i, .keys = keys, .stream = stream, .sht = sht, .ht = ht, .lock = &lock};
+
+    workers[i].from = increments * i / threads;
+
+    workers[i].to = increments * (i + 1) / threads;
+  }
+
+  uint64_t start = benchNow();
+
+  runWorkers(workers, threads, shardedWorker);
+
+  uint64_t built = benchNow();
+
+  shardedHashTableMerge(sht, sumCounts, NULL);
+
+  uint64_t merged = benchNow();
+
+  runWorkers(workers, threads, lockedWorker);
+
+  uint64_t locked = benchNow();
+
+  printf("%7u %12.2f %12.2f %12.2f %12.2f\n", threads, increments / ((built - start) / 1000.0),
+         (merged - built) / 1e6, increments / ((merged - start) / 1000.0), increments / ((locked - merged) / 1000.0));
+
+  shardedHashTableDestroy(sht);
+
+  hashTableDestroy(ht);
+
+  free(workers);
+}
+
+int main(int argc, char *argv[])
+{
+  size_t distinct = argc > 1 ? (size_t)atol(argv[1]) : 100000;
+
+  size_t increments = argc > 2 ? (size_t)atol(argv[2]) : 8000000;
+
+  long cores = sysconf(_SC_NPROCESSORS_ONLN);
+
+  uint32_t maxThreads = argc > 3 ? (uint32_t)atoi(argv[3]) : (uint32_t)(cores > 0 ? cores : 4);
+
+  char **keys = benchKeys("group-", distinct);
+
+  uint32_t *stream = malloc(sizeof(uint32_t) * increments);
+
+  uint64_t state = 7;
+
+  for (size_t i = 0; i < increments; i++)
+    stream[i] = (uint32_t)(benchRandom(&state) % distinct);
+
+  printf("%zu distinct keys, %zu increments\n\n", distinct, increments);
+
+  printf("%7s %12s %12s %12s %12s\n", "threads", "build Mops/s", "merge ms", "total Mops/s", "mutex Mops/s");
+
+  for (uint32_t threads = 1; threads <= maxThreads; threads *= 2)
+    run(threads, keys, stream, increments);
+
+  free(stream);
+
+  benchFreeKeys(keys, distinct);
+
+  return 0;
+}
@@ -0,0 +1,111 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+
+#include "hash-table.h"
+#include "bench.h"
+
+/*
+  Counter increments, the word count loop: hashTableGet followed by
+  hashTableRemove and hashTableAdd, against one hashTableGetOrInsert that
+  bumps the value in its slot. Increments are drawn uniformly over the keys.
+
+  usage: bench-upsert [keys] [increments]
+*/
+
+typedef struct Table
+{
+  const char *name;
+  HashTableType type;
+} Table;
+
+static const Table tables[] = {
+    {"chained", HashTableChained},
+    {"swiss", HashTableSwiss},
+    {"robinhood", HashTableRobinHood},
+    {"cuckoo", HashTableCuckoo},
+};
+
+static double removeAddNs(HashTableType type, char **keys, const uint32_t *picks, size_t increments)
+{
+  HashTableOptions options = {.type = type};
+
+  HashTable *ht = hashTableCreateWithOptions(8, &options);
+
+  uint64_t start = benchNow();
+
+  for (size_t i = 0; i < increments; i++)
+  {
+    const char *key = keys[picks[i]];
+
+    uintptr_t count = (uintptr_t)hashTableGet(ht, key);
+
+    if (count != 0)
+      hashTableRemove(ht, key);
+
+    hashTableAdd(ht, key, (void *)(count + 1));
+  }
+
+  uint64_t elapsed = benchNow() - start;
+
+  hashTableDestroy(ht);
+
+  return (double)elapsed / increments;
+}
+
+static double getOrInsertNs(HashTableType type, char **keys, const uint32_t *picks, size_t increments)
+{
+  HashTableOptions options = {.type = type};
+
+  HashTable *ht = hashTableCreateWithOptions(8, &options);
+
+  uint64_t start = benchNow();
+
+  for (size_t i = 0; i < increments; i++)
+  {
+    void **slot = hashTableGetOrInsert(ht, keys[picks[i]], NULL, NULL);
+
+    *slot = (void *)((uintptr_t)*slot + 1);
+  }
+
+  uint64_t elapsed = benchNow() - start;
+
+  hashTableDestroy(ht);
+
+  return (double)elapsed / increments;
+}
+
+int main(int argc, char *argv[])
+{
+  size_t count = argc > 1 ? (size_t)atol(argv[1]) : 100000;
+
+  size_t increments = argc > 2 ? (size_t)atol(argv[2]) : 4000000;
+
+  char **keys = benchKeys("word-", count);
+
+  uint32_t *picks = malloc(sizeof(uint32_t) * increments);
+
+  uint64_t state = 42;
+
+  for (size_t i = 0; i < increments; i++)
+    picks[i] = (uint32_t)(benchRandom(&state) % count);
+
+  printf("%zu keys, %zu increments\n\n", count, increments);
+
+  printf("%-10s %14s %14s %9s\n", "table", "remove+add ns", "upsert ns", "speedup");
+
+  for (size_t t = 0; t < sizeof(tables) / sizeof(tables[0]); t++)
+  {
+    double slow = removeAddNs(tables[t].type, keys, picks, increments);
+
+    double fast = getOrInsertNs(tables[t].type, keys, picks, increments);
+
+    printf("%-10s %14.1f %14.1f %8.2fx\n", tables[t].name, slow, fast, slow / fast);
+  }
+
+  free(picks);
+
+  benchFreeKeys(keys, count);
+
+  return 0;
+}
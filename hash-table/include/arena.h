@@ -0,0 +1,20 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+
+/*
+  Slab allocator owned by a single table. Small blocks are carved out of
+  large chunks and recycled through one free list per size class, bigger
+  ones get a chunk of their own. Destroying the arena releases every
+  block at once, in O(number of chunks).
+*/
+
+typedef struct Arena Arena;
+
+Arena *arenaCreate(void);
+void *arenaAlloc(Arena *arena, size_t size);
+void arenaFree(Arena *arena, void *ptr, size_t size);
+void arenaDestroy(Arena *arena);
+
+#endif
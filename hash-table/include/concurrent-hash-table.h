@@ -0,0 +1,26 @@
+#ifndef CONCURRENT_HASHTABLE_H
+#define CONCURRENT_HASHTABLE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "hash-table.h"
+
+/*
+  Thread safe chained table. Writers lock one of a fixed set of stripes,
+  readers take no lock at all and removed entries are freed through epoch
+  reclamation. Resizing locks every stripe but never blocks readers.
+*/
+
+typedef struct ConcurrentHashTable ConcurrentHashTable;
+
+ConcurrentHashTable *concurrentHashTableCreate(uint32_t size, hashFunction *hf);
+bool concurrentHashTableAdd(ConcurrentHashTable *cht, const char *key, void *value);
+void *concurrentHashTableGet(ConcurrentHashTable *cht, const char *key);
+bool concurrentHashTableRemove(ConcurrentHashTable *cht, const char *key);
+uint32_t concurrentHashTableCount(ConcurrentHashTable *cht);
+
+/* Not thread safe, no other thread may use the table any more */
+void concurrentHashTableDestroy(ConcurrentHashTable *cht);
+
+#endif
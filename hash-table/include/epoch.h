@@ -0,0 +1,29 @@
+#ifndef EPOCH_H
+#define EPOCH_H
+
+#include <stdint.h>
+
+/*
+  Epoch based reclamation. Readers wrap lock free traversals in
+  epochEnter/epochExit, writers hand unlinked memory to epochRetire and it
+  is freed once every reader that could still see it has left.
+*/
+
+typedef struct EpochNode EpochNode;
+
+typedef void epochFreeFunction(EpochNode *node);
+
+/* Embedded in every object that can be retired */
+struct EpochNode
+{
+  EpochNode *next;
+  uint64_t epoch;
+  epochFreeFunction *free;
+};
+
+void epochEnter(void);
+void epochExit(void);
+void epochRetire(EpochNode *node, epochFreeFunction *freeFn);
+void epochReclaim(void);
+
+#endif
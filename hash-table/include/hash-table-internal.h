@@ -0,0 +1,240 @@
+#ifndef HASHTABLE_INTERNAL_H
+#define HASHTABLE_INTERNAL_H
+
+#include <string.h>
+#include <time.h>
+
+#include "hash-table.h"
+#include "arena.h"
+
+/*
+  Layout shared by the hash table backends. Every backend starts with a
+  HashTable so the public functions can dispatch through the function
+  pointers without knowing which layout is behind them. Backends get the
+  key as bytes plus length together with its hash.
+*/
+
+/* Keys up to this length live inside the entry, longer ones are copied */
+#define HASH_KEY_INLINE 15
+
+typedef struct HashKey
+{
+  union
+  {
+    char *ptr;
+    char bytes[HASH_KEY_INLINE + 1];
+  } data;
+  uint32_t len;
+} HashKey;
+
+struct Entry
+{
+  uint64_t hash;
+  void *value;
+  Entry *next;
+  HashKey key;
+};
+
+/* Chained entries of a table in cache mode, linked in the CLOCK ring */
+typedef struct CacheEntry CacheEntry;
+
+struct CacheEntry
+{
+  Entry entry;
+  CacheEntry *prev;
+  CacheEntry *next;
+  /* Monotonic milliseconds, 0 never expires */
+  uint64_t expires;
+  size_t cost;
+  bool referenced;
+};
+
+typedef struct HashTableCache
+{
+  CacheEntry *hand;
+  uint32_t maxEntries;
+  size_t maxBytes;
+  size_t bytes;
+  uint64_t ttl;
+  /* Picked up by the next entry that is linked, set by hashTableCacheAdd */
+  uint64_t nextTtl;
+  size_t nextCost;
+  /* Entries with an expiry time, while there are any inserts sweep for expired ones */
+  uint32_t timed;
+  hashTableVisit *onEvict;
+  void *onEvictCtx;
+  HashTableCacheStats stats;
+} HashTableCache;
+
+/* Operation counters behind hashTableStats, see HASH_STAT_ADD */
+typedef struct HashTableCounters
+{
+  uint64_t lookups;
+  uint64_t probes;
+  uint64_t resizes;
+  uint64_t resizeNs;
+} HashTableCounters;
+
+struct HashTable
+{
+  HashTableType type;
+  uint32_t size;
+  uint32_t initialSize;
+  uint32_t count;
+  Entry **elements;
+  Entry **oldElements;
+  uint32_t oldSize;
+  uint32_t rehashIndex;
+  bool incremental;
+  Arena *arena;
+  /* NULL unless the table is in cache mode */
+  HashTableCache *cache;
+  hashFunction *hash;
+  hashFunctionN *hashN;
+  hashTableFreeValue *freeValue;
+  hashTableCopyValue *copyValue;
+  double loadFactor;
+  /* Bumped whenever entries are added, removed or moved */
+  uint64_t version;
+  HashTableCounters counters;
+  bool (*add)(HashTable *ht, const void *key, size_t len, uint64_t hash, void *value);
+  bool (*remove)(HashTable *ht, const void *key, size_t len, uint64_t hash);
+  void *(*get)(HashTable *ht, const void *key, size_t len, uint64_t hash);
+  /*
+    Returns the value slot of key, adding it with a NULL value when it is
+    missing. The slot stays valid until the table is changed, NULL for a
+    read-only table
+  */
+  void **(*getOrInsert)(HashTable *ht, const void *key, size_t len, uint64_t hash, bool *inserted);
+  /* Warms the cache lines a lookup of hash touches, stage 0 then stage 1 */
+  void (*prefetch)(HashTable *ht, uint64_t hash, uint32_t stage);
+  /* Slots, entries, groups or buckets a lookup of key looks at */
+  uint32_t (*probeLength)(HashTable *ht, const void *key, size_t len, uint64_t hash);
+  /* Bytes held by the table, keys included */
+  size_t (*memoryUsage)(HashTable *ht);
+  /*
+    Visits the entries of one cursor position and returns the next cursor,
+    0 when done. Positions are home buckets in reverse binary order, so a
+    resize between calls neither skips entries nor repeats many of them
+  */
+  uint64_t (*scan)(HashTable *ht, uint64_t cursor, hashTableVisit *visit, void *ctx);
+  /* Fills the layout dependent part of stats: bytes and chains */
+  void (*stats)(HashTable *ht, HashTableStats *stats);
+  /* Calls visit once for every entry, the table must not change meanwhile */
+  void (*forEach)(HashTable *ht, hashTableVisit *visit, void *ctx);
+  void (*destroy)(HashTable *ht);
+  void (*print)(HashTable *ht);
+};
+
+/* Stored keys are always NUL terminated so they can be printed */
+static inline const char *hashKeyBytes(const HashKey *k)
+{
+  return k->len <= HASH_KEY_INLINE ? k->data.bytes : k->data.ptr;
+}
+
+static inline bool hashKeyEquals(const HashKey *k, const void *key, size_t len)
+{
+  return k->len == len && memcmp(hashKeyBytes(k), key, len) == 0;
+}
+
+static inline uint64_t reverseBits(uint64_t v)
+{
+  v = ((v >> 1) & 0x5555555555555555ULL) | ((v & 0x5555555555555555ULL) << 1);
+
+  v = ((v >> 2) & 0x3333333333333333ULL) | ((v & 0x3333333333333333ULL) << 2);
+
+  v = ((v >> 4) & 0x0F0F0F0F0F0F0F0FULL) | ((v & 0x0F0F0F0F0F0F0F0FULL) << 4);
+
+  return __builtin_bswap64(v);
+}
+
+/*
+  Increments the high bits of the cursor first. Once a table doubles, the
+  positions a cursor has passed are exactly the ones that split from the
+  positions it passed before, so nothing is skipped.
+*/
+static inline uint64_t scanCursorNext(uint64_t cursor, uint64_t mask)
+{
+  cursor |= ~mask;
+
+  cursor = reverseBits(cursor);
+
+  cursor++;
+
+  return reverseBits(cursor);
+}
+
+/* Bytes a key holds outside of its entry */
+static inline size_t hashKeyHeapSize(const HashKey *k)
+{
+  return k->len <= HASH_KEY_INLINE ? 0 : k->len + 1;
+}
+
+/*
+  Counters are compiled in with -DHASH_TABLE_STATS. Without it the macros
+  only evaluate to their arguments being discarded, which the compiler drops
+*/
+#ifdef HASH_TABLE_STATS
+
+#define HASH_STAT_ADD(ht, field, n) ((ht)->counters.field += (n))
+
+static inline uint64_t hashStatNow(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+
+  return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+#define HASH_STAT_NOW() hashStatNow()
+
+#else
+
+#define HASH_STAT_ADD(ht, field, n) ((void)(n))
+
+#define HASH_STAT_NOW() ((uint64_t)0)
+
+#endif
+
+/* Counts one resize that started at started, a HASH_STAT_NOW() reading */
+#define HASH_STAT_RESIZE(ht, started)                         \
+  do                                                          \
+  {                                                           \
+    HASH_STAT_ADD(ht, resizes, 1);                            \
+                                                              \
+    HASH_STAT_ADD(ht, resizeNs, HASH_STAT_NOW() - (started)); \
+  } while (0)
+
+static inline void *hashValueCopy(HashTable *ht, void *value)
+{
+  return ht->copyValue != NULL ? ht->copyValue(value) : value;
+}
+
+static inline void hashValueFree(HashTable *ht, void *value)
+{
+  if (ht->freeValue != NULL && value != NULL)
+    ht->freeValue(value);
+}
+
+void hashKeySet(HashTable *ht, HashKey *k, const void *key, size_t len);
+void hashKeyFree(HashTable *ht, HashKey *k);
+
+void hashTableInit(HashTable *ht, const HashTableOptions *options);
+uint64_t hashTableHashN(HashTable *ht, const void *key, size_t len);
+uint64_t hashTableHashString(HashTable *ht, const char *key, size_t len);
+void hashStatsChain(HashTableStats *stats, uint32_t length);
+
+HashTableCache *cacheCreate(const HashTableOptions *options);
+void cacheLink(HashTable *ht, Entry *e);
+void cacheUnlink(HashTable *ht, Entry *e);
+bool cacheExpire(HashTable *ht, Entry *e);
+bool cacheHit(HashTable *ht, Entry *e);
+void cacheMiss(HashTable *ht);
+void cacheEnforce(HashTable *ht, Entry *keep);
+
+HashTable *swissTableCreate(uint32_t size, const HashTableOptions *options);
+HashTable *robinHoodTableCreate(uint32_t size, const HashTableOptions *options);
+HashTable *cuckooTableCreate(uint32_t size, const HashTableOptions *options);
+
+#endif
@@ -3,18 +3,153 @@
 
 #include <stdint.h>
 #include <stdbool.h>
+#include <stddef.h>
 
 typedef uint64_t hashFunction(const char *key);
 
+typedef uint64_t hashFunctionN(const void *key, size_t len);
+
+typedef void hashTableVisit(void *ctx, const char *key, size_t len, void *value);
+
+typedef void hashTableFreeValue(void *value);
+
+typedef void *hashTableCopyValue(void *value);
+
 typedef struct Entry Entry;
 
 typedef struct HashTable HashTable;
 
+typedef enum
+{
+  HashTableChained,
+  HashTableSwiss,
+  HashTableRobinHood,
+  HashTableCuckoo,
+  /* Read-only, only returned by hashTableMap */
+  HashTableMapped
+} HashTableType;
+
+/*
+  Zero initialised options give the default chained table using wyhash
+*/
+typedef struct HashTableOptions
+{
+  HashTableType type;
+  hashFunction *hash;
+  /* Hashes keys as bytes, preferred over hash when both are set */
+  hashFunctionN *hashN;
+  /* Chained only: move a few buckets per operation instead of all at once */
+  bool incrementalResize;
+  /* Entries and keys come from a slab owned by the table */
+  bool arena;
+  /* Cache mode, chained only. Past either budget entries are evicted, 0 is no limit */
+  uint32_t maxEntries;
+  size_t maxBytes;
+  /* Milliseconds an entry lives, 0 for ever */
+  uint64_t ttl;
+  /* Gets every evicted or expired entry right before it is removed */
+  hashTableVisit *onEvict;
+  void *onEvictCtx;
+  /*
+    Values the table owns. copyValue is applied to every value that is
+    stored, freeValue to every non NULL value that is removed, replaced,
+    evicted or left at destroy
+  */
+  hashTableFreeValue *freeValue;
+  hashTableCopyValue *copyValue;
+} HashTableOptions;
+
+typedef struct HashTableCacheStats
+{
+  uint64_t hits;
+  uint64_t misses;
+  uint64_t evictions;
+  uint64_t expirations;
+  /* Charged against maxBytes: entries, keys and value costs */
+  size_t bytes;
+} HashTableCacheStats;
+
+/* Columns of the chain length histogram, the last one takes longer chains too */
+#define HASH_TABLE_STATS_CHAINS 16
+
+/*
+  Filled by hashTableStats. A chain is every entry with the same home
+  position: a bucket for chained and cuckoo, a home group for swiss and a
+  home slot for robin hood and mapped tables. A good hash gives chains
+  close to a Poisson spread around the load, a bad one a long tail
+*/
+typedef struct HashTableStats
+{
+  HashTableType type;
+  uint32_t count;
+  /* Buckets for chained, slots for the others */
+  uint32_t size;
+  double load;
+  /* What hashTableMemoryUsage counts, split by what holds it */
+  size_t tableBytes;
+  size_t entryBytes;
+  size_t keyBytes;
+  /* chains[i] is the number of home positions with i entries */
+  uint64_t chains[HASH_TABLE_STATS_CHAINS];
+  uint32_t longestChain;
+  /*
+    Counted only when the library is built with HASH_TABLE_STATS defined,
+    0 otherwise. probes are in hashTableProbeLength units, resizeNs is the
+    time spent moving entries to a new array, incremental steps included
+  */
+  uint64_t lookups;
+  uint64_t probes;
+  uint64_t resizes;
+  uint64_t resizeNs;
+} HashTableStats;
+
+/*
+  Cursor of hashTableIterNext, zero initialise it to start. Entries present
+  for the whole iteration are returned at least once even when the table is
+  changed or resized in between calls, some may then be returned twice.
+  The cuckoo layout is the exception: an insert that kicks an entry across
+  the cursor can make the iteration miss it.
+*/
+typedef struct HashTableIter
+{
+  uint64_t cursor;
+  uint64_t version;
+  uint32_t offset;
+  bool done;
+} HashTableIter;
+
+/* Built-in hash functions, the *HashFunction ones fit the hashFunction hook */
+uint64_t djb2HashFunction(const char *key);
+uint64_t wyhashHashFunction(const char *key);
+uint64_t xxh3HashFunction(const char *key);
+uint64_t wyhash(const void *key, size_t len);
+uint64_t xxh3Hash(const void *key, size_t len);
+
 HashTable *hashTableCreate(uint32_t size, hashFunction *hf);
+HashTable *hashTableCreateWithOptions(uint32_t size, const HashTableOptions *options);
 bool hashTableAdd(HashTable *ht, const char *key, void *value);
 void *hashTableGet(HashTable *ht, const char *key);
 bool hashTableRemove(HashTable *ht, const char *key);
+bool hashTableAddN(HashTable *ht, const void *key, size_t len, void *value);
+void *hashTableGetN(HashTable *ht, const void *key, size_t len);
+bool hashTableRemoveN(HashTable *ht, const void *key, size_t len);
+void **hashTableGetOrInsert(HashTable *ht, const char *key, void *value, bool *inserted);
+void **hashTableGetOrInsertN(HashTable *ht, const void *key, size_t len, void *value, bool *inserted);
+void **hashTableUpsert(HashTable *ht, const char *key, void *value);
+void **hashTableUpsertN(HashTable *ht, const void *key, size_t len, void *value);
+void hashTableGetMany(HashTable *ht, const char *const *keys, size_t count, void **values);
+size_t hashTableAddMany(HashTable *ht, const char *const *keys, void *const *values, size_t count);
+uint32_t hashTableCount(HashTable *ht);
+bool hashTableCacheAdd(HashTable *ht, const char *key, void *value, size_t cost, uint64_t ttl);
+bool hashTableCacheStats(HashTable *ht, HashTableCacheStats *stats);
+uint64_t hashTableScan(HashTable *ht, uint64_t cursor, hashTableVisit *visit, void *ctx);
+bool hashTableIterNext(HashTable *ht, HashTableIter *it, const char **key, size_t *len, void **value);
+uint32_t hashTableProbeLength(HashTable *ht, const char *key);
+size_t hashTableMemoryUsage(HashTable *ht);
+bool hashTableStats(HashTable *ht, HashTableStats *stats);
+bool hashTableSave(HashTable *ht, const char *path);
+HashTable *hashTableMap(const char *path);
 void hashTableDestroy(HashTable *ht);
 void hashTablePrint(HashTable *ht);
 
-#endif
\ No newline at end of file
+#endif
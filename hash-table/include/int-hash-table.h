@@ -0,0 +1,335 @@
+#ifndef INT_HASH_TABLE_H
+#define INT_HASH_TABLE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+  Hash tables keyed by integers, generated for one key and value type:
+
+    INT_HASH_TABLE_DEFINE(IdMap, idMap, uint64_t, void *)
+
+  defines the type IdMap and idMapCreate, idMapAdd, idMapGet and friends,
+  named and behaving like their hashTable counterparts. Keys and values sit
+  in two flat arrays, nothing is allocated per entry and a key is its own
+  hash, spread with a fibonacci multiply. Linear probing keeps a lookup on
+  consecutive keys, removal shifts the following keys back so there are no
+  tombstones. Key 0 marks an empty slot, an entry for 0 is kept on the side
+*/
+
+/* Grows above 3/4 of the capacity */
+#define INT_HASH_TABLE_MAX_LOAD_NUM 3
+#define INT_HASH_TABLE_MAX_LOAD_DEN 4
+
+/* 2^64 divided by the golden ratio */
+#define INT_HASH_TABLE_FIBONACCI 0x9E3779B97F4A7C15ULL
+
+/* Top bits of the product, the well mixed ones, index a table of 2^(64 - shift) slots */
+static inline uint32_t intHashTableSlot(uint64_t key, uint32_t shift)
+{
+  return (uint32_t)((key * INT_HASH_TABLE_FIBONACCI) >> shift);
+}
+
+static inline uint32_t intHashTableMaxCount(uint32_t capacity)
+{
+  return (uint32_t)((uint64_t)capacity * INT_HASH_TABLE_MAX_LOAD_NUM / INT_HASH_TABLE_MAX_LOAD_DEN);
+}
+
+#define INT_HASH_TABLE_DEFINE(Type, prefix, Key, Value)                                  \
+                                                                                         \
+  typedef struct Type                                                                    \
+  {                                                                                      \
+    Key *keys;                                                                           \
+    Value *values;                                                                       \
+    uint32_t mask;                                                                       \
+    uint32_t shift;                                                                      \
+    uint32_t count;                                                                      \
+    bool hasZero;                                                                        \
+    Value zeroValue;                                                                     \
+  } Type;                                                                                \
+                                                                                         \
+  static inline void prefix##Allocate(Type *t, uint32_t capacity)                        \
+  {                                                                                      \
+    t->keys = calloc(capacity, sizeof(Key));                                             \
+                                                                                         \
+    t->values = malloc(sizeof(Value) * capacity);                                        \
+                                                                                         \
+    t->mask = capacity - 1;                                                              \
+                                                                                         \
+    t->shift = 64 - (uint32_t)__builtin_ctz(capacity);                                   \
+  }                                                                                      \
+                                                                                         \
+  /* Returns the slot of key, or the empty slot where it would go */                    \
+  static inline uint32_t prefix##Find(const Type *t, Key key)                            \
+  {                                                                                      \
+    uint32_t index = intHashTableSlot((uint64_t)key, t->shift);                          \
+                                                                                         \
+    while (t->keys[index] != 0 && t->keys[index] != key)                                 \
+      index = (index + 1) & t->mask;                                                     \
+                                                                                         \
+    return index;                                                                        \
+  }                                                                                      \
+                                                                                         \
+  static inline void prefix##Resize(Type *t, uint32_t capacity)                          \
+  {                                                                                      \
+    Key *oldKeys = t->keys;                                                              \
+                                                                                         \
+    Value *oldValues = t->values;                                                        \
+                                                                                         \
+    uint32_t oldCapacity = t->mask + 1;                                                  \
+                                                                                         \
+    prefix##Allocate(t, capacity);                                                       \
+                                                                                         \
+    for (uint32_t i = 0; i < oldCapacity; i++)                                           \
+    {                                                                                    \
+      if (oldKeys[i] == 0)                                                               \
+        continue;                                                                        \
+                                                                                         \
+      uint32_t index = prefix##Find(t, oldKeys[i]);                                      \
+                                                                                         \
+      t->keys[index] = oldKeys[i];                                                       \
+                                                                                         \
+      t->values[index] = oldValues[i];                                                   \
+    }                                                                                    \
+                                                                                         \
+    free(oldKeys);                                                                       \
+                                                                                         \
+    free(oldValues);                                                                     \
+  }                                                                                      \
+                                                                                         \
+  /* Room for size entries without growing */                                            \
+  static inline Type *prefix##Create(uint32_t size)                                      \
+  {                                                                                      \
+    Type *t = calloc(1, sizeof(Type));                                                   \
+                                                                                         \
+    uint32_t capacity = 8;                                                               \
+                                                                                         \
+    while (intHashTableMaxCount(capacity) < size)                                        \
+      capacity *= 2;                                                                     \
+                                                                                         \
+    prefix##Allocate(t, capacity);                                                       \
+                                                                                         \
+    return t;                                                                            \
+  }                                                                                      \
+                                                                                         \
+  static inline void prefix##Destroy(Type *t)                                            \
+  {                                                                                      \
+    if (t == NULL)                                                                       \
+      return;                                                                            \
+                                                                                         \
+    free(t->keys);                                                                       \
+                                                                                         \
+    free(t->values);                                                                     \
+                                                                                         \
+    free(t);                                                                             \
+  }                                                                                      \
+                                                                                         \
+  static inline uint32_t prefix##Count(const Type *t)                                    \
+  {                                                                                      \
+    return t->count;                                                                     \
+  }                                                                                      \
+                                                                                         \
+  /* Sets *value and returns true when key is present, value may be NULL */             \
+  static inline bool prefix##Get(const Type *t, Key key, Value *value)                   \
+  {                                                                                      \
+    if (key == 0)                                                                        \
+    {                                                                                    \
+      if (t->hasZero && value != NULL)                                                   \
+        *value = t->zeroValue;                                                           \
+                                                                                         \
+      return t->hasZero;                                                                 \
+    }                                                                                    \
+                                                                                         \
+    uint32_t index = prefix##Find(t, key);                                               \
+                                                                                         \
+    if (t->keys[index] == 0)                                                             \
+      return false;                                                                      \
+                                                                                         \
+    if (value != NULL)                                                                   \
+      *value = t->values[index];                                                         \
+                                                                                         \
+    return true;                                                                         \
+  }                                                                                      \
+                                                                                         \
+  /*                                                                                     \
+    Returns the value slot of key in one lookup, adding key with a zeroed                \
+    value when it is missing. The slot stays valid until the table changes               \
+  */                                                                                     \
+  static inline Value *prefix##GetOrInsert(Type *t, Key key, bool *inserted)             \
+  {                                                                                      \
+    bool added = false;                                                                  \
+                                                                                         \
+    Value *slot;                                                                         \
+                                                                                         \
+    if (key == 0)                                                                        \
+    {                                                                                    \
+      if (!t->hasZero)                                                                   \
+      {                                                                                  \
+        memset(&t->zeroValue, 0, sizeof(Value));                                         \
+                                                                                         \
+        t->hasZero = true;                                                               \
+                                                                                         \
+        t->count++;                                                                      \
+                                                                                         \
+        added = true;                                                                    \
+      }                                                                                  \
+                                                                                         \
+      slot = &t->zeroValue;                                                              \
+    }                                                                                    \
+    else                                                                                 \
+    {                                                                                    \
+      uint32_t index = prefix##Find(t, key);                                             \
+                                                                                         \
+      if (t->keys[index] == 0)                                                           \
+      {                                                                                  \
+        if (t->count + 1 > intHashTableMaxCount(t->mask + 1))                            \
+        {                                                                                \
+          prefix##Resize(t, (t->mask + 1) * 2);                                          \
+                                                                                         \
+          index = prefix##Find(t, key);                                                  \
+        }                                                                                \
+                                                                                         \
+        t->keys[index] = key;                                                            \
+                                                                                         \
+        memset(&t->values[index], 0, sizeof(Value));                                     \
+                                                                                         \
+        t->count++;                                                                      \
+                                                                                         \
+        added = true;                                                                    \
+      }                                                                                  \
+                                                                                         \
+      slot = &t->values[index];                                                          \
+    }                                                                                    \
+                                                                                         \
+    if (inserted != NULL)                                                                \
+      *inserted = added;                                                                 \
+                                                                                         \
+    return slot;                                                                         \
+  }                                                                                      \
+                                                                                         \
+  /* Returns false and leaves the value alone when key is already there */              \
+  static inline bool prefix##Add(Type *t, Key key, Value value)                          \
+  {                                                                                      \
+    bool inserted;                                                                       \
+                                                                                         \
+    Value *slot = prefix##GetOrInsert(t, key, &inserted);                                \
+                                                                                         \
+    if (inserted)                                                                        \
+      *slot = value;                                                                     \
+                                                                                         \
+    return inserted;                                                                     \
+  }                                                                                      \
+                                                                                         \
+  /* Sets key to value whether or not it was there */                                   \
+  static inline void prefix##Upsert(Type *t, Key key, Value value)                       \
+  {                                                                                      \
+    *prefix##GetOrInsert(t, key, NULL) = value;                                          \
+  }                                                                                      \
+                                                                                         \
+  /* Backward shift: move every following key that is away from home into the gap */    \
+  static inline bool prefix##Remove(Type *t, Key key)                                    \
+  {                                                                                      \
+    if (key == 0)                                                                        \
+    {                                                                                    \
+      if (!t->hasZero)                                                                   \
+        return false;                                                                    \
+                                                                                         \
+      t->hasZero = false;                                                                \
+                                                                                         \
+      t->count--;                                                                        \
+                                                                                         \
+      return true;                                                                       \
+    }                                                                                    \
+                                                                                         \
+    uint32_t gap = prefix##Find(t, key);                                                 \
+                                                                                         \
+    if (t->keys[gap] == 0)                                                               \
+      return false;                                                                      \
+                                                                                         \
+    uint32_t index = gap;                                                                \
+                                                                                         \
+    while (true)                                                                         \
+    {                                                                                    \
+      index = (index + 1) & t->mask;                                                     \
+                                                                                         \
+      if (t->keys[index] == 0)                                                           \
+        break;                                                                           \
+                                                                                         \
+      uint32_t home = intHashTableSlot((uint64_t)t->keys[index], t->shift);              \
+                                                                                         \
+      /* Stays put when its home lies cyclically in (gap, index] */                      \
+      if (((index - home) & t->mask) < ((index - gap) & t->mask))                        \
+        continue;                                                                        \
+                                                                                         \
+      t->keys[gap] = t->keys[index];                                                     \
+                                                                                         \
+      t->values[gap] = t->values[index];                                                 \
+                                                                                         \
+      gap = index;                                                                       \
+    }                                                                                    \
+                                                                                         \
+    t->keys[gap] = 0;                                                                    \
+                                                                                         \
+    t->count--;                                                                          \
+                                                                                         \
+    return true;                                                                         \
+  }                                                                                      \
+                                                                                         \
+  /*                                                                                     \
+    Returns the entries one at a time, start with *cursor 0. The table must              \
+    not change in between calls                                                          \
+  */                                                                                     \
+  static inline bool prefix##Next(const Type *t, uint32_t *cursor, Key *key, Value *value) \
+  {                                                                                      \
+    /* Position 0 is the entry for key 0, slot i is position i + 1 */                   \
+    if (*cursor == 0)                                                                    \
+    {                                                                                    \
+      *cursor = 1;                                                                       \
+                                                                                         \
+      if (t->hasZero)                                                                    \
+      {                                                                                  \
+        *key = 0;                                                                        \
+                                                                                         \
+        *value = t->zeroValue;                                                           \
+                                                                                         \
+        return true;                                                                     \
+      }                                                                                  \
+    }                                                                                    \
+                                                                                         \
+    while (*cursor <= t->mask + 1)                                                       \
+    {                                                                                    \
+      uint32_t index = (*cursor)++ - 1;                                                  \
+                                                                                         \
+      if (t->keys[index] != 0)                                                           \
+      {                                                                                  \
+        *key = t->keys[index];                                                           \
+                                                                                         \
+        *value = t->values[index];                                                       \
+                                                                                         \
+        return true;                                                                     \
+      }                                                                                  \
+    }                                                                                    \
+                                                                                         \
+    return false;                                                                        \
+  }                                                                                      \
+                                                                                         \
+  /* Slots a lookup of key looks at */                                                   \
+  static inline uint32_t prefix##ProbeLength(const Type *t, Key key)                     \
+  {                                                                                      \
+    if (key == 0)                                                                        \
+      return 1;                                                                          \
+                                                                                         \
+    uint32_t home = intHashTableSlot((uint64_t)key, t->shift);                           \
+                                                                                         \
+    return ((prefix##Find(t, key) - home) & t->mask) + 1;                                \
+  }                                                                                      \
+                                                                                         \
+  static inline size_t prefix##MemoryUsage(const Type *t)                                \
+  {                                                                                      \
+    return sizeof(Type) + (size_t)(t->mask + 1) * (sizeof(Key) + sizeof(Value));         \
+  }
+
+#endif
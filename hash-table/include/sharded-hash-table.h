@@ -0,0 +1,47 @@
+#ifndef SHARDED_HASHTABLE_H
+#define SHARDED_HASHTABLE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "hash-table.h"
+
+/*
+  Builder for parallel aggregation. Every thread inserts into its own
+  shard without any synchronisation, shardedHashTableMerge then combines
+  the shards in parallel. Shards are split by hash range into partitions
+  up front, so each merge thread owns a disjoint set of keys and the
+  merged result is a set of partition tables that are never locked.
+*/
+
+typedef struct ShardedHashTable ShardedHashTable;
+
+/*
+  Folds value, from a later shard, into *slot, the value merged so far for
+  the same key. A table that owns its values frees value afterwards
+*/
+typedef void shardedHashTableReduce(void *ctx, const char *key, size_t len, void **slot, void *value);
+
+/* options apply to every partition table, 0 partitions picks 4 per thread */
+ShardedHashTable *shardedHashTableCreate(uint32_t threads, uint32_t partitions, const HashTableOptions *options);
+
+/*
+  Like hashTableGetOrInsert on the shard of thread, which only that thread
+  may use until the merge. NULL once the table is merged
+*/
+void **shardedHashTableGetOrInsert(ShardedHashTable *sht, uint32_t thread, const char *key, void *value, bool *inserted);
+void **shardedHashTableGetOrInsertN(ShardedHashTable *sht, uint32_t thread, const void *key, size_t len, void *value, bool *inserted);
+
+/* Combines the shards, the merge threads take one partition at a time */
+void shardedHashTableMerge(ShardedHashTable *sht, shardedHashTableReduce *reduce, void *ctx);
+
+/* After the merge: lookups, and the partitions that hold the result */
+void *shardedHashTableGet(ShardedHashTable *sht, const char *key);
+uint32_t shardedHashTablePartitions(ShardedHashTable *sht);
+HashTable *shardedHashTablePartition(ShardedHashTable *sht, uint32_t partition);
+uint32_t shardedHashTableCount(ShardedHashTable *sht);
+
+void shardedHashTableDestroy(ShardedHashTable *sht);
+
+#endif
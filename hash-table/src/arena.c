@@ -0,0 +1,172 @@
+#include <stdlib.h>
+#include <stdint.h>
+
+#include "arena.h"
+
+/* Private */
+
+#define ARENA_ALIGN 16
+
+#define ARENA_CLASSES 16
+
+/* Largest block served from a size class, bigger ones get their own chunk */
+#define ARENA_MAX_SMALL (ARENA_ALIGN * ARENA_CLASSES)
+
+#define ARENA_CHUNK_SIZE (64 * 1024)
+
+typedef struct Chunk Chunk;
+
+typedef struct FreeBlock FreeBlock;
+
+/* The header is padded so the memory after it stays 16 byte aligned */
+struct Chunk
+{
+  Chunk *prev;
+  Chunk *next;
+  size_t size;
+  size_t used;
+};
+
+struct FreeBlock
+{
+  FreeBlock *next;
+};
+
+struct Arena
+{
+  Chunk *chunks;
+  Chunk *current;
+  FreeBlock *freeLists[ARENA_CLASSES];
+};
+
+static inline size_t headerSize(void)
+{
+  return (sizeof(Chunk) + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1);
+}
+
+static inline uint8_t *chunkData(Chunk *chunk)
+{
+  return (uint8_t *)chunk + headerSize();
+}
+
+static inline size_t sizeClass(size_t size)
+{
+  return size == 0 ? 0 : (size - 1) / ARENA_ALIGN;
+}
+
+static Chunk *chunkCreate(Arena *arena, size_t size)
+{
+  Chunk *chunk = malloc(headerSize() + size);
+
+  chunk->size = size;
+
+  chunk->used = 0;
+
+  chunk->prev = NULL;
+
+  chunk->next = arena->chunks;
+
+  if (arena->chunks != NULL)
+    arena->chunks->prev = chunk;
+
+  arena->chunks = chunk;
+
+  return chunk;
+}
+
+static void chunkDestroy(Arena *arena, Chunk *chunk)
+{
+  if (chunk->prev != NULL)
+    chunk->prev->next = chunk->next;
+  else
+    arena->chunks = chunk->next;
+
+  if (chunk->next != NULL)
+    chunk->next->prev = chunk->prev;
+
+  free(chunk);
+}
+
+/* Public functions */
+
+Arena *arenaCreate(void)
+{
+  Arena *arena = calloc(1, sizeof(Arena));
+
+  return arena;
+}
+
+void *arenaAlloc(Arena *arena, size_t size)
+{
+  if (size > ARENA_MAX_SMALL)
+    return chunkData(chunkCreate(arena, size));
+
+  size_t class = sizeClass(size);
+
+  FreeBlock *block = arena->freeLists[class];
+
+  if (block != NULL)
+  {
+    arena->freeLists[class] = block->next;
+
+    return block;
+  }
+
+  size_t rounded = (class + 1) * ARENA_ALIGN;
+
+  Chunk *chunk = arena->current;
+
+  if (chunk == NULL || chunk->used + rounded > chunk->size)
+  {
+    chunk = chunkCreate(arena, ARENA_CHUNK_SIZE);
+
+    arena->current = chunk;
+  }
+
+  void *ptr = chunkData(chunk) + chunk->used;
+
+  chunk->used += rounded;
+
+  return ptr;
+}
+
+/* size has to be the size the block was allocated with */
+void arenaFree(Arena *arena, void *ptr, size_t size)
+{
+  if (ptr == NULL)
+    return;
+
+  if (size > ARENA_MAX_SMALL)
+  {
+    chunkDestroy(arena, (Chunk *)((uint8_t *)ptr - headerSize()));
+
+    return;
+  }
+
+  size_t class = sizeClass(size);
+
+  FreeBlock *block = ptr;
+
+  block->next = arena->freeLists[class];
+
+  arena->freeLists[class] = block;
+}
+
+void arenaDestroy(Arena *arena)
+{
+  if (arena == NULL)
+    return;
+
+  Chunk *chunk = arena->chunks;
+
+  while (chunk != NULL)
+  {
+    Chunk *next = chunk->next;
+
+    free(chunk);
+
+    chunk = next;
+  }
+
+  free(arena);
+}
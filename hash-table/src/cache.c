@@ -0,0 +1,311 @@
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <time.h>
+
+#include "hash-table-internal.h"
+
+/*
+  Cache mode of the chained table. Cache entries extend Entry with the
+  links of a ring that holds every entry in insertion order, a reference
+  bit, an expiry time and a cost. Eviction is CLOCK: a hand walks the
+  ring, clears the reference bit of entries that were read since it last
+  passed and evicts the first one that was not, or that has expired. Every
+  operation is O(1), eviction amortised over the bits it clears. While
+  entries have a TTL each insert also moves the hand a few steps to drop
+  expired ones, so entries nobody reads again do not stay until the
+  budget runs out, or for ever without one.
+*/
+
+/* Ring positions each insert looks at for expired entries, more than one so the hand outruns the inserts */
+#define EXPIRE_STEPS 2
+
+/* Private */
+
+static uint64_t nowMs(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+
+  return (uint64_t)ts.tv_sec * 1000 + (uint64_t)ts.tv_nsec / 1000000;
+}
+
+static inline size_t chargeOf(CacheEntry *ce)
+{
+  return sizeof(CacheEntry) + hashKeyHeapSize(&ce->entry.key) + ce->cost;
+}
+
+static inline bool isExpired(CacheEntry *ce, uint64_t now)
+{
+  return ce->expires != 0 && ce->expires <= now;
+}
+
+static bool overBudget(HashTableCache *cache, uint32_t count)
+{
+  if (cache->maxEntries != 0 && count > cache->maxEntries)
+    return true;
+
+  return cache->maxBytes != 0 && cache->bytes > cache->maxBytes;
+}
+
+/* Hands the entry to onEvict and removes it through the table */
+static void cacheDrop(HashTable *ht, CacheEntry *ce)
+{
+  HashTableCache *cache = ht->cache;
+
+  Entry *e = &ce->entry;
+
+  if (cache->onEvict != NULL)
+    cache->onEvict(cache->onEvictCtx, hashKeyBytes(&e->key), e->key.len, e->value);
+
+  ht->remove(ht, hashKeyBytes(&e->key), e->key.len, e->hash);
+}
+
+/* Public functions */
+
+HashTableCache *cacheCreate(const HashTableOptions *options)
+{
+  if (options->maxEntries == 0 && options->maxBytes == 0 && options->ttl == 0)
+    return NULL;
+
+  HashTableCache *cache = calloc(1, sizeof(HashTableCache));
+
+  cache->maxEntries = options->maxEntries;
+
+  cache->maxBytes = options->maxBytes;
+
+  cache->ttl = options->ttl;
+
+  cache->nextTtl = options->ttl;
+
+  cache->onEvict = options->onEvict;
+
+  cache->onEvictCtx = options->onEvictCtx;
+
+  return cache;
+}
+
+/* New entries go right behind the hand, the last place it looks at */
+void cacheLink(HashTable *ht, Entry *e)
+{
+  HashTableCache *cache = ht->cache;
+
+  CacheEntry *ce = (CacheEntry *)e;
+
+  ce->referenced = false;
+
+  ce->cost = cache->nextCost;
+
+  ce->expires = cache->nextTtl == 0 ? 0 : nowMs() + cache->nextTtl;
+
+  if (ce->expires != 0)
+    cache->timed++;
+
+  cache->nextCost = 0;
+
+  cache->nextTtl = cache->ttl;
+
+  if (cache->hand == NULL)
+  {
+    ce->prev = ce;
+
+    ce->next = ce;
+
+    cache->hand = ce;
+  }
+  else
+  {
+    ce->next = cache->hand;
+
+    ce->prev = cache->hand->prev;
+
+    ce->prev->next = ce;
+
+    cache->hand->prev = ce;
+  }
+
+  cache->bytes += chargeOf(ce);
+}
+
+void cacheUnlink(HashTable *ht, Entry *e)
+{
+  HashTableCache *cache = ht->cache;
+
+  CacheEntry *ce = (CacheEntry *)e;
+
+  if (ce->expires != 0)
+    cache->timed--;
+
+  if (ce->next == ce)
+  {
+    cache->hand = NULL;
+  }
+  else
+  {
+    if (cache->hand == ce)
+      cache->hand = ce->next;
+
+    ce->prev->next = ce->next;
+
+    ce->next->prev = ce->prev;
+  }
+
+  cache->bytes -= chargeOf(ce);
+}
+
+/* Removes e and returns true when it has expired */
+bool cacheExpire(HashTable *ht, Entry *e)
+{
+  CacheEntry *ce = (CacheEntry *)e;
+
+  if (ce->expires == 0 || !isExpired(ce, nowMs()))
+    return false;
+
+  ht->cache->stats.expirations++;
+
+  cacheDrop(ht, ce);
+
+  return true;
+}
+
+/*
+  Called on every lookup that found e. Returns false when e has expired,
+  it is removed then and the lookup counts as a miss
+*/
+bool cacheHit(HashTable *ht, Entry *e)
+{
+  HashTableCache *cache = ht->cache;
+
+  if (cacheExpire(ht, e))
+  {
+    cache->stats.misses++;
+
+    return false;
+  }
+
+  ((CacheEntry *)e)->referenced = true;
+
+  cache->stats.hits++;
+
+  return true;
+}
+
+void cacheMiss(HashTable *ht)
+{
+  ht->cache->stats.misses++;
+}
+
+/*
+  Runs the hand until the table is back within its budget, then a few steps
+  further for expired entries. keep, the entry that was just added, is
+  passed over so a slot handed out for it stays valid
+*/
+void cacheEnforce(HashTable *ht, Entry *keep)
+{
+  HashTableCache *cache = ht->cache;
+
+  uint64_t now = 0;
+
+  while (cache->hand != NULL && overBudget(cache, ht->count))
+  {
+    CacheEntry *ce = cache->hand;
+
+    if (&ce->entry == keep)
+    {
+      if (ce->next == ce)
+        break;
+
+      cache->hand = ce->next;
+
+      continue;
+    }
+
+    if (ce->expires != 0 && now == 0)
+      now = nowMs();
+
+    if (ce->referenced && !isExpired(ce, now))
+    {
+      ce->referenced = false;
+
+      cache->hand = ce->next;
+
+      continue;
+    }
+
+    if (isExpired(ce, now))
+      cache->stats.expirations++;
+    else
+      cache->stats.evictions++;
+
+    cacheDrop(ht, ce);
+  }
+
+  if (cache->timed == 0)
+    return;
+
+  now = nowMs();
+
+  for (int step = 0; step < EXPIRE_STEPS && cache->hand != NULL; step++)
+  {
+    CacheEntry *ce = cache->hand;
+
+    if (&ce->entry == keep || !isExpired(ce, now))
+    {
+      if (ce->next == ce)
+        break;
+
+      cache->hand = ce->next;
+
+      continue;
+    }
+
+    cache->stats.expirations++;
+
+    /* Unlinking moves the hand on */
+    cacheDrop(ht, ce);
+  }
+}
+
+/*
+  Adds key like hashTableAdd. In cache mode the entry expires after ttl
+  milliseconds (0 keeps the table default) and cost bytes are charged to
+  the memory budget for its value
+*/
+bool hashTableCacheAdd(HashTable *ht, const char *key, void *value, size_t cost, uint64_t ttl)
+{
+  if (ht == NULL || key == NULL)
+    return false;
+
+  if (ht->cache != NULL)
+  {
+    ht->cache->nextCost = cost;
+
+    ht->cache->nextTtl = ttl != 0 ? ttl : ht->cache->ttl;
+  }
+
+  bool added = hashTableAdd(ht, key, value);
+
+  /* Nothing was linked when key was already there */
+  if (ht->cache != NULL)
+  {
+    ht->cache->nextCost = 0;
+
+    ht->cache->nextTtl = ht->cache->ttl;
+  }
+
+  return added;
+}
+
+/* Fills stats and returns true for a table in cache mode */
+bool hashTableCacheStats(HashTable *ht, HashTableCacheStats *stats)
+{
+  if (ht == NULL || ht->cache == NULL || stats == NULL)
+    return false;
+
+  *stats = ht->cache->stats;
+
+  stats->bytes = ht->cache->bytes;
+
+  return true;
+}
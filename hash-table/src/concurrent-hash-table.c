@@ -0,0 +1,370 @@
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include <pthread.h>
+
+#include "concurrent-hash-table.h"
+#include "hash-table-internal.h"
+#include "epoch.h"
+
+/* Private */
+
+/* Power of two, a bucket belongs to stripe bucket & (STRIPES - 1) */
+#define STRIPES 64
+
+#define LOAD_FACTOR 0.75
+
+typedef struct CEntry CEntry;
+
+struct CEntry
+{
+  EpochNode retired;
+  uint64_t hash;
+  char *key;
+  void *value;
+  _Atomic(CEntry *) next;
+};
+
+typedef struct BucketArray
+{
+  EpochNode retired;
+  uint32_t size;
+  _Atomic(CEntry *) buckets[];
+} BucketArray;
+
+typedef struct Stripe
+{
+  _Alignas(64) pthread_mutex_t lock;
+  uint32_t count;
+} Stripe;
+
+struct ConcurrentHashTable
+{
+  _Atomic(BucketArray *) current;
+  hashFunction *hash;
+  Stripe stripes[STRIPES];
+};
+
+static void freeEntryAndKey(EpochNode *node)
+{
+  CEntry *e = (CEntry *)node;
+
+  free(e->key);
+
+  free(e);
+}
+
+/* Entries copied by a resize handed their key over to the copy */
+static void freeBucketArrayAndEntries(EpochNode *node)
+{
+  BucketArray *array = (BucketArray *)node;
+
+  for (uint32_t i = 0; i < array->size; i++)
+  {
+    CEntry *e = atomic_load_explicit(&array->buckets[i], memory_order_relaxed);
+
+    while (e != NULL)
+    {
+      CEntry *next = atomic_load_explicit(&e->next, memory_order_relaxed);
+
+      free(e);
+
+      e = next;
+    }
+  }
+
+  free(array);
+}
+
+static BucketArray *bucketArrayCreate(uint32_t size)
+{
+  BucketArray *array = calloc(1, sizeof(BucketArray) + sizeof(_Atomic(CEntry *)) * size);
+
+  array->size = size;
+
+  return array;
+}
+
+static inline Stripe *stripeOf(ConcurrentHashTable *cht, uint64_t hash)
+{
+  return &cht->stripes[hash & (STRIPES - 1)];
+}
+
+/* Only valid while holding a stripe lock, resizes hold all of them */
+static inline BucketArray *lockedArray(ConcurrentHashTable *cht)
+{
+  return atomic_load_explicit(&cht->current, memory_order_relaxed);
+}
+
+static _Atomic(CEntry *) *findLink(_Atomic(CEntry *) *link, const char *key, uint64_t hash)
+{
+  CEntry *e;
+
+  while ((e = atomic_load_explicit(link, memory_order_relaxed)) != NULL)
+  {
+    if (e->hash == hash && strcmp(key, e->key) == 0)
+      return link;
+
+    link = &e->next;
+  }
+
+  return NULL;
+}
+
+static void lockAll(ConcurrentHashTable *cht)
+{
+  for (uint32_t i = 0; i < STRIPES; i++)
+    pthread_mutex_lock(&cht->stripes[i].lock);
+}
+
+static void unlockAll(ConcurrentHashTable *cht)
+{
+  for (uint32_t i = STRIPES; i > 0; i--)
+    pthread_mutex_unlock(&cht->stripes[i - 1].lock);
+}
+
+/*
+  Builds the new bucket array out of copies of the entries, so readers that
+  are still walking the old chains see them unchanged until they leave
+*/
+static void resize(ConcurrentHashTable *cht, BucketArray *seen)
+{
+  lockAll(cht);
+
+  BucketArray *old = lockedArray(cht);
+
+  /* Someone else got here first */
+  if (old != seen)
+  {
+    unlockAll(cht);
+
+    return;
+  }
+
+  BucketArray *array = bucketArrayCreate(old->size * 2);
+
+  for (uint32_t i = 0; i < old->size; i++)
+  {
+    CEntry *e = atomic_load_explicit(&old->buckets[i], memory_order_relaxed);
+
+    while (e != NULL)
+    {
+      CEntry *next = atomic_load_explicit(&e->next, memory_order_relaxed);
+
+      CEntry *copy = malloc(sizeof(CEntry));
+
+      uint32_t index = e->hash & (array->size - 1);
+
+      copy->hash = e->hash;
+
+      copy->key = e->key;
+
+      copy->value = e->value;
+
+      atomic_init(&copy->next, atomic_load_explicit(&array->buckets[index], memory_order_relaxed));
+
+      atomic_init(&array->buckets[index], copy);
+
+      e = next;
+    }
+  }
+
+  atomic_store_explicit(&cht->current, array, memory_order_release);
+
+  epochRetire(&old->retired, freeBucketArrayAndEntries);
+
+  unlockAll(cht);
+}
+
+/* Public functions */
+
+void *concurrentHashTableGet(ConcurrentHashTable *cht, const char *key)
+{
+  if (cht == NULL || key == NULL)
+    return NULL;
+
+  uint64_t hash = cht->hash(key);
+
+  void *value = NULL;
+
+  epochEnter();
+
+  BucketArray *array = atomic_load_explicit(&cht->current, memory_order_acquire);
+
+  CEntry *e = atomic_load_explicit(&array->buckets[hash & (array->size - 1)], memory_order_acquire);
+
+  while (e != NULL)
+  {
+    if (e->hash == hash && strcmp(key, e->key) == 0)
+    {
+      value = e->value;
+
+      break;
+    }
+
+    e = atomic_load_explicit(&e->next, memory_order_acquire);
+  }
+
+  epochExit();
+
+  return value;
+}
+
+bool concurrentHashTableAdd(ConcurrentHashTable *cht, const char *key, void *value)
+{
+  if (cht == NULL || key == NULL)
+    return false;
+
+  uint64_t hash = cht->hash(key);
+
+  Stripe *stripe = stripeOf(cht, hash);
+
+  pthread_mutex_lock(&stripe->lock);
+
+  BucketArray *array = lockedArray(cht);
+
+  _Atomic(CEntry *) *bucket = &array->buckets[hash & (array->size - 1)];
+
+  if (findLink(bucket, key, hash) != NULL)
+  {
+    pthread_mutex_unlock(&stripe->lock);
+
+    return false;
+  }
+
+  CEntry *e = malloc(sizeof(CEntry));
+
+  e->hash = hash;
+
+  e->key = strdup(key);
+
+  e->value = value;
+
+  atomic_init(&e->next, atomic_load_explicit(bucket, memory_order_relaxed));
+
+  /* Release so a reader that finds e also sees its fields */
+  atomic_store_explicit(bucket, e, memory_order_release);
+
+  /* Every stripe owns size / STRIPES buckets, grow once one of them is full */
+  bool grow = ++stripe->count > array->size / STRIPES * LOAD_FACTOR;
+
+  pthread_mutex_unlock(&stripe->lock);
+
+  if (grow)
+    resize(cht, array);
+
+  return true;
+}
+
+bool concurrentHashTableRemove(ConcurrentHashTable *cht, const char *key)
+{
+  if (cht == NULL || key == NULL)
+    return false;
+
+  uint64_t hash = cht->hash(key);
+
+  Stripe *stripe = stripeOf(cht, hash);
+
+  pthread_mutex_lock(&stripe->lock);
+
+  BucketArray *array = lockedArray(cht);
+
+  _Atomic(CEntry *) *link = findLink(&array->buckets[hash & (array->size - 1)], key, hash);
+
+  if (link == NULL)
+  {
+    pthread_mutex_unlock(&stripe->lock);
+
+    return false;
+  }
+
+  CEntry *e = atomic_load_explicit(link, memory_order_relaxed);
+
+  /* Readers standing on e can still follow its next pointer */
+  atomic_store_explicit(link, atomic_load_explicit(&e->next, memory_order_relaxed), memory_order_release);
+
+  stripe->count--;
+
+  pthread_mutex_unlock(&stripe->lock);
+
+  epochRetire(&e->retired, freeEntryAndKey);
+
+  return true;
+}
+
+uint32_t concurrentHashTableCount(ConcurrentHashTable *cht)
+{
+  uint32_t count = 0;
+
+  for (uint32_t i = 0; i < STRIPES; i++)
+  {
+    pthread_mutex_lock(&cht->stripes[i].lock);
+
+    count += cht->stripes[i].count;
+
+    pthread_mutex_unlock(&cht->stripes[i].lock);
+  }
+
+  return count;
+}
+
+void concurrentHashTableDestroy(ConcurrentHashTable *cht)
+{
+  if (cht == NULL)
+    return;
+
+  BucketArray *array = lockedArray(cht);
+
+  for (uint32_t i = 0; i < array->size; i++)
+  {
+    CEntry *e = atomic_load_explicit(&array->buckets[i], memory_order_relaxed);
+
+    while (e != NULL)
+    {
+      CEntry *next = atomic_load_explicit(&e->next, memory_order_relaxed);
+
+      freeEntryAndKey(&e->retired);
+
+      e = next;
+    }
+  }
+
+  free(array);
+
+  for (uint32_t i = 0; i < STRIPES; i++)
+    pthread_mutex_destroy(&cht->stripes[i].lock);
+
+  free(cht);
+
+  epochReclaim();
+}
+
+/*
+  Creates a new ConcurrentHashTable, size is rounded up to a power of two
+  of at least one bucket per stripe
+*/
+ConcurrentHashTable *concurrentHashTableCreate(uint32_t size, hashFunction *hf)
+{
+  /* Stripes are cache line aligned, the table has to be as well */
+  ConcurrentHashTable *cht = aligned_alloc(_Alignof(ConcurrentHashTable), sizeof(ConcurrentHashTable));
+
+  uint32_t buckets = STRIPES;
+
+  while (buckets < size)
+    buckets *= 2;
+
+  atomic_init(&cht->current, bucketArrayCreate(buckets));
+
+  cht->hash = hf == NULL ? djb2HashFunction : hf;
+
+  for (uint32_t i = 0; i < STRIPES; i++)
+  {
+    pthread_mutex_init(&cht->stripes[i].lock, NULL);
+
+    cht->stripes[i].count = 0;
+  }
+
+  return cht;
+}
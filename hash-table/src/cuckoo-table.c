@@ -0,0 +1,638 @@
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stdio.h>
+
+#include "hash-table-internal.h"
+
+/*
+  Bucketized cuckoo hashing. Every key has two candidate buckets of four
+  slots each, so a lookup never looks at more than two buckets. An insert
+  into two full buckets kicks a resident out to its other bucket, which
+  may kick out another one, until a free slot turns up. A one byte tag per
+  slot lets lookups skip most slots without touching their keys.
+
+  Entries that find no place while the table is still sparse, because too
+  many keys share their buckets, go to a small stash that lookups scan
+  when it is not empty.
+*/
+
+/* Private */
+
+#define BUCKET_SLOTS 4
+
+/* Grows above 95/100 of the slots, four way buckets still fill that far */
+#define MAX_LOAD_NUM 95
+#define MAX_LOAD_DEN 100
+
+/* Length of a displacement chain before the table grows instead */
+#define MAX_KICKS 500
+
+typedef struct CuckooSlot
+{
+  uint64_t hash;
+  void *value;
+  HashKey key;
+} CuckooSlot;
+
+/* A tag of 0 marks an empty slot */
+typedef struct CuckooBucket
+{
+  uint8_t tags[BUCKET_SLOTS];
+  CuckooSlot slots[BUCKET_SLOTS];
+} CuckooBucket;
+
+typedef struct CuckooTable
+{
+  HashTable base;
+  CuckooBucket *buckets;
+  uint32_t mask;
+  /* Rotates the victim slot so kicks do not bounce between two entries */
+  uint32_t victim;
+  CuckooSlot *stash;
+  uint32_t stashCount;
+  uint32_t stashCapacity;
+} CuckooTable;
+
+/* djb2 and friends leave the high bits weak, spread them before masking */
+static inline uint64_t cuckooHash(uint64_t hash)
+{
+  hash *= 0x9E3779B97F4A7C15ULL;
+
+  return hash ^ (hash >> 32);
+}
+
+static inline uint8_t tagOf(uint64_t hash)
+{
+  uint8_t tag = (uint8_t)(hash >> 56);
+
+  return tag == 0 ? 1 : tag;
+}
+
+static inline uint32_t firstBucket(CuckooTable *ct, uint64_t hash)
+{
+  return (uint32_t)hash & ct->mask;
+}
+
+/* Both buckets are masked hash bits, so a resize keeps their low bits */
+static inline uint32_t secondBucket(CuckooTable *ct, uint64_t hash)
+{
+  return (uint32_t)(hash >> 32) & ct->mask;
+}
+
+static inline uint32_t otherBucket(CuckooTable *ct, uint64_t hash, uint32_t bucket)
+{
+  uint32_t first = firstBucket(ct, hash);
+
+  return bucket == first ? secondBucket(ct, hash) : first;
+}
+
+static inline uint32_t capacityOf(CuckooTable *ct)
+{
+  return (ct->mask + 1) * BUCKET_SLOTS;
+}
+
+static inline uint32_t maxCount(uint32_t capacity)
+{
+  return (uint32_t)((uint64_t)capacity * MAX_LOAD_NUM / MAX_LOAD_DEN);
+}
+
+static int32_t bucketFind(CuckooBucket *bucket, const void *key, size_t len, uint64_t hash)
+{
+  uint8_t tag = tagOf(hash);
+
+  for (int32_t i = 0; i < BUCKET_SLOTS; i++)
+  {
+    if (bucket->tags[i] == tag && bucket->slots[i].hash == hash && hashKeyEquals(&bucket->slots[i].key, key, len))
+      return i;
+  }
+
+  return -1;
+}
+
+static void stashPush(CuckooTable *ct, const CuckooSlot *slot)
+{
+  if (ct->stashCount == ct->stashCapacity)
+  {
+    ct->stashCapacity = ct->stashCapacity * 2 + 4;
+
+    ct->stash = realloc(ct->stash, sizeof(CuckooSlot) * ct->stashCapacity);
+  }
+
+  ct->stash[ct->stashCount++] = *slot;
+}
+
+static int64_t stashFind(CuckooTable *ct, const void *key, size_t len, uint64_t hash)
+{
+  for (uint32_t i = 0; i < ct->stashCount; i++)
+  {
+    if (ct->stash[i].hash == hash && hashKeyEquals(&ct->stash[i].key, key, len))
+      return i;
+  }
+
+  return -1;
+}
+
+/*
+  A miss in both buckets counts the stash as a third probe when it is in
+  use. tag is set to NULL for an entry found in the stash
+*/
+static CuckooSlot *cuckooFind(CuckooTable *ct, const void *key, size_t len, uint64_t hash, uint8_t **tag, uint32_t *probes)
+{
+  uint32_t candidates[2] = {firstBucket(ct, hash), secondBucket(ct, hash)};
+
+  for (uint32_t i = 0; i < 2; i++)
+  {
+    CuckooBucket *bucket = &ct->buckets[candidates[i]];
+
+    int32_t slot = bucketFind(bucket, key, len, hash);
+
+    *probes = i + 1;
+
+    if (slot >= 0)
+    {
+      if (tag != NULL)
+        *tag = &bucket->tags[slot];
+
+      return &bucket->slots[slot];
+    }
+  }
+
+  if (ct->stashCount == 0)
+    return NULL;
+
+  *probes = 3;
+
+  int64_t index = stashFind(ct, key, len, hash);
+
+  if (tag != NULL)
+    *tag = NULL;
+
+  return index < 0 ? NULL : &ct->stash[index];
+}
+
+/* cuckooFind for the operations, counted in the stats */
+static inline CuckooSlot *cuckooLookup(CuckooTable *ct, const void *key, size_t len, uint64_t hash, uint8_t **tag)
+{
+  uint32_t probes;
+
+  CuckooSlot *slot = cuckooFind(ct, key, len, hash, tag, &probes);
+
+  HASH_STAT_ADD(&ct->base, lookups, 1);
+
+  HASH_STAT_ADD(&ct->base, probes, probes);
+
+  return slot;
+}
+
+static bool bucketInsert(CuckooBucket *bucket, const CuckooSlot *slot)
+{
+  for (uint32_t i = 0; i < BUCKET_SLOTS; i++)
+  {
+    if (bucket->tags[i] == 0)
+    {
+      bucket->tags[i] = tagOf(slot->hash);
+
+      bucket->slots[i] = *slot;
+
+      return true;
+    }
+  }
+
+  return false;
+}
+
+/*
+  Places *slot, kicking residents along their other bucket when both of
+  its own are full. Fails after MAX_KICKS with *slot set to whichever entry
+  is left without a place, the rest of the table is intact
+*/
+static bool cuckooPlace(CuckooTable *ct, CuckooSlot *slot)
+{
+  uint32_t bucket = firstBucket(ct, slot->hash);
+
+  if (bucketInsert(&ct->buckets[bucket], slot))
+    return true;
+
+  bucket = secondBucket(ct, slot->hash);
+
+  for (uint32_t kick = 0; kick < MAX_KICKS; kick++)
+  {
+    if (bucketInsert(&ct->buckets[bucket], slot))
+      return true;
+
+    uint32_t victim = ct->victim++ % BUCKET_SLOTS;
+
+    CuckooSlot evicted = ct->buckets[bucket].slots[victim];
+
+    ct->buckets[bucket].slots[victim] = *slot;
+
+    ct->buckets[bucket].tags[victim] = tagOf(slot->hash);
+
+    *slot = evicted;
+
+    bucket = otherBucket(ct, slot->hash, bucket);
+  }
+
+  return false;
+}
+
+static void cuckooAllocate(CuckooTable *ct, uint32_t buckets)
+{
+  ct->buckets = malloc(sizeof(CuckooBucket) * buckets);
+
+  for (uint32_t i = 0; i < buckets; i++)
+    memset(ct->buckets[i].tags, 0, BUCKET_SLOTS);
+
+  ct->mask = buckets - 1;
+
+  ct->base.size = buckets * BUCKET_SLOTS;
+}
+
+/*
+  Doubles the buckets. Every entry keeps to the same one of its two
+  buckets, old bucket i only spreads over new buckets i and i + old size,
+  so everything fits without kicks and a scan cursor stays valid. Stashed
+  entries move into a bucket only where there is room
+*/
+static void cuckooResize(CuckooTable *ct)
+{
+  uint64_t started = HASH_STAT_NOW();
+
+  CuckooBucket *old = ct->buckets;
+
+  uint32_t oldMask = ct->mask;
+
+  cuckooAllocate(ct, (oldMask + 1) * 2);
+
+  for (uint32_t i = 0; i <= oldMask; i++)
+  {
+    for (uint32_t j = 0; j < BUCKET_SLOTS; j++)
+    {
+      if (old[i].tags[j] == 0)
+        continue;
+
+      CuckooSlot *slot = &old[i].slots[j];
+
+      bool first = ((uint32_t)slot->hash & oldMask) == i;
+
+      bucketInsert(&ct->buckets[first ? firstBucket(ct, slot->hash) : secondBucket(ct, slot->hash)], slot);
+    }
+  }
+
+  uint32_t kept = 0;
+
+  for (uint32_t i = 0; i < ct->stashCount; i++)
+  {
+    CuckooSlot *slot = &ct->stash[i];
+
+    if (!bucketInsert(&ct->buckets[firstBucket(ct, slot->hash)], slot) && !bucketInsert(&ct->buckets[secondBucket(ct, slot->hash)], slot))
+      ct->stash[kept++] = *slot;
+  }
+
+  ct->stashCount = kept;
+
+  free(old);
+
+  HASH_STAT_RESIZE(&ct->base, started);
+}
+
+/* Growing only helps once the table is reasonably full */
+static void cuckooPlaceOrStash(CuckooTable *ct, CuckooSlot *slot)
+{
+  while (!cuckooPlace(ct, slot))
+  {
+    if (ct->base.count < capacityOf(ct) / 2)
+    {
+      stashPush(ct, slot);
+
+      return;
+    }
+
+    cuckooResize(ct);
+  }
+}
+
+static void *cuckooGet(HashTable *ht, const void *key, size_t len, uint64_t hash)
+{
+  CuckooSlot *slot = cuckooLookup((CuckooTable *)ht, key, len, cuckooHash(hash), NULL);
+
+  return slot == NULL ? NULL : slot->value;
+}
+
+/* Adds key, which must not be in the table yet */
+static void cuckooInsert(CuckooTable *ct, const void *key, size_t len, uint64_t hash, void *value)
+{
+  if (ct->base.count + 1 > maxCount(capacityOf(ct)))
+    cuckooResize(ct);
+
+  CuckooSlot slot = {.hash = hash, .value = value};
+
+  hashKeySet(&ct->base, &slot.key, key, len);
+
+  cuckooPlaceOrStash(ct, &slot);
+
+  ct->base.count++;
+
+  ct->base.version++;
+}
+
+static bool cuckooAdd(HashTable *ht, const void *key, size_t len, uint64_t hash, void *value)
+{
+  CuckooTable *ct = (CuckooTable *)ht;
+
+  hash = cuckooHash(hash);
+
+  if (cuckooLookup(ct, key, len, hash, NULL) != NULL)
+    return false;
+
+  cuckooInsert(ct, key, len, hash, hashValueCopy(ht, value));
+
+  return true;
+}
+
+/*
+  Kicks can carry a new entry away from the slot it was put in, so an
+  insert looks it up again. That stays within its two buckets
+*/
+static void **cuckooGetOrInsert(HashTable *ht, const void *key, size_t len, uint64_t hash, bool *inserted)
+{
+  CuckooTable *ct = (CuckooTable *)ht;
+
+  hash = cuckooHash(hash);
+
+  CuckooSlot *slot = cuckooLookup(ct, key, len, hash, NULL);
+
+  *inserted = slot == NULL;
+
+  if (slot == NULL)
+  {
+    cuckooInsert(ct, key, len, hash, NULL);
+
+    slot = cuckooLookup(ct, key, len, hash, NULL);
+  }
+
+  return &slot->value;
+}
+
+static bool cuckooRemove(HashTable *ht, const void *key, size_t len, uint64_t hash)
+{
+  CuckooTable *ct = (CuckooTable *)ht;
+
+  uint8_t *tag;
+
+  CuckooSlot *slot = cuckooLookup(ct, key, len, cuckooHash(hash), &tag);
+
+  if (slot == NULL)
+    return false;
+
+  hashKeyFree(ht, &slot->key);
+
+  hashValueFree(ht, slot->value);
+
+  /* Stashed entries are swapped with the last one */
+  if (tag != NULL)
+    *tag = 0;
+  else
+    *slot = ct->stash[--ct->stashCount];
+
+  ht->count--;
+
+  ht->version++;
+
+  return true;
+}
+
+static void cuckooPrefetch(HashTable *ht, uint64_t hash, uint32_t stage)
+{
+  CuckooTable *ct = (CuckooTable *)ht;
+
+  hash = cuckooHash(hash);
+
+  /* Both buckets are needed for a miss, fetch them in one go */
+  if (stage == 0)
+  {
+    __builtin_prefetch(&ct->buckets[firstBucket(ct, hash)]);
+
+    __builtin_prefetch(&ct->buckets[secondBucket(ct, hash)]);
+  }
+}
+
+static uint32_t cuckooProbeLength(HashTable *ht, const void *key, size_t len, uint64_t hash)
+{
+  uint32_t probes;
+
+  cuckooFind((CuckooTable *)ht, key, len, cuckooHash(hash), NULL, &probes);
+
+  return probes;
+}
+
+static size_t cuckooMemoryUsage(HashTable *ht)
+{
+  CuckooTable *ct = (CuckooTable *)ht;
+
+  size_t bytes = sizeof(CuckooTable) + (size_t)(ct->mask + 1) * sizeof(CuckooBucket);
+
+  bytes += (size_t)ct->stashCapacity * sizeof(CuckooSlot);
+
+  for (uint32_t i = 0; i < ct->stashCount; i++)
+    bytes += hashKeyHeapSize(&ct->stash[i].key);
+
+  for (uint32_t i = 0; i <= ct->mask; i++)
+  {
+    for (uint32_t j = 0; j < BUCKET_SLOTS; j++)
+    {
+      if (ct->buckets[i].tags[j] != 0)
+        bytes += hashKeyHeapSize(&ct->buckets[i].slots[j].key);
+    }
+  }
+
+  return bytes;
+}
+
+/* A bucket is a chain, stashed entries are counted in no chain */
+static void cuckooStats(HashTable *ht, HashTableStats *stats)
+{
+  CuckooTable *ct = (CuckooTable *)ht;
+
+  stats->tableBytes = sizeof(CuckooTable) + (size_t)(ct->mask + 1) * sizeof(CuckooBucket);
+
+  stats->tableBytes += (size_t)ct->stashCapacity * sizeof(CuckooSlot);
+
+  for (uint32_t i = 0; i < ct->stashCount; i++)
+    stats->keyBytes += hashKeyHeapSize(&ct->stash[i].key);
+
+  for (uint32_t i = 0; i <= ct->mask; i++)
+  {
+    uint32_t length = 0;
+
+    for (uint32_t j = 0; j < BUCKET_SLOTS; j++)
+    {
+      if (ct->buckets[i].tags[j] == 0)
+        continue;
+
+      length++;
+
+      stats->keyBytes += hashKeyHeapSize(&ct->buckets[i].slots[j].key);
+    }
+
+    hashStatsChain(stats, length);
+  }
+}
+
+/*
+  A position is a bucket, the stash goes with position 0. An insert that
+  kicks an entry from a bucket the scan has not reached into one it has
+  passed can make the scan miss that entry, resizes never do
+*/
+static uint64_t cuckooScan(HashTable *ht, uint64_t cursor, hashTableVisit *visit, void *ctx)
+{
+  CuckooTable *ct = (CuckooTable *)ht;
+
+  CuckooBucket *bucket = &ct->buckets[cursor & ct->mask];
+
+  for (uint32_t i = 0; i < BUCKET_SLOTS; i++)
+  {
+    if (bucket->tags[i] != 0)
+      visit(ctx, hashKeyBytes(&bucket->slots[i].key), bucket->slots[i].key.len, bucket->slots[i].value);
+  }
+
+  if (cursor == 0)
+  {
+    for (uint32_t i = 0; i < ct->stashCount; i++)
+      visit(ctx, hashKeyBytes(&ct->stash[i].key), ct->stash[i].key.len, ct->stash[i].value);
+  }
+
+  return scanCursorNext(cursor, ct->mask);
+}
+
+static void cuckooForEach(HashTable *ht, hashTableVisit *visit, void *ctx)
+{
+  CuckooTable *ct = (CuckooTable *)ht;
+
+  for (uint32_t i = 0; i <= ct->mask; i++)
+  {
+    for (uint32_t j = 0; j < BUCKET_SLOTS; j++)
+    {
+      CuckooSlot *slot = &ct->buckets[i].slots[j];
+
+      if (ct->buckets[i].tags[j] != 0)
+        visit(ctx, hashKeyBytes(&slot->key), slot->key.len, slot->value);
+    }
+  }
+
+  for (uint32_t i = 0; i < ct->stashCount; i++)
+    visit(ctx, hashKeyBytes(&ct->stash[i].key), ct->stash[i].key.len, ct->stash[i].value);
+}
+
+static void cuckooDestroy(HashTable *ht)
+{
+  CuckooTable *ct = (CuckooTable *)ht;
+
+  if (ht->arena == NULL)
+  {
+    for (uint32_t i = 0; i <= ct->mask; i++)
+    {
+      for (uint32_t j = 0; j < BUCKET_SLOTS; j++)
+      {
+        if (ct->buckets[i].tags[j] != 0)
+          hashKeyFree(ht, &ct->buckets[i].slots[j].key);
+      }
+    }
+
+    for (uint32_t i = 0; i < ct->stashCount; i++)
+      hashKeyFree(ht, &ct->stash[i].key);
+  }
+
+  arenaDestroy(ht->arena);
+
+  free(ct->buckets);
+
+  free(ct->stash);
+
+  free(ct);
+}
+
+static void cuckooPrint(HashTable *ht)
+{
+  CuckooTable *ct = (CuckooTable *)ht;
+
+  printf("------ Cuckoo Table ------\n");
+
+  printf("count -> %u\n", ht->count);
+
+  printf("size -> %u\n", ht->size);
+
+  printf("stash -> %u\n\n", ct->stashCount);
+
+  printf("------ Entries ------\n");
+
+  for (uint32_t i = 0; i <= ct->mask; i++)
+  {
+    for (uint32_t j = 0; j < BUCKET_SLOTS; j++)
+    {
+      if (ct->buckets[i].tags[j] != 0)
+        printf("key -> %s, bucket -> %u, slot -> %u\n", hashKeyBytes(&ct->buckets[i].slots[j].key), i, j);
+    }
+  }
+
+  printf("-------------\n\n");
+}
+
+/* Public functions */
+
+HashTable *cuckooTableCreate(uint32_t size, const HashTableOptions *options)
+{
+  CuckooTable *ct = malloc(sizeof(CuckooTable));
+
+  hashTableInit(&ct->base, options);
+
+  uint32_t buckets = 2;
+
+  /* Room for size entries below the maximum load */
+  while (maxCount(buckets * BUCKET_SLOTS) < size)
+    buckets *= 2;
+
+  cuckooAllocate(ct, buckets);
+
+  ct->victim = 0;
+
+  ct->stash = NULL;
+
+  ct->stashCount = 0;
+
+  ct->stashCapacity = 0;
+
+  ct->base.type = HashTableCuckoo;
+
+  ct->base.initialSize = buckets * BUCKET_SLOTS;
+
+  ct->base.loadFactor = (double)MAX_LOAD_NUM / MAX_LOAD_DEN;
+
+  ct->base.get = cuckooGet;
+
+  ct->base.add = cuckooAdd;
+
+  ct->base.getOrInsert = cuckooGetOrInsert;
+
+  ct->base.prefetch = cuckooPrefetch;
+
+  ct->base.remove = cuckooRemove;
+
+  ct->base.probeLength = cuckooProbeLength;
+
+  ct->base.memoryUsage = cuckooMemoryUsage;
+
+  ct->base.scan = cuckooScan;
+
+  ct->base.stats = cuckooStats;
+
+  ct->base.forEach = cuckooForEach;
+
+  ct->base.destroy = cuckooDestroy;
+
+  ct->base.print = cuckooPrint;
+
+  return (HashTable *)ct;
+}
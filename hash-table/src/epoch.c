@@ -0,0 +1,235 @@
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include <pthread.h>
+
+#include "epoch.h"
+
+/* Private */
+
+#define EPOCH_INACTIVE UINT64_MAX
+
+/* Retired nodes a thread collects before it tries to free them */
+#define RECLAIM_THRESHOLD 64
+
+typedef struct EpochRecord EpochRecord;
+
+/* One per thread, records are reused after a thread exits but never freed */
+struct EpochRecord
+{
+  _Alignas(64) _Atomic uint64_t local;
+  atomic_bool inUse;
+  EpochRecord *next;
+};
+
+typedef struct EpochThread
+{
+  EpochRecord *record;
+  uint32_t depth;
+  EpochNode *limbo;
+  uint32_t limboCount;
+  uint32_t reclaimAt;
+} EpochThread;
+
+static _Atomic uint64_t globalEpoch = 1;
+
+static _Atomic(EpochRecord *) records = NULL;
+
+static pthread_once_t keyOnce = PTHREAD_ONCE_INIT;
+
+static pthread_key_t threadKey;
+
+/* Limbo lists of exited threads, freed by whoever reclaims next */
+static pthread_mutex_t orphanLock = PTHREAD_MUTEX_INITIALIZER;
+
+static EpochNode *orphans = NULL;
+
+static _Thread_local EpochThread self;
+
+static void threadExit(void *arg)
+{
+  EpochThread *t = arg;
+
+  if (t->limbo != NULL)
+  {
+    EpochNode *tail = t->limbo;
+
+    while (tail->next != NULL)
+      tail = tail->next;
+
+    pthread_mutex_lock(&orphanLock);
+
+    tail->next = orphans;
+
+    orphans = t->limbo;
+
+    pthread_mutex_unlock(&orphanLock);
+  }
+
+  atomic_store(&t->record->local, EPOCH_INACTIVE);
+
+  atomic_store(&t->record->inUse, false);
+
+  t->record = NULL;
+
+  t->limbo = NULL;
+
+  t->limboCount = 0;
+
+  t->reclaimAt = 0;
+}
+
+static void createKey(void)
+{
+  pthread_key_create(&threadKey, threadExit);
+}
+
+static EpochRecord *acquireRecord(void)
+{
+  pthread_once(&keyOnce, createKey);
+
+  pthread_setspecific(threadKey, &self);
+
+  for (EpochRecord *r = atomic_load(&records); r != NULL; r = r->next)
+  {
+    bool expected = false;
+
+    if (!atomic_load(&r->inUse) && atomic_compare_exchange_strong(&r->inUse, &expected, true))
+      return r;
+  }
+
+  EpochRecord *r = aligned_alloc(_Alignof(EpochRecord), sizeof(EpochRecord));
+
+  atomic_init(&r->local, EPOCH_INACTIVE);
+
+  atomic_init(&r->inUse, true);
+
+  r->next = atomic_load(&records);
+
+  while (!atomic_compare_exchange_weak(&records, &r->next, r))
+    ;
+
+  return r;
+}
+
+/* Oldest epoch a reader is still in, EPOCH_INACTIVE when there is none */
+static uint64_t minActiveEpoch(void)
+{
+  uint64_t min = EPOCH_INACTIVE;
+
+  atomic_thread_fence(memory_order_seq_cst);
+
+  for (EpochRecord *r = atomic_load(&records); r != NULL; r = r->next)
+  {
+    uint64_t local = atomic_load(&r->local);
+
+    if (local < min)
+      min = local;
+  }
+
+  return min;
+}
+
+/* Frees the nodes retired before safe and returns the ones left over */
+static EpochNode *freeBefore(EpochNode *list, uint64_t safe, uint32_t *left)
+{
+  EpochNode *keep = NULL;
+
+  *left = 0;
+
+  while (list != NULL)
+  {
+    EpochNode *next = list->next;
+
+    if (list->epoch < safe)
+    {
+      list->free(list);
+    }
+    else
+    {
+      list->next = keep;
+
+      keep = list;
+
+      (*left)++;
+    }
+
+    list = next;
+  }
+
+  return keep;
+}
+
+/* Public functions */
+
+void epochEnter(void)
+{
+  EpochThread *t = &self;
+
+  if (t->record == NULL)
+    t->record = acquireRecord();
+
+  if (t->depth++ > 0)
+    return;
+
+  atomic_store(&t->record->local, atomic_load(&globalEpoch));
+
+  /* Publish the epoch before reading anything it protects */
+  atomic_thread_fence(memory_order_seq_cst);
+}
+
+void epochExit(void)
+{
+  EpochThread *t = &self;
+
+  if (--t->depth > 0)
+    return;
+
+  atomic_store_explicit(&t->record->local, EPOCH_INACTIVE, memory_order_release);
+}
+
+/*
+  The node must already be unreachable for new readers, only readers that
+  entered before the unlink can still hold it
+*/
+void epochRetire(EpochNode *node, epochFreeFunction *freeFn)
+{
+  EpochThread *t = &self;
+
+  atomic_thread_fence(memory_order_seq_cst);
+
+  node->epoch = atomic_load(&globalEpoch);
+
+  node->free = freeFn;
+
+  node->next = t->limbo;
+
+  t->limbo = node;
+
+  if (++t->limboCount >= t->reclaimAt)
+    epochReclaim();
+}
+
+void epochReclaim(void)
+{
+  EpochThread *t = &self;
+
+  atomic_fetch_add(&globalEpoch, 1);
+
+  uint64_t safe = minActiveEpoch();
+
+  t->limbo = freeBefore(t->limbo, safe, &t->limboCount);
+
+  /* A long reader keeps nodes alive, do not rescan them on every retire */
+  t->reclaimAt = t->limboCount * 2 + RECLAIM_THRESHOLD;
+
+  if (pthread_mutex_trylock(&orphanLock) == 0)
+  {
+    uint32_t left;
+
+    orphans = freeBefore(orphans, safe, &left);
+
+    pthread_mutex_unlock(&orphanLock);
+  }
+}
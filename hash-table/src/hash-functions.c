@@ -0,0 +1,438 @@
+#include <stdint.h>
+#include <string.h>
+#include <stddef.h>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "hash-table.h"
+
+/*
+  Built-in hash functions for the hashFunction hook. djb2 handles one byte
+  per iteration, wyhash and the xxh3 style hash read 8 bytes at a time and
+  the latter switches to a vectorised loop for keys over 128 bytes. The
+  SSE2, AVX2 and scalar paths give the same hash for the same key.
+*/
+
+/* Private */
+
+#define PRIME32_1 0x9E3779B1U
+#define PRIME64_1 0x9E3779B185EBCA87ULL
+
+#define STRIPE_LEN 64
+#define SECRET_SIZE 192
+#define STRIPES_PER_BLOCK ((SECRET_SIZE - STRIPE_LEN) / 8)
+
+static const uint64_t secret64[SECRET_SIZE / 8] = {
+    0xE220A8397B1DCDAFULL, 0x6E789E6AA1B965F4ULL, 0x06C45D188009454FULL,
+    0xF88BB8A8724C81ECULL, 0x1B39896A51A8749BULL, 0x53CB9F0C747EA2EAULL,
+    0x2C829ABE1F4532E1ULL, 0xC584133AC916AB3CULL, 0x3EE5789041C98AC3ULL,
+    0xF3B8488C368CB0A6ULL, 0x657EECDD3CB13D09ULL, 0xC2D326E0055BDEF6ULL,
+    0x8621A03FE0BBDB7BULL, 0x8E1F7555983AA92FULL, 0xB54E0F1600CC4D19ULL,
+    0x84BB3F97971D80ABULL, 0x7D29825C75521255ULL, 0xC3CF17102B7F7F86ULL,
+    0x3466E9A083914F64ULL, 0xD81A8D2B5A4485ACULL, 0xDB01602B100B9ED7ULL,
+    0xA9038A921825F10DULL, 0xEDF5F1D90DCA2F6AULL, 0x54496AD67BD2634CULL,
+};
+
+static const uint8_t *secret = (const uint8_t *)secret64;
+
+static const uint64_t wySecret[4] = {
+    0xA0761D6478BD642FULL, 0xE7037ED1A0B428DBULL,
+    0x8EBC6AF09C88C6E3ULL, 0x589965CC75374CC3ULL};
+
+static inline uint64_t read64(const uint8_t *p)
+{
+  uint64_t v;
+
+  memcpy(&v, p, sizeof(v));
+
+  return v;
+}
+
+static inline uint64_t read32(const uint8_t *p)
+{
+  uint32_t v;
+
+  memcpy(&v, p, sizeof(v));
+
+  return v;
+}
+
+static inline uint64_t mul128Fold64(uint64_t a, uint64_t b)
+{
+  __uint128_t product = (__uint128_t)a * b;
+
+  return (uint64_t)product ^ (uint64_t)(product >> 64);
+}
+
+static inline uint64_t avalanche(uint64_t h)
+{
+  h ^= h >> 37;
+
+  h *= 0x165667919E3779F9ULL;
+
+  return h ^ (h >> 32);
+}
+
+static inline uint64_t mix16(const uint8_t *p, const uint8_t *key)
+{
+  return mul128Fold64(read64(p) ^ read64(key), read64(p + 8) ^ read64(key + 8));
+}
+
+/*
+  accumulate runs stripes consecutive stripes, the key moves 8 bytes per
+  stripe. The accumulators stay in registers for the whole run.
+*/
+
+#if defined(__AVX2__)
+
+static inline void accumulate(uint64_t *acc, const uint8_t *input, const uint8_t *key, size_t stripes)
+{
+  __m256i acc0 = _mm256_loadu_si256((const __m256i *)acc);
+
+  __m256i acc1 = _mm256_loadu_si256((const __m256i *)acc + 1);
+
+  for (size_t s = 0; s < stripes; s++, input += STRIPE_LEN, key += 8)
+  {
+    __m256i data0 = _mm256_loadu_si256((const __m256i *)input);
+
+    __m256i data1 = _mm256_loadu_si256((const __m256i *)input + 1);
+
+    __m256i dataKey0 = _mm256_xor_si256(data0, _mm256_loadu_si256((const __m256i *)key));
+
+    __m256i dataKey1 = _mm256_xor_si256(data1, _mm256_loadu_si256((const __m256i *)key + 1));
+
+    acc0 = _mm256_add_epi64(acc0, _mm256_shuffle_epi32(data0, _MM_SHUFFLE(1, 0, 3, 2)));
+
+    acc1 = _mm256_add_epi64(acc1, _mm256_shuffle_epi32(data1, _MM_SHUFFLE(1, 0, 3, 2)));
+
+    acc0 = _mm256_add_epi64(acc0, _mm256_mul_epu32(dataKey0, _mm256_shuffle_epi32(dataKey0, _MM_SHUFFLE(0, 3, 0, 1))));
+
+    acc1 = _mm256_add_epi64(acc1, _mm256_mul_epu32(dataKey1, _mm256_shuffle_epi32(dataKey1, _MM_SHUFFLE(0, 3, 0, 1))));
+  }
+
+  _mm256_storeu_si256((__m256i *)acc, acc0);
+
+  _mm256_storeu_si256((__m256i *)acc + 1, acc1);
+}
+
+static inline void scramble(uint64_t *acc, const uint8_t *key)
+{
+  const __m256i prime = _mm256_set1_epi32((int)PRIME32_1);
+
+  for (int i = 0; i < 2; i++)
+  {
+    __m256i accVec = _mm256_loadu_si256((const __m256i *)acc + i);
+
+    __m256i data = _mm256_xor_si256(accVec, _mm256_srli_epi64(accVec, 47));
+
+    __m256i dataKey = _mm256_xor_si256(data, _mm256_loadu_si256((const __m256i *)key + i));
+
+    __m256i lo = _mm256_mul_epu32(dataKey, prime);
+
+    __m256i hi = _mm256_mul_epu32(_mm256_shuffle_epi32(dataKey, _MM_SHUFFLE(0, 3, 0, 1)), prime);
+
+    _mm256_storeu_si256((__m256i *)acc + i, _mm256_add_epi64(lo, _mm256_slli_epi64(hi, 32)));
+  }
+}
+
+#elif defined(__SSE2__)
+
+static inline void accumulate(uint64_t *acc, const uint8_t *input, const uint8_t *key, size_t stripes)
+{
+  __m128i accVec[4];
+
+  for (int i = 0; i < 4; i++)
+    accVec[i] = _mm_loadu_si128((const __m128i *)acc + i);
+
+  for (size_t s = 0; s < stripes; s++, input += STRIPE_LEN, key += 8)
+  {
+    for (int i = 0; i < 4; i++)
+    {
+      __m128i data = _mm_loadu_si128((const __m128i *)input + i);
+
+      __m128i dataKey = _mm_xor_si128(data, _mm_loadu_si128((const __m128i *)key + i));
+
+      __m128i product = _mm_mul_epu32(dataKey, _mm_shuffle_epi32(dataKey, _MM_SHUFFLE(0, 3, 0, 1)));
+
+      /* Each lane also takes the data of its neighbour */
+      __m128i swapped = _mm_shuffle_epi32(data, _MM_SHUFFLE(1, 0, 3, 2));
+
+      accVec[i] = _mm_add_epi64(product, _mm_add_epi64(accVec[i], swapped));
+    }
+  }
+
+  for (int i = 0; i < 4; i++)
+    _mm_storeu_si128((__m128i *)acc + i, accVec[i]);
+}
+
+static inline void scramble(uint64_t *acc, const uint8_t *key)
+{
+  const __m128i prime = _mm_set1_epi32((int)PRIME32_1);
+
+  for (int i = 0; i < 4; i++)
+  {
+    __m128i accVec = _mm_loadu_si128((const __m128i *)acc + i);
+
+    __m128i data = _mm_xor_si128(accVec, _mm_srli_epi64(accVec, 47));
+
+    __m128i dataKey = _mm_xor_si128(data, _mm_loadu_si128((const __m128i *)key + i));
+
+    /* No 64 bit multiply in SSE2, split it in two 32 x 32 ones */
+    __m128i lo = _mm_mul_epu32(dataKey, prime);
+
+    __m128i hi = _mm_mul_epu32(_mm_shuffle_epi32(dataKey, _MM_SHUFFLE(0, 3, 0, 1)), prime);
+
+    _mm_storeu_si128((__m128i *)acc + i, _mm_add_epi64(lo, _mm_slli_epi64(hi, 32)));
+  }
+}
+
+#else
+
+static inline void accumulate(uint64_t *acc, const uint8_t *input, const uint8_t *key, size_t stripes)
+{
+  for (size_t s = 0; s < stripes; s++, input += STRIPE_LEN, key += 8)
+  {
+    for (int i = 0; i < 8; i++)
+    {
+      uint64_t data = read64(input + 8 * i);
+
+      uint64_t dataKey = data ^ read64(key + 8 * i);
+
+      acc[i ^ 1] += data;
+
+      acc[i] += (dataKey & 0xFFFFFFFFULL) * (dataKey >> 32);
+    }
+  }
+}
+
+static inline void scramble(uint64_t *acc, const uint8_t *key)
+{
+  for (int i = 0; i < 8; i++)
+  {
+    uint64_t a = acc[i];
+
+    a ^= a >> 47;
+
+    a ^= read64(key + 8 * i);
+
+    acc[i] = a * PRIME32_1;
+  }
+}
+
+#endif
+
+/* Keys over 128 bytes: 8 lanes over 64 byte stripes, scrambled per block */
+static uint64_t xxh3Long(const uint8_t *p, size_t len)
+{
+  uint64_t acc[8] = {PRIME32_1, PRIME64_1, 0xC2B2AE3D27D4EB4FULL, 0x165667B19E3779F9ULL,
+                     0x85EBCA77C2B2AE63ULL, 0x85EBCA77ULL, 0x27D4EB2F165667C5ULL, PRIME32_1};
+
+  size_t blockLen = STRIPE_LEN * STRIPES_PER_BLOCK;
+
+  size_t blocks = (len - 1) / blockLen;
+
+  for (size_t b = 0; b < blocks; b++)
+  {
+    accumulate(acc, p + b * blockLen, secret, STRIPES_PER_BLOCK);
+
+    scramble(acc, secret + SECRET_SIZE - STRIPE_LEN);
+  }
+
+  size_t stripes = ((len - 1) - blockLen * blocks) / STRIPE_LEN;
+
+  accumulate(acc, p + blocks * blockLen, secret, stripes);
+
+  /* The last stripe always ends at the last byte and may overlap */
+  accumulate(acc, p + len - STRIPE_LEN, secret + SECRET_SIZE - STRIPE_LEN - 7, 1);
+
+  uint64_t result = len * PRIME64_1;
+
+  for (int i = 0; i < 4; i++)
+    result += mul128Fold64(acc[2 * i] ^ read64(secret + 11 + 16 * i), acc[2 * i + 1] ^ read64(secret + 19 + 16 * i));
+
+  return avalanche(result);
+}
+
+static inline uint64_t wyMix(uint64_t a, uint64_t b)
+{
+  __uint128_t product = (__uint128_t)a * b;
+
+  return (uint64_t)product ^ (uint64_t)(product >> 64);
+}
+
+/* Public functions */
+
+uint64_t djb2HashFunction(const char *key)
+{
+  uint64_t hashValue = 5381;
+
+  int c;
+
+  while ((c = *key++))
+  {
+    hashValue = ((hashValue << 5) + hashValue) + c; /* hash * 33 + c */
+  }
+
+  key -= 1;
+
+  return hashValue;
+}
+
+uint64_t wyhash(const void *key, size_t len)
+{
+  const uint8_t *p = key;
+
+  uint64_t seed = wyMix(wySecret[0], wySecret[1]);
+
+  uint64_t a, b;
+
+  if (len <= 16)
+  {
+    if (len >= 4)
+    {
+      a = (read32(p) << 32) | read32(p + ((len >> 3) << 2));
+
+      b = (read32(p + len - 4) << 32) | read32(p + len - 4 - ((len >> 3) << 2));
+    }
+    else if (len > 0)
+    {
+      a = ((uint64_t)p[0] << 16) | ((uint64_t)p[len >> 1] << 8) | p[len - 1];
+
+      b = 0;
+    }
+    else
+    {
+      a = b = 0;
+    }
+  }
+  else
+  {
+    size_t i = len;
+
+    if (i > 48)
+    {
+      uint64_t see1 = seed, see2 = seed;
+
+      do
+      {
+        seed = wyMix(read64(p) ^ wySecret[1], read64(p + 8) ^ seed);
+
+        see1 = wyMix(read64(p + 16) ^ wySecret[2], read64(p + 24) ^ see1);
+
+        see2 = wyMix(read64(p + 32) ^ wySecret[3], read64(p + 40) ^ see2);
+
+        p += 48;
+
+        i -= 48;
+      } while (i > 48);
+
+      seed ^= see1 ^ see2;
+    }
+
+    while (i > 16)
+    {
+      seed = wyMix(read64(p) ^ wySecret[1], read64(p + 8) ^ seed);
+
+      i -= 16;
+
+      p += 16;
+    }
+
+    a = read64(p + i - 16);
+
+    b = read64(p + i - 8);
+  }
+
+  a ^= wySecret[1];
+
+  b ^= seed;
+
+  __uint128_t product = (__uint128_t)a * b;
+
+  a = (uint64_t)product;
+
+  b = (uint64_t)(product >> 64);
+
+  return wyMix(a ^ wySecret[0] ^ len, b ^ wySecret[1]);
+}
+
+uint64_t xxh3Hash(const void *key, size_t len)
+{
+  const uint8_t *p = key;
+
+  if (len > 128)
+    return xxh3Long(p, len);
+
+  if (len > 16)
+  {
+    uint64_t acc = len * PRIME64_1;
+
+    if (len > 32)
+    {
+      if (len > 64)
+      {
+        if (len > 96)
+        {
+          acc += mix16(p + 48, secret + 96);
+
+          acc += mix16(p + len - 64, secret + 112);
+        }
+
+        acc += mix16(p + 32, secret + 64);
+
+        acc += mix16(p + len - 48, secret + 80);
+      }
+
+      acc += mix16(p + 16, secret + 32);
+
+      acc += mix16(p + len - 32, secret + 48);
+    }
+
+    acc += mix16(p, secret);
+
+    acc += mix16(p + len - 16, secret + 16);
+
+    return avalanche(acc);
+  }
+
+  if (len > 8)
+  {
+    uint64_t lo = read64(p) ^ (read64(secret + 24) ^ read64(secret + 32));
+
+    uint64_t hi = read64(p + len - 8) ^ (read64(secret + 40) ^ read64(secret + 48));
+
+    return avalanche(len + __builtin_bswap64(lo) + hi + mul128Fold64(lo, hi));
+  }
+
+  if (len >= 4)
+  {
+    uint64_t input = read32(p + len - 4) + (read32(p) << 32);
+
+    uint64_t keyed = input ^ (read64(secret + 8) ^ read64(secret + 16));
+
+    return avalanche(mul128Fold64(keyed, PRIME64_1 + (len << 2)));
+  }
+
+  if (len > 0)
+  {
+    uint64_t combined = ((uint64_t)p[0] << 16) | ((uint64_t)p[len >> 1] << 24) | p[len - 1] | (len << 8);
+
+    return avalanche((combined ^ (read32(secret) ^ read32(secret + 4))) * PRIME64_1);
+  }
+
+  return avalanche(read64(secret + 56) ^ read64(secret + 64));
+}
+
+uint64_t wyhashHashFunction(const char *key)
+{
+  return wyhash(key, strlen(key));
+}
+
+uint64_t xxh3HashFunction(const char *key)
+{
+  return xxh3Hash(key, strlen(key));
+}
@@ -4,111 +4,437 @@
 #include <stdbool.h>
 #include <stdio.h>
 
-#include "hash-table.h"
+#include "hash-table-internal.h"
+#include "arena.h"
 
 /* Private */
 
-struct Entry
+/* Old buckets moved per operation while an incremental resize is running */
+#define REHASH_STEP 4
+
+/* Empty old buckets skipped per moved bucket before a step gives up */
+#define REHASH_EMPTY_VISITS 10
+
+/* Keys hashed and prefetched ahead of the lookups in the batch functions */
+#define HASH_BATCH 16
+
+static inline size_t entrySize(HashTable *ht)
 {
-  char *key;
-  void *value;
-  Entry *next;
-};
+  return ht->cache != NULL ? sizeof(CacheEntry) : sizeof(Entry);
+}
+
+static void freeEntry(HashTable *ht, Entry *e)
+{
+  if (e == NULL)
+    return;
+
+  hashKeyFree(ht, &e->key);
+
+  if (ht->arena != NULL)
+    arenaFree(ht->arena, e, entrySize(ht));
+  else
+    free(e);
+}
 
-struct HashTable
+static void freeChain(HashTable *ht, Entry *e)
 {
-  uint32_t size;
-  uint32_t initialSize;
-  uint32_t count;
-  Entry **elements;
-  hashFunction *hash;
-  double loadFactor;
-  bool (*add)(HashTable *ht, const char *key, void *value);
-  bool (*remove)(HashTable *ht, const char *key);
-  void *(*get)(HashTable *ht, const char *key);
-};
+  while (e != NULL)
+  {
+    Entry *next = e->next;
+
+    freeEntry(ht, e);
+
+    e = next;
+  }
+}
 
-uint64_t djb2HashFunction(const char *key)
+static inline bool isRehashing(HashTable *ht)
 {
-  uint64_t hashValue = 5381;
+  return ht->oldElements != NULL;
+}
 
-  int c;
+/* Moves every entry of an old bucket into the current bucket array */
+static void rehashBucket(HashTable *ht, Entry **bucket)
+{
+  Entry *e = *bucket;
 
-  while ((c = *key++))
+  while (e != NULL)
   {
-    hashValue = ((hashValue << 5) + hashValue) + c; /* hash * 33 + c */
+    Entry *next = e->next;
+
+    uint32_t index = e->hash % ht->size;
+
+    e->next = ht->elements[index];
+
+    ht->elements[index] = e;
+
+    e = next;
   }
 
-  key -= 1;
+  *bucket = NULL;
 
-  return hashValue;
+  ht->version++;
 }
 
-void freeEntry(Entry *e)
+static void finishRehash(HashTable *ht)
 {
-  if (e == NULL)
-    return;
+  free(ht->oldElements);
+
+  ht->oldElements = NULL;
+
+  ht->oldSize = 0;
+
+  ht->rehashIndex = 0;
+}
+
+/*
+  Moves at most buckets non empty old buckets, so the cost of a step is
+  bounded by the chain length and not by the size of the table
+*/
+static void rehashStep(HashTable *ht, uint32_t buckets)
+{
+  uint64_t started = HASH_STAT_NOW();
+
+  uint32_t emptyVisits = buckets * REHASH_EMPTY_VISITS;
+
+  while (buckets > 0 && ht->rehashIndex < ht->oldSize)
+  {
+    Entry **bucket = &ht->oldElements[ht->rehashIndex++];
+
+    if (*bucket != NULL)
+    {
+      rehashBucket(ht, bucket);
+
+      buckets--;
+    }
+    else if (--emptyVisits == 0)
+    {
+      break;
+    }
+  }
+
+  if (ht->rehashIndex >= ht->oldSize)
+    finishRehash(ht);
+
+  HASH_STAT_ADD(ht, resizeNs, HASH_STAT_NOW() - started);
+}
+
+/*
+  Short keys are copied into the entry itself, long ones into the arena
+  when the table has one
+*/
+void hashKeySet(HashTable *ht, HashKey *k, const void *key, size_t len)
+{
+  char *bytes = k->data.bytes;
+
+  if (len > HASH_KEY_INLINE)
+  {
+    bytes = ht->arena != NULL ? arenaAlloc(ht->arena, len + 1) : malloc(len + 1);
+
+    k->data.ptr = bytes;
+  }
+
+  memcpy(bytes, key, len);
 
-  free(e->key);
+  bytes[len] = '\0';
 
-  // if (e->value != NULL)
-  //   free(e->value);
+  k->len = (uint32_t)len;
+}
 
-  freeEntry(e->next);
+void hashKeyFree(HashTable *ht, HashKey *k)
+{
+  if (k->len <= HASH_KEY_INLINE)
+    return;
 
-  free(e);
+  if (ht->arena != NULL)
+    arenaFree(ht->arena, k->data.ptr, k->len + 1);
+  else
+    free(k->data.ptr);
 }
 
+/*
+  Swaps in a new bucket array. In incremental mode the old array stays
+  alive and is drained by rehashStep, otherwise it is drained right away.
+*/
 static void hashTableResize(HashTable *ht, uint32_t newSize)
 {
   if (ht == NULL)
     return;
 
-  uint32_t index = 0;
+  while (isRehashing(ht))
+    rehashStep(ht, ht->oldSize);
 
-  Entry **newElements = calloc(newSize, sizeof(Entry));
+  uint64_t started = HASH_STAT_NOW();
 
-  while (index <= ht->size)
-  {
-    Entry *e = ht->elements[index++];
+  ht->oldElements = ht->elements;
 
-    if (e != NULL)
-      newElements[ht->hash(e->key) % newSize] = e;
-  }
+  ht->oldSize = ht->size;
 
-  free(ht->elements);
+  ht->rehashIndex = 0;
+
+  ht->elements = calloc(newSize, sizeof(Entry *));
 
   ht->size = newSize;
 
-  ht->elements = newElements;
+  if (!ht->incremental)
+  {
+    for (uint32_t index = 0; index < ht->oldSize; index++)
+      rehashBucket(ht, &ht->oldElements[index]);
+
+    finishRehash(ht);
+  }
+
+  HASH_STAT_RESIZE(ht, started);
 }
 
-static Entry *hashTableLookup(HashTable *ht, const char *key)
+/* Returns the link that points to the entry for key, or NULL */
+static Entry **chainFindLink(HashTable *ht, Entry **link, const void *key, size_t len, uint64_t hash)
 {
-  Entry *e = ht->elements[ht->hash(key) % ht->size];
+  while (*link != NULL && ((*link)->hash != hash || !hashKeyEquals(&(*link)->key, key, len)))
+  {
+    HASH_STAT_ADD(ht, probes, 1);
 
-  while (e != NULL && strcmp(key, e->key) != 0)
-    e = e->next;
+    link = &(*link)->next;
+  }
 
-  if (e == NULL)
+  if (*link == NULL)
     return NULL;
 
-  return e;
+  HASH_STAT_ADD(ht, probes, 1);
+
+  return link;
 }
 
-/* Public functions */
+static Entry **hashTableLookupLink(HashTable *ht, const void *key, size_t len, uint64_t hash)
+{
+  HASH_STAT_ADD(ht, lookups, 1);
 
-void hashTableDestroy(HashTable *ht)
+  Entry **link = chainFindLink(ht, &ht->elements[hash % ht->size], key, len, hash);
+
+  /* Buckets that were already moved are NULL in the old array */
+  if (link == NULL && isRehashing(ht))
+    link = chainFindLink(ht, &ht->oldElements[hash % ht->oldSize], key, len, hash);
+
+  return link;
+}
+
+static Entry *hashTableLookup(HashTable *ht, const void *key, size_t len, uint64_t hash)
+{
+  Entry **link = hashTableLookupLink(ht, key, len, hash);
+
+  if (link == NULL)
+    return NULL;
+
+  return *link;
+}
+
+static void chainedDestroy(HashTable *ht)
 {
   uint32_t index = 0;
 
-  while (index < ht->size)
-    freeEntry(ht->elements[index++]);
+  /* Every entry and key lives in the arena, no need to walk the chains */
+  if (ht->arena == NULL)
+  {
+    while (index < ht->size)
+      freeChain(ht, ht->elements[index++]);
+
+    for (index = 0; index < ht->oldSize; index++)
+      freeChain(ht, ht->oldElements[index]);
+  }
+
+  arenaDestroy(ht->arena);
+
+  free(ht->elements);
+
+  free(ht->oldElements);
+
+  free(ht->cache);
 
   free(ht);
 }
 
-void hashTablePrint(HashTable *ht)
+/* Entries compared before the key is found, or the whole chain for a miss */
+static uint32_t chainProbes(Entry *e, const void *key, size_t len, uint64_t hash, bool *found)
+{
+  uint32_t probes = 0;
+
+  for (; e != NULL; e = e->next)
+  {
+    probes++;
+
+    if (e->hash == hash && hashKeyEquals(&e->key, key, len))
+    {
+      *found = true;
+
+      break;
+    }
+  }
+
+  return probes;
+}
+
+static uint32_t chainedProbeLength(HashTable *ht, const void *key, size_t len, uint64_t hash)
+{
+  bool found = false;
+
+  uint32_t probes = chainProbes(ht->elements[hash % ht->size], key, len, hash, &found);
+
+  if (!found && isRehashing(ht))
+    probes += chainProbes(ht->oldElements[hash % ht->oldSize], key, len, hash, &found);
+
+  return probes;
+}
+
+static size_t chainMemoryUsage(Entry **buckets, uint32_t size, size_t entryBytes)
+{
+  size_t bytes = 0;
+
+  for (uint32_t i = 0; buckets != NULL && i < size; i++)
+  {
+    bytes += sizeof(Entry *);
+
+    for (Entry *e = buckets[i]; e != NULL; e = e->next)
+      bytes += entryBytes + hashKeyHeapSize(&e->key);
+  }
+
+  return bytes;
+}
+
+static size_t chainedMemoryUsage(HashTable *ht)
+{
+  size_t bytes = sizeof(HashTable) + (ht->cache != NULL ? sizeof(HashTableCache) : 0);
+
+  bytes += chainMemoryUsage(ht->elements, ht->size, entrySize(ht));
+
+  return bytes + chainMemoryUsage(ht->oldElements, ht->oldSize, entrySize(ht));
+}
+
+static void chainStats(HashTable *ht, Entry **buckets, uint32_t from, uint32_t size, HashTableStats *stats)
+{
+  for (uint32_t i = from; i < size; i++)
+  {
+    uint32_t length = 0;
+
+    for (Entry *e = buckets[i]; e != NULL; e = e->next)
+    {
+      length++;
+
+      stats->keyBytes += hashKeyHeapSize(&e->key);
+    }
+
+    stats->entryBytes += length * entrySize(ht);
+
+    hashStatsChain(stats, length);
+  }
+}
+
+/* Old buckets below rehashIndex were moved already, they are not chains */
+static void chainedStats(HashTable *ht, HashTableStats *stats)
+{
+  stats->tableBytes = sizeof(HashTable) + (ht->cache != NULL ? sizeof(HashTableCache) : 0);
+
+  stats->tableBytes += ((size_t)ht->size + ht->oldSize) * sizeof(Entry *);
+
+  chainStats(ht, ht->elements, 0, ht->size, stats);
+
+  if (isRehashing(ht))
+    chainStats(ht, ht->oldElements, ht->rehashIndex, ht->oldSize, stats);
+}
+
+static void chainVisit(Entry *e, hashTableVisit *visit, void *ctx)
+{
+  for (; e != NULL; e = e->next)
+    visit(ctx, hashKeyBytes(&e->key), e->key.len, e->value);
+}
+
+/*
+  Sizes are always initialSize times a power of two and entries sit in
+  bucket hash % size. So bucket = b + initialSize * j, where b never
+  changes on a resize and j behaves like the index of a power of two
+  table. The cursor holds b in its upper and a reverse binary cursor over
+  j in its lower half. While rehashing, the smaller array is visited
+  together with every bucket of the larger one that it splits into.
+*/
+static uint64_t chainedScan(HashTable *ht, uint64_t cursor, hashTableVisit *visit, void *ctx)
+{
+  uint64_t base = ht->initialSize;
+
+  uint64_t b = cursor >> 32;
+
+  uint64_t j = cursor & UINT32_MAX;
+
+  if (b >= base)
+    return 0;
+
+  Entry **small = ht->elements;
+
+  uint64_t smallSize = ht->size;
+
+  Entry **large = NULL;
+
+  uint64_t largeSize = 0;
+
+  if (isRehashing(ht))
+  {
+    large = ht->oldElements;
+
+    largeSize = ht->oldSize;
+
+    if (largeSize < smallSize)
+    {
+      large = ht->elements;
+
+      largeSize = ht->size;
+
+      small = ht->oldElements;
+
+      smallSize = ht->oldSize;
+    }
+  }
+
+  uint64_t m0 = smallSize / base - 1;
+
+  chainVisit(small[b + base * (j & m0)], visit, ctx);
+
+  if (large == NULL)
+  {
+    j = scanCursorNext(j, m0);
+  }
+  else
+  {
+    uint64_t m1 = largeSize / base - 1;
+
+    do
+    {
+      chainVisit(large[b + base * (j & m1)], visit, ctx);
+
+      j = scanCursorNext(j, m1);
+    } while (j & (m0 ^ m1));
+  }
+
+  if (j == 0 && ++b == base)
+    return 0;
+
+  return b << 32 | j;
+}
+
+static void chainForEach(Entry **buckets, uint32_t size, hashTableVisit *visit, void *ctx)
+{
+  for (uint32_t i = 0; buckets != NULL && i < size; i++)
+  {
+    for (Entry *e = buckets[i]; e != NULL; e = e->next)
+      visit(ctx, hashKeyBytes(&e->key), e->key.len, e->value);
+  }
+}
+
+static void chainedForEach(HashTable *ht, hashTableVisit *visit, void *ctx)
+{
+  chainForEach(ht->elements, ht->size, visit, ctx);
+
+  chainForEach(ht->oldElements, ht->oldSize, visit, ctx);
+}
+
+static void chainedPrint(HashTable *ht)
 {
   uint32_t index = 0;
 
@@ -116,7 +442,12 @@ void hashTablePrint(HashTable *ht)
 
   printf("count -> %d\n", ht->count);
 
-  printf("size -> %d\n\n", ht->size);
+  printf("size -> %d\n", ht->size);
+
+  if (isRehashing(ht))
+    printf("rehashing -> %u of %u old buckets moved\n", ht->rehashIndex, ht->oldSize);
+
+  printf("\n");
 
   printf("------ Entries ------\n");
 
@@ -130,13 +461,13 @@ void hashTablePrint(HashTable *ht)
     }
     else
     {
-      printf("key -> %s, index -> %u\n", e->key, index);
+      printf("key -> %s, index -> %u\n", hashKeyBytes(&e->key), index);
 
       Entry *next = e->next;
 
       while (next != NULL)
       {
-        printf("-- key -> %s, index -> %u\n", next->key, index);
+        printf("-- key -> %s, index -> %u\n", hashKeyBytes(&next->key), index);
 
         next = next->next;
       }
@@ -151,9 +482,39 @@ void hashTablePrint(HashTable *ht)
   printf("-------------\n\n");
 }
 
-void *hashTableGet(HashTable *ht, const char *key)
+/*
+  Stage 0 pulls in the bucket, stage 1 reads it and pulls in the first
+  entry of its chain
+*/
+static void chainedPrefetch(HashTable *ht, uint64_t hash, uint32_t stage)
+{
+  Entry **bucket = &ht->elements[hash % ht->size];
+
+  if (stage == 0)
+  {
+    __builtin_prefetch(bucket);
+
+    return;
+  }
+
+  if (*bucket != NULL)
+    __builtin_prefetch(*bucket);
+}
+
+static void *chainedGet(HashTable *ht, const void *key, size_t len, uint64_t hash)
 {
-  Entry *e = hashTableLookup(ht, key);
+  if (isRehashing(ht))
+    rehashStep(ht, REHASH_STEP);
+
+  Entry *e = hashTableLookup(ht, key, len, hash);
+
+  if (ht->cache != NULL)
+  {
+    if (e == NULL)
+      cacheMiss(ht);
+    else if (!cacheHit(ht, e))
+      return NULL;
+  }
 
   if (e == NULL)
     return NULL;
@@ -161,24 +522,34 @@ void *hashTableGet(HashTable *ht, const char *key)
   return e->value;
 }
 
-bool hashTableAdd(HashTable *ht, const char *key, void *value)
+/* Looks key up, an expired entry in cache mode is removed and not returned */
+static Entry *chainedFind(HashTable *ht, const void *key, size_t len, uint64_t hash)
 {
-  if (key == NULL || ht == NULL)
-    return false;
+  if (isRehashing(ht))
+    rehashStep(ht, REHASH_STEP);
 
-  if (hashTableLookup(ht, key) != NULL)
-    return false;
+  Entry *e = hashTableLookup(ht, key, len, hash);
+
+  if (e != NULL && ht->cache != NULL && cacheExpire(ht, e))
+    return NULL;
 
-  Entry *e = malloc(sizeof(Entry));
+  return e;
+}
 
-  if (ht->size * ht->loadFactor < ht->count + 1)
+/* Adds an entry for key, which must not be in the table yet */
+static Entry *chainedInsert(HashTable *ht, const void *key, size_t len, uint64_t hash, void *value)
+{
+  /* A running incremental resize finishes long before the next is due */
+  if (!isRehashing(ht) && ht->size * ht->loadFactor < ht->count + 1)
     hashTableResize(ht, ht->size * 2);
 
-  e->key = malloc(strlen(key) + 1);
+  Entry *e = ht->arena != NULL ? arenaAlloc(ht->arena, entrySize(ht)) : malloc(entrySize(ht));
 
-  e->key = strdup(key);
+  hashKeySet(ht, &e->key, key, len);
 
-  uint32_t index = ht->hash(key) % ht->size;
+  e->hash = hash;
+
+  uint32_t index = hash % ht->size;
 
   e->value = value;
 
@@ -188,117 +559,602 @@ bool hashTableAdd(HashTable *ht, const char *key, void *value)
 
   ht->count++;
 
+  ht->version++;
+
+  if (ht->cache != NULL)
+  {
+    cacheLink(ht, e);
+
+    cacheEnforce(ht, e);
+  }
+
+  return e;
+}
+
+static bool chainedAdd(HashTable *ht, const void *key, size_t len, uint64_t hash, void *value)
+{
+  if (chainedFind(ht, key, len, hash) != NULL)
+    return false;
+
+  chainedInsert(ht, key, len, hash, hashValueCopy(ht, value));
+
   return true;
 }
 
+static void **chainedGetOrInsert(HashTable *ht, const void *key, size_t len, uint64_t hash, bool *inserted)
+{
+  Entry *e = chainedFind(ht, key, len, hash);
+
+  /* The clock can pass the TTL after chainedFind, then cacheHit removes e */
+  if (e != NULL && ht->cache != NULL && !cacheHit(ht, e))
+    e = NULL;
+
+  *inserted = e == NULL;
+
+  if (e == NULL)
+    e = chainedInsert(ht, key, len, hash, NULL);
+
+  return &e->value;
+}
+
+static bool chainedRemove(HashTable *ht, const void *key, size_t len, uint64_t hash)
+{
+  if (isRehashing(ht))
+    rehashStep(ht, REHASH_STEP);
+
+  Entry **link = hashTableLookupLink(ht, key, len, hash);
+
+  if (link == NULL)
+    return false;
+
+  Entry *e = *link;
+
+  *link = e->next;
+
+  if (ht->cache != NULL)
+    cacheUnlink(ht, e);
+
+  hashValueFree(ht, e->value);
+
+  freeEntry(ht, e);
+
+  ht->count--;
+
+  ht->version++;
+
+  /*
+    Only shrink when at a quarter of the maximum load and the new size is
+    not below the initial size, so alternating adds and removes around a
+    resize boundary do not bounce between two sizes
+  */
+  if (!isRehashing(ht) && ht->count < ht->size * ht->loadFactor / 4 && (ht->size / 2) >= ht->initialSize)
+    hashTableResize(ht, ht->size / 2);
+
+  return true;
+}
+
+static HashTable *chainedTableCreate(uint32_t size, const HashTableOptions *options)
+{
+  HashTable *ht = malloc(sizeof(HashTable));
+
+  hashTableInit(ht, options);
+
+  ht->type = HashTableChained;
+
+  ht->elements = calloc(size, sizeof(Entry *));
+
+  ht->incremental = options->incrementalResize;
+
+  ht->cache = cacheCreate(options);
+
+  ht->get = chainedGet;
+
+  ht->add = chainedAdd;
+
+  ht->getOrInsert = chainedGetOrInsert;
+
+  ht->prefetch = chainedPrefetch;
+
+  ht->remove = chainedRemove;
+
+  ht->probeLength = chainedProbeLength;
+
+  ht->memoryUsage = chainedMemoryUsage;
+
+  ht->scan = chainedScan;
+
+  ht->stats = chainedStats;
+
+  ht->forEach = chainedForEach;
+
+  ht->destroy = chainedDestroy;
+
+  ht->print = chainedPrint;
+
+  ht->size = size;
+
+  ht->initialSize = size;
+
+  ht->loadFactor = 0.75;
+
+  return ht;
+}
+
+/*
+  Without a byte hash function the string hook is used, binary keys are
+  then hashed up to their first NUL which only costs extra collisions
+*/
+static uint64_t hashBytes(HashTable *ht, const void *key, size_t len)
+{
+  if (ht->hashN != NULL)
+    return ht->hashN(key, len);
+
+  char small[64];
+
+  char *copy = len < sizeof(small) ? small : malloc(len + 1);
+
+  memcpy(copy, key, len);
+
+  copy[len] = '\0';
+
+  uint64_t hash = ht->hash(copy);
+
+  if (copy != small)
+    free(copy);
+
+  return hash;
+}
+
+static inline uint64_t hashString(HashTable *ht, const char *key, size_t len)
+{
+  if (ht->hashN != NULL)
+    return ht->hashN(key, len);
+
+  return ht->hash(key);
+}
+
+/* The hash the public functions use for key, for modules built on top */
+uint64_t hashTableHashN(HashTable *ht, const void *key, size_t len)
+{
+  return hashBytes(ht, key, len);
+}
+
+uint64_t hashTableHashString(HashTable *ht, const char *key, size_t len)
+{
+  return hashString(ht, key, len);
+}
+
+void hashStatsChain(HashTableStats *stats, uint32_t length)
+{
+  stats->chains[length < HASH_TABLE_STATS_CHAINS ? length : HASH_TABLE_STATS_CHAINS - 1]++;
+
+  if (length > stats->longestChain)
+    stats->longestChain = length;
+}
+
+/* Fields every backend starts from */
+void hashTableInit(HashTable *ht, const HashTableOptions *options)
+{
+  memset(ht, 0, sizeof(HashTable));
+
+  ht->hash = options->hash;
+
+  ht->hashN = options->hashN;
+
+  if (ht->hash == NULL && ht->hashN == NULL)
+    ht->hashN = wyhash;
+
+  ht->arena = options->arena ? arenaCreate() : NULL;
+
+  ht->freeValue = options->freeValue;
+
+  ht->copyValue = options->copyValue;
+}
+
+/* Public functions */
+
+static void freeValueVisit(void *ctx, const char *key, size_t len, void *value)
+{
+  hashValueFree(ctx, value);
+}
+
+void hashTableDestroy(HashTable *ht)
+{
+  if (ht == NULL)
+    return;
+
+  /* Values are released here once, the layouts only release what they own */
+  if (ht->freeValue != NULL)
+    ht->forEach(ht, freeValueVisit, ht);
+
+  ht->destroy(ht);
+}
+
+void hashTablePrint(HashTable *ht)
+{
+  ht->print(ht);
+}
+
+void *hashTableGet(HashTable *ht, const char *key)
+{
+  if (ht == NULL || key == NULL)
+    return NULL;
+
+  size_t len = strlen(key);
+
+  return ht->get(ht, key, len, hashString(ht, key, len));
+}
+
+bool hashTableAdd(HashTable *ht, const char *key, void *value)
+{
+  if (ht == NULL || key == NULL)
+    return false;
+
+  size_t len = strlen(key);
+
+  return ht->add(ht, key, len, hashString(ht, key, len), value);
+}
+
 bool hashTableRemove(HashTable *ht, const char *key)
 {
   if (ht == NULL || key == NULL)
     return false;
 
-  if (hashTableLookup(ht, key) == NULL)
+  size_t len = strlen(key);
+
+  return ht->remove(ht, key, len, hashString(ht, key, len));
+}
+
+void *hashTableGetN(HashTable *ht, const void *key, size_t len)
+{
+  if (ht == NULL || key == NULL || len > UINT32_MAX)
+    return NULL;
+
+  return ht->get(ht, key, len, hashBytes(ht, key, len));
+}
+
+bool hashTableAddN(HashTable *ht, const void *key, size_t len, void *value)
+{
+  if (ht == NULL || key == NULL || len > UINT32_MAX)
     return false;
 
-  /* Only shrink when beneath current min and new size bigger then initial size */
-  if ((ht->size / 2 * ht->loadFactor > ht->count - 1) && (ht->size / 2) >= ht->initialSize)
-    hashTableResize(ht, ht->size / 2);
+  return ht->add(ht, key, len, hashBytes(ht, key, len), value);
+}
+
+bool hashTableRemoveN(HashTable *ht, const void *key, size_t len)
+{
+  if (ht == NULL || key == NULL || len > UINT32_MAX)
+    return false;
+
+  return ht->remove(ht, key, len, hashBytes(ht, key, len));
+}
+
+static void **getOrInsertSlot(HashTable *ht, const void *key, size_t len, uint64_t hash, void *value, bool *inserted)
+{
+  if (ht->getOrInsert == NULL)
+    return NULL;
+
+  bool added;
+
+  void **slot = ht->getOrInsert(ht, key, len, hash, &added);
+
+  if (added)
+    *slot = hashValueCopy(ht, value);
+
+  if (inserted != NULL)
+    *inserted = added;
+
+  return slot;
+}
+
+static void **upsertSlot(HashTable *ht, const void *key, size_t len, uint64_t hash, void *value)
+{
+  if (ht->getOrInsert == NULL)
+    return NULL;
+
+  bool added;
+
+  void **slot = ht->getOrInsert(ht, key, len, hash, &added);
+
+  void *copy = hashValueCopy(ht, value);
+
+  /* Storing the value a slot already holds must not free it */
+  if (!added && *slot != copy)
+    hashValueFree(ht, *slot);
+
+  *slot = copy;
+
+  return slot;
+}
+
+/*
+  Returns the value slot of key in one lookup. A missing key is added with
+  value, an existing one keeps its value and value is ignored. The slot can
+  be read and written until the table is changed, the table owns whatever
+  it holds. NULL for a read-only table
+*/
+void **hashTableGetOrInsert(HashTable *ht, const char *key, void *value, bool *inserted)
+{
+  if (ht == NULL || key == NULL)
+    return NULL;
+
+  size_t len = strlen(key);
+
+  return getOrInsertSlot(ht, key, len, hashString(ht, key, len), value, inserted);
+}
+
+void **hashTableGetOrInsertN(HashTable *ht, const void *key, size_t len, void *value, bool *inserted)
+{
+  if (ht == NULL || key == NULL || len > UINT32_MAX)
+    return NULL;
+
+  return getOrInsertSlot(ht, key, len, hashBytes(ht, key, len), value, inserted);
+}
+
+/*
+  Sets key to value in one lookup whether or not it was there, the value
+  it replaces is freed. Returns the value slot like hashTableGetOrInsert
+*/
+void **hashTableUpsert(HashTable *ht, const char *key, void *value)
+{
+  if (ht == NULL || key == NULL)
+    return NULL;
+
+  size_t len = strlen(key);
+
+  return upsertSlot(ht, key, len, hashString(ht, key, len), value);
+}
 
-  uint32_t index = ht->hash(key) % ht->size;
+void **hashTableUpsertN(HashTable *ht, const void *key, size_t len, void *value)
+{
+  if (ht == NULL || key == NULL || len > UINT32_MAX)
+    return NULL;
+
+  return upsertSlot(ht, key, len, hashBytes(ht, key, len), value);
+}
+
+/*
+  Hashes a whole batch before touching the table, then prefetches every
+  bucket in two rounds so the cache misses of the batch overlap instead of
+  stalling one lookup at a time
+*/
+static void prefetchBatch(HashTable *ht, const char *const *keys, size_t count, size_t *lens, uint64_t *hashes)
+{
+  for (size_t i = 0; i < count; i++)
+  {
+    lens[i] = strlen(keys[i]);
+
+    hashes[i] = hashString(ht, keys[i], lens[i]);
+
+    ht->prefetch(ht, hashes[i], 0);
+  }
+
+  for (size_t i = 0; i < count; i++)
+    ht->prefetch(ht, hashes[i], 1);
+}
+
+/* values[i] is set to the value of keys[i], or NULL when it is missing */
+void hashTableGetMany(HashTable *ht, const char *const *keys, size_t count, void **values)
+{
+  if (ht == NULL || keys == NULL || values == NULL)
+    return;
 
-  Entry *e = ht->elements[index];
+  size_t lens[HASH_BATCH];
 
-  Entry *pe = NULL;
+  uint64_t hashes[HASH_BATCH];
 
-  while (e != NULL && strcmp(key, e->key) != 0)
+  for (size_t start = 0; start < count; start += HASH_BATCH)
   {
-    pe = e;
+    size_t n = count - start < HASH_BATCH ? count - start : HASH_BATCH;
+
+    prefetchBatch(ht, keys + start, n, lens, hashes);
 
-    e = e->next;
+    for (size_t i = 0; i < n; i++)
+      values[start + i] = ht->get(ht, keys[start + i], lens[i], hashes[i]);
   }
+}
 
-  if (e == NULL)
-    return false;
+/* Adds keys[i] with values[i], returns how many keys were not present yet */
+size_t hashTableAddMany(HashTable *ht, const char *const *keys, void *const *values, size_t count)
+{
+  if (ht == NULL || keys == NULL || values == NULL)
+    return 0;
 
-  if (pe != NULL)
-    pe->next = e->next;
+  size_t lens[HASH_BATCH];
 
-  if (ht->elements[index] == pe)
-    ht->elements[index] = pe;
-  else
-    ht->elements[index] = NULL;
+  uint64_t hashes[HASH_BATCH];
 
-  freeEntry(e);
+  size_t added = 0;
 
-  ht->count--;
+  for (size_t start = 0; start < count; start += HASH_BATCH)
+  {
+    size_t n = count - start < HASH_BATCH ? count - start : HASH_BATCH;
 
-  return true;
+    prefetchBatch(ht, keys + start, n, lens, hashes);
+
+    /* A resize halfway through only makes the remaining prefetches useless */
+    for (size_t i = 0; i < n; i++)
+      added += ht->add(ht, keys[start + i], lens[i], hashes[i], values[start + i]);
+  }
+
+  return added;
 }
+
 /*
-  Creates a new HastTable
+  Visits the entries of one cursor position, start with cursor 0 and pass
+  the returned cursor back in until it is 0 again
 */
-HashTable *hashTableCreate(uint32_t size, hashFunction *hf)
+uint64_t hashTableScan(HashTable *ht, uint64_t cursor, hashTableVisit *visit, void *ctx)
 {
-  HashTable *ht = malloc(sizeof(HashTable));
+  if (ht == NULL || visit == NULL)
+    return 0;
 
-  ht->elements = calloc(size, sizeof(Entry));
+  return ht->scan(ht, cursor, visit, ctx);
+}
 
-  ht->hash = hf == NULL ? djb2HashFunction : hf;
+typedef struct IterPick
+{
+  uint32_t skip;
+  bool found;
+  const char *key;
+  size_t len;
+  void *value;
+} IterPick;
 
-  ht->get = hashTableGet;
+static void iterPick(void *ctx, const char *key, size_t len, void *value)
+{
+  IterPick *pick = ctx;
 
-  ht->add = hashTableAdd;
+  if (pick->found || pick->skip-- > 0)
+    return;
 
-  ht->remove = hashTableRemove;
+  pick->found = true;
 
-  ht->size = size;
+  pick->key = key;
 
-  ht->initialSize = size;
+  pick->len = len;
 
-  ht->count = 0;
+  pick->value = value;
+}
 
-  ht->loadFactor = 0.75;
+/*
+  Returns the entries one at a time without allocating. The iterator only
+  keeps a cursor and how many entries of the current position it returned.
+  If the table changed since the last call that position is started over,
+  which can return some of its entries again but never skips one. key
+  stays valid until the table is changed
+*/
+bool hashTableIterNext(HashTable *ht, HashTableIter *it, const char **key, size_t *len, void **value)
+{
+  if (ht == NULL || it == NULL || it->done)
+    return false;
 
-  return ht;
+  if (it->offset > 0 && it->version != ht->version)
+    it->offset = 0;
+
+  while (true)
+  {
+    IterPick pick = {.skip = it->offset};
+
+    uint64_t next = ht->scan(ht, it->cursor, iterPick, &pick);
+
+    if (pick.found)
+    {
+      it->offset++;
+
+      it->version = ht->version;
+
+      if (key != NULL)
+        *key = pick.key;
+
+      if (len != NULL)
+        *len = pick.len;
+
+      if (value != NULL)
+        *value = pick.value;
+
+      return true;
+    }
+
+    it->offset = 0;
+
+    if (next == 0)
+    {
+      it->done = true;
+
+      return false;
+    }
+
+    it->cursor = next;
+  }
 }
 
-int main()
+/* How far a lookup of key has to go, in the units of the table's layout */
+uint32_t hashTableProbeLength(HashTable *ht, const char *key)
 {
-  HashTable *ht = hashTableCreate(5, NULL);
+  if (ht == NULL || key == NULL)
+    return 0;
 
-  ht->add(ht, "John", (int *)25);
+  size_t len = strlen(key);
+
+  return ht->probeLength(ht, key, len, hashString(ht, key, len));
+}
 
-  ht->add(ht, "Mary", (void *)30);
+size_t hashTableMemoryUsage(HashTable *ht)
+{
+  if (ht == NULL)
+    return 0;
 
-  ht->add(ht, "Eva", (void *)31);
+  return ht->memoryUsage(ht);
+}
 
-  ht->add(ht, "Mike", "mike");
-  ht->add(ht, "Jaap", NULL);
-  ht->add(ht, "Kees", NULL);
-  ht->add(ht, "Sofie", NULL);
+/*
+  Fills stats with the shape of the table and the counters gathered so far.
+  Walks the whole table, it is meant for diagnostics and not for hot paths
+*/
+bool hashTableStats(HashTable *ht, HashTableStats *stats)
+{
+  if (ht == NULL || stats == NULL)
+    return false;
 
-  hashTablePrint(ht);
+  memset(stats, 0, sizeof(HashTableStats));
 
-  ht->remove(ht, "John");
+  stats->type = ht->type;
 
-  hashTablePrint(ht);
+  stats->count = ht->count;
 
-  ht->remove(ht, "Kees");
+  stats->size = ht->size;
 
-  hashTablePrint(ht);
+  stats->load = ht->size == 0 ? 0 : (double)ht->count / ht->size;
 
-  ht->remove(ht, "Mike");
+  ht->stats(ht, stats);
 
-  hashTablePrint(ht);
+  stats->lookups = ht->counters.lookups;
 
-  ht->remove(ht, "Eva");
+  stats->probes = ht->counters.probes;
 
-  hashTablePrint(ht);
+  stats->resizes = ht->counters.resizes;
 
-  ht->remove(ht, "Mary");
+  stats->resizeNs = ht->counters.resizeNs;
 
-  hashTablePrint(ht);
+  return true;
+}
 
-  hashTableDestroy(ht);
+uint32_t hashTableCount(HashTable *ht)
+{
+  return ht->count;
+}
 
-  return 0;
-}
\ No newline at end of file
+/*
+  Creates a new HastTable
+*/
+HashTable *hashTableCreate(uint32_t size, hashFunction *hf)
+{
+  HashTableOptions options = {.type = HashTableChained, .hash = hf};
+
+  return hashTableCreateWithOptions(size, &options);
+}
+
+/*
+  Creates a new HashTable with the layout picked in options
+*/
+HashTable *hashTableCreateWithOptions(uint32_t size, const HashTableOptions *options)
+{
+  HashTableOptions defaults = {0};
+
+  if (options == NULL)
+    options = &defaults;
+
+  switch (options->type)
+  {
+  case HashTableSwiss:
+    return swissTableCreate(size, options);
+  case HashTableRobinHood:
+    return robinHoodTableCreate(size, options);
+  case HashTableCuckoo:
+    return cuckooTableCreate(size, options);
+  case HashTableChained:
+  default:
+    return chainedTableCreate(size, options);
+  }
+}
@@ -0,0 +1,45 @@
+#include <stddef.h>
+
+#include "hash-table.h"
+
+int main()
+{
+  HashTable *ht = hashTableCreate(5, NULL);
+
+  hashTableAdd(ht, "John", (int *)25);
+
+  hashTableAdd(ht, "Mary", (void *)30);
+
+  hashTableAdd(ht, "Eva", (void *)31);
+
+  hashTableAdd(ht, "Mike", "mike");
+  hashTableAdd(ht, "Jaap", NULL);
+  hashTableAdd(ht, "Kees", NULL);
+  hashTableAdd(ht, "Sofie", NULL);
+
+  hashTablePrint(ht);
+
+  hashTableRemove(ht, "John");
+
+  hashTablePrint(ht);
+
+  hashTableRemove(ht, "Kees");
+
+  hashTablePrint(ht);
+
+  hashTableRemove(ht, "Mike");
+
+  hashTablePrint(ht);
+
+  hashTableRemove(ht, "Eva");
+
+  hashTablePrint(ht);
+
+  hashTableRemove(ht, "Mary");
+
+  hashTablePrint(ht);
+
+  hashTableDestroy(ht);
+
+  return 0;
+}
\ No newline at end of file
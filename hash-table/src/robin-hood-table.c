@@ -0,0 +1,492 @@
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stdio.h>
+
+#include "hash-table-internal.h"
+
+/*
+  Linear probing with Robin Hood placement. Every slot remembers how far it
+  sits from its home slot, an insert takes the place of any entry that is
+  closer to home than itself. That keeps probe lengths close to the mean,
+  and a lookup can stop as soon as it meets an entry closer to home than
+  the one it looks for. Removal shifts the entries that follow back by one
+  so no tombstones are needed.
+*/
+
+/* Private */
+
+/* Grows above 9/10 of the capacity */
+#define MAX_LOAD_NUM 9
+#define MAX_LOAD_DEN 10
+
+/* Distances are cached in a byte, longer ones are worked out from the hash */
+#define DIST_SATURATED 255
+
+typedef struct RobinHoodSlot
+{
+  uint64_t hash;
+  void *value;
+  HashKey key;
+} RobinHoodSlot;
+
+typedef struct RobinHoodTable
+{
+  HashTable base;
+  /* Distance from the home slot plus one, 0 marks an empty slot */
+  uint8_t *dist;
+  RobinHoodSlot *slots;
+  uint32_t mask;
+} RobinHoodTable;
+
+/* djb2 and friends leave the high bits weak, spread them before masking */
+static inline uint64_t robinHoodHash(uint64_t hash)
+{
+  hash *= 0x9E3779B97F4A7C15ULL;
+
+  return hash ^ (hash >> 32);
+}
+
+static inline uint32_t homeOf(RobinHoodTable *rt, uint64_t hash)
+{
+  return (uint32_t)hash & rt->mask;
+}
+
+static inline uint32_t distanceOf(RobinHoodTable *rt, uint32_t index)
+{
+  uint32_t dist = rt->dist[index];
+
+  if (dist < DIST_SATURATED)
+    return dist;
+
+  return ((index - homeOf(rt, rt->slots[index].hash)) & rt->mask) + 1;
+}
+
+static inline void setDistance(RobinHoodTable *rt, uint32_t index, uint32_t dist)
+{
+  rt->dist[index] = (uint8_t)(dist < DIST_SATURATED ? dist : DIST_SATURATED);
+}
+
+static inline uint32_t maxCount(uint32_t capacity)
+{
+  return (uint32_t)((uint64_t)capacity * MAX_LOAD_NUM / MAX_LOAD_DEN);
+}
+
+static int64_t robinHoodFind(RobinHoodTable *rt, const void *key, size_t len, uint64_t hash, uint32_t *probes)
+{
+  uint32_t index = homeOf(rt, hash);
+
+  uint32_t dist = 1;
+
+  uint32_t resident;
+
+  /* An entry closer to home than dist would have been displaced by the key */
+  while ((resident = distanceOf(rt, index)) >= dist)
+  {
+    if (resident == dist && rt->slots[index].hash == hash && hashKeyEquals(&rt->slots[index].key, key, len))
+    {
+      *probes = dist;
+
+      return index;
+    }
+
+    index = (index + 1) & rt->mask;
+
+    dist++;
+  }
+
+  *probes = dist;
+
+  return -1;
+}
+
+/* robinHoodFind for the operations, counted in the stats */
+static inline int64_t robinHoodLookup(RobinHoodTable *rt, const void *key, size_t len, uint64_t hash)
+{
+  uint32_t probes;
+
+  int64_t index = robinHoodFind(rt, key, len, hash, &probes);
+
+  HASH_STAT_ADD(&rt->base, lookups, 1);
+
+  HASH_STAT_ADD(&rt->base, probes, probes);
+
+  return index;
+}
+
+/*
+  Places slot, which must not be in the table yet and must fit. Returns
+  where slot itself ended up, the entries it displaced move further on
+*/
+static uint32_t robinHoodPlace(RobinHoodTable *rt, RobinHoodSlot slot)
+{
+  uint32_t index = homeOf(rt, slot.hash);
+
+  uint32_t dist = 1;
+
+  uint32_t placed = UINT32_MAX;
+
+  while (rt->dist[index] != 0)
+  {
+    uint32_t resident = distanceOf(rt, index);
+
+    /* The resident is richer (closer to home), it makes room */
+    if (resident < dist)
+    {
+      RobinHoodSlot tmp = rt->slots[index];
+
+      rt->slots[index] = slot;
+
+      setDistance(rt, index, dist);
+
+      if (placed == UINT32_MAX)
+        placed = index;
+
+      slot = tmp;
+
+      dist = resident;
+    }
+
+    index = (index + 1) & rt->mask;
+
+    dist++;
+  }
+
+  rt->slots[index] = slot;
+
+  setDistance(rt, index, dist);
+
+  return placed == UINT32_MAX ? index : placed;
+}
+
+static void robinHoodAllocate(RobinHoodTable *rt, uint32_t capacity)
+{
+  rt->dist = calloc(capacity, 1);
+
+  rt->slots = malloc(sizeof(RobinHoodSlot) * capacity);
+
+  rt->mask = capacity - 1;
+
+  rt->base.size = capacity;
+}
+
+static void robinHoodResize(RobinHoodTable *rt, uint32_t newCapacity)
+{
+  uint64_t started = HASH_STAT_NOW();
+
+  uint8_t *oldDist = rt->dist;
+
+  RobinHoodSlot *oldSlots = rt->slots;
+
+  uint32_t oldCapacity = rt->mask + 1;
+
+  robinHoodAllocate(rt, newCapacity);
+
+  for (uint32_t i = 0; i < oldCapacity; i++)
+  {
+    if (oldDist[i] != 0)
+      robinHoodPlace(rt, oldSlots[i]);
+  }
+
+  free(oldDist);
+
+  free(oldSlots);
+
+  HASH_STAT_RESIZE(&rt->base, started);
+}
+
+static void *robinHoodGet(HashTable *ht, const void *key, size_t len, uint64_t hash)
+{
+  RobinHoodTable *rt = (RobinHoodTable *)ht;
+
+  int64_t index = robinHoodLookup(rt, key, len, robinHoodHash(hash));
+
+  if (index < 0)
+    return NULL;
+
+  return rt->slots[index].value;
+}
+
+/* Adds key, which must not be in the table yet, and returns its slot */
+static uint32_t robinHoodInsert(RobinHoodTable *rt, const void *key, size_t len, uint64_t hash, void *value)
+{
+  if (rt->base.count + 1 > maxCount(rt->mask + 1))
+    robinHoodResize(rt, (rt->mask + 1) * 2);
+
+  RobinHoodSlot slot = {.hash = hash, .value = value};
+
+  hashKeySet(&rt->base, &slot.key, key, len);
+
+  uint32_t index = robinHoodPlace(rt, slot);
+
+  rt->base.count++;
+
+  rt->base.version++;
+
+  return index;
+}
+
+static bool robinHoodAdd(HashTable *ht, const void *key, size_t len, uint64_t hash, void *value)
+{
+  RobinHoodTable *rt = (RobinHoodTable *)ht;
+
+  hash = robinHoodHash(hash);
+
+  if (robinHoodLookup(rt, key, len, hash) >= 0)
+    return false;
+
+  robinHoodInsert(rt, key, len, hash, hashValueCopy(ht, value));
+
+  return true;
+}
+
+static void **robinHoodGetOrInsert(HashTable *ht, const void *key, size_t len, uint64_t hash, bool *inserted)
+{
+  RobinHoodTable *rt = (RobinHoodTable *)ht;
+
+  hash = robinHoodHash(hash);
+
+  int64_t index = robinHoodLookup(rt, key, len, hash);
+
+  *inserted = index < 0;
+
+  if (index < 0)
+    index = robinHoodInsert(rt, key, len, hash, NULL);
+
+  return &rt->slots[index].value;
+}
+
+/* Backward shift: pull every following entry that is away from home one slot back */
+static bool robinHoodRemove(HashTable *ht, const void *key, size_t len, uint64_t hash)
+{
+  RobinHoodTable *rt = (RobinHoodTable *)ht;
+
+  int64_t found = robinHoodLookup(rt, key, len, robinHoodHash(hash));
+
+  if (found < 0)
+    return false;
+
+  uint32_t index = (uint32_t)found;
+
+  hashKeyFree(ht, &rt->slots[index].key);
+
+  hashValueFree(ht, rt->slots[index].value);
+
+  uint32_t next = (index + 1) & rt->mask;
+
+  uint32_t dist;
+
+  while ((dist = distanceOf(rt, next)) > 1)
+  {
+    rt->slots[index] = rt->slots[next];
+
+    setDistance(rt, index, dist - 1);
+
+    index = next;
+
+    next = (next + 1) & rt->mask;
+  }
+
+  rt->dist[index] = 0;
+
+  ht->count--;
+
+  ht->version++;
+
+  return true;
+}
+
+static void robinHoodPrefetch(HashTable *ht, uint64_t hash, uint32_t stage)
+{
+  RobinHoodTable *rt = (RobinHoodTable *)ht;
+
+  uint32_t index = homeOf(rt, robinHoodHash(hash));
+
+  if (stage == 0)
+    __builtin_prefetch(&rt->dist[index]);
+  else
+    __builtin_prefetch(&rt->slots[index]);
+}
+
+static uint32_t robinHoodProbeLength(HashTable *ht, const void *key, size_t len, uint64_t hash)
+{
+  uint32_t probes;
+
+  robinHoodFind((RobinHoodTable *)ht, key, len, robinHoodHash(hash), &probes);
+
+  return probes;
+}
+
+static size_t robinHoodMemoryUsage(HashTable *ht)
+{
+  RobinHoodTable *rt = (RobinHoodTable *)ht;
+
+  uint32_t capacity = rt->mask + 1;
+
+  size_t bytes = sizeof(RobinHoodTable) + (size_t)capacity * (sizeof(RobinHoodSlot) + 1);
+
+  for (uint32_t i = 0; i < capacity; i++)
+  {
+    if (rt->dist[i] != 0)
+      bytes += hashKeyHeapSize(&rt->slots[i].key);
+  }
+
+  return bytes;
+}
+
+/* Entries of a home slot follow it in one run, the run is its chain */
+static void robinHoodStats(HashTable *ht, HashTableStats *stats)
+{
+  RobinHoodTable *rt = (RobinHoodTable *)ht;
+
+  uint32_t capacity = rt->mask + 1;
+
+  uint32_t *lengths = calloc(capacity, sizeof(uint32_t));
+
+  stats->tableBytes = sizeof(RobinHoodTable) + (size_t)capacity * (sizeof(RobinHoodSlot) + 1);
+
+  for (uint32_t i = 0; i < capacity; i++)
+  {
+    if (rt->dist[i] == 0)
+      continue;
+
+    lengths[homeOf(rt, rt->slots[i].hash)]++;
+
+    stats->keyBytes += hashKeyHeapSize(&rt->slots[i].key);
+  }
+
+  for (uint32_t i = 0; i < capacity; i++)
+    hashStatsChain(stats, lengths[i]);
+
+  free(lengths);
+}
+
+/* A position is a home slot, its entries follow it in one run */
+static uint64_t robinHoodScan(HashTable *ht, uint64_t cursor, hashTableVisit *visit, void *ctx)
+{
+  RobinHoodTable *rt = (RobinHoodTable *)ht;
+
+  uint32_t index = (uint32_t)(cursor & rt->mask);
+
+  uint32_t dist = 1;
+
+  uint32_t resident;
+
+  while ((resident = distanceOf(rt, index)) >= dist)
+  {
+    RobinHoodSlot *slot = &rt->slots[index];
+
+    if (resident == dist)
+      visit(ctx, hashKeyBytes(&slot->key), slot->key.len, slot->value);
+
+    index = (index + 1) & rt->mask;
+
+    dist++;
+  }
+
+  return scanCursorNext(cursor, rt->mask);
+}
+
+static void robinHoodForEach(HashTable *ht, hashTableVisit *visit, void *ctx)
+{
+  RobinHoodTable *rt = (RobinHoodTable *)ht;
+
+  for (uint32_t i = 0; i <= rt->mask; i++)
+  {
+    if (rt->dist[i] != 0)
+      visit(ctx, hashKeyBytes(&rt->slots[i].key), rt->slots[i].key.len, rt->slots[i].value);
+  }
+}
+
+static void robinHoodDestroy(HashTable *ht)
+{
+  RobinHoodTable *rt = (RobinHoodTable *)ht;
+
+  if (ht->arena == NULL)
+  {
+    for (uint32_t i = 0; i <= rt->mask; i++)
+    {
+      if (rt->dist[i] != 0)
+        hashKeyFree(ht, &rt->slots[i].key);
+    }
+  }
+
+  arenaDestroy(ht->arena);
+
+  free(rt->dist);
+
+  free(rt->slots);
+
+  free(rt);
+}
+
+static void robinHoodPrint(HashTable *ht)
+{
+  RobinHoodTable *rt = (RobinHoodTable *)ht;
+
+  printf("------ Robin Hood Table ------\n");
+
+  printf("count -> %u\n", ht->count);
+
+  printf("size -> %u\n\n", ht->size);
+
+  printf("------ Entries ------\n");
+
+  for (uint32_t i = 0; i <= rt->mask; i++)
+  {
+    if (rt->dist[i] != 0)
+      printf("key -> %s, index -> %u, distance -> %u\n", hashKeyBytes(&rt->slots[i].key), i, distanceOf(rt, i));
+  }
+
+  printf("-------------\n\n");
+}
+
+/* Public functions */
+
+HashTable *robinHoodTableCreate(uint32_t size, const HashTableOptions *options)
+{
+  RobinHoodTable *rt = malloc(sizeof(RobinHoodTable));
+
+  hashTableInit(&rt->base, options);
+
+  uint32_t capacity = 8;
+
+  /* Room for size entries below the maximum load */
+  while (maxCount(capacity) < size)
+    capacity *= 2;
+
+  robinHoodAllocate(rt, capacity);
+
+  rt->base.type = HashTableRobinHood;
+
+  rt->base.initialSize = capacity;
+
+  rt->base.loadFactor = (double)MAX_LOAD_NUM / MAX_LOAD_DEN;
+
+  rt->base.get = robinHoodGet;
+
+  rt->base.add = robinHoodAdd;
+
+  rt->base.getOrInsert = robinHoodGetOrInsert;
+
+  rt->base.prefetch = robinHoodPrefetch;
+
+  rt->base.remove = robinHoodRemove;
+
+  rt->base.probeLength = robinHoodProbeLength;
+
+  rt->base.memoryUsage = robinHoodMemoryUsage;
+
+  rt->base.scan = robinHoodScan;
+
+  rt->base.stats = robinHoodStats;
+
+  rt->base.forEach = robinHoodForEach;
+
+  rt->base.destroy = robinHoodDestroy;
+
+  rt->base.print = robinHoodPrint;
+
+  return (HashTable *)rt;
+}
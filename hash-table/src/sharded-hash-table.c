@@ -0,0 +1,306 @@
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include <pthread.h>
+
+#include "sharded-hash-table.h"
+#include "hash-table-internal.h"
+
+/* Private */
+
+/* Partitions per thread when none are asked for, spreads uneven partitions over the merge threads */
+#define PARTITIONS_PER_THREAD 4
+
+#define PARTITION_INITIAL_SIZE 64
+
+typedef struct Shard
+{
+  /* One table per partition, created by the owning thread on first use */
+  HashTable **parts;
+} Shard;
+
+struct ShardedHashTable
+{
+  uint32_t threads;
+  uint32_t partitions;
+  HashTableOptions options;
+  Shard *shards;
+  /* The merged partitions, NULL until shardedHashTableMerge */
+  HashTable **result;
+};
+
+typedef struct MergeJob
+{
+  ShardedHashTable *sht;
+  shardedHashTableReduce *reduce;
+  void *ctx;
+  atomic_uint next;
+} MergeJob;
+
+typedef struct MergeVisit
+{
+  HashTable *target;
+  shardedHashTableReduce *reduce;
+  void *ctx;
+} MergeVisit;
+
+/* The top bits of the hash pick the range, the tables index with the rest */
+static inline uint32_t partitionOf(ShardedHashTable *sht, uint64_t hash)
+{
+  return (uint32_t)(((hash >> 32) * sht->partitions) >> 32);
+}
+
+/* Allocated from the thread that fills it, which keeps shards of different threads apart */
+static void shardInit(ShardedHashTable *sht, Shard *shard)
+{
+  shard->parts = malloc(sizeof(HashTable *) * sht->partitions);
+
+  for (uint32_t p = 0; p < sht->partitions; p++)
+    shard->parts[p] = hashTableCreateWithOptions(PARTITION_INITIAL_SIZE, &sht->options);
+}
+
+/* Moves value into the target, a key it already has goes through reduce */
+static void mergeVisit(void *ctx, const char *key, size_t len, void *value)
+{
+  MergeVisit *m = ctx;
+
+  HashTable *target = m->target;
+
+  bool added;
+
+  void **slot = target->getOrInsert(target, key, len, hashTableHashN(target, key, len), &added);
+
+  if (added)
+  {
+    *slot = value;
+
+    return;
+  }
+
+  if (m->reduce != NULL)
+    m->reduce(m->ctx, key, len, slot, value);
+
+  hashValueFree(target, value);
+}
+
+/* The largest part of the partition is kept, the others are folded into it */
+static void mergePartition(MergeJob *job, uint32_t p)
+{
+  ShardedHashTable *sht = job->sht;
+
+  HashTable *target = NULL;
+
+  for (uint32_t t = 0; t < sht->threads; t++)
+  {
+    HashTable **parts = sht->shards[t].parts;
+
+    if (parts != NULL && (target == NULL || parts[p]->count > target->count))
+      target = parts[p];
+  }
+
+  if (target == NULL)
+    target = hashTableCreateWithOptions(PARTITION_INITIAL_SIZE, &sht->options);
+
+  MergeVisit m = {.target = target, .reduce = job->reduce, .ctx = job->ctx};
+
+  for (uint32_t t = 0; t < sht->threads; t++)
+  {
+    HashTable **parts = sht->shards[t].parts;
+
+    if (parts == NULL || parts[p] == target)
+      continue;
+
+    parts[p]->forEach(parts[p], mergeVisit, &m);
+
+    /* Every value now lives in the target or was freed by mergeVisit */
+    parts[p]->freeValue = NULL;
+
+    hashTableDestroy(parts[p]);
+  }
+
+  sht->result[p] = target;
+}
+
+static void *mergeWorker(void *arg)
+{
+  MergeJob *job = arg;
+
+  uint32_t p;
+
+  while ((p = atomic_fetch_add(&job->next, 1)) < job->sht->partitions)
+    mergePartition(job, p);
+
+  return NULL;
+}
+
+/* Public functions */
+
+ShardedHashTable *shardedHashTableCreate(uint32_t threads, uint32_t partitions, const HashTableOptions *options)
+{
+  if (threads == 0)
+    return NULL;
+
+  ShardedHashTable *sht = calloc(1, sizeof(ShardedHashTable));
+
+  sht->threads = threads;
+
+  sht->partitions = partitions != 0 ? partitions : threads * PARTITIONS_PER_THREAD;
+
+  if (options != NULL)
+    sht->options = *options;
+
+  sht->shards = calloc(threads, sizeof(Shard));
+
+  return sht;
+}
+
+void **shardedHashTableGetOrInsertN(ShardedHashTable *sht, uint32_t thread, const void *key, size_t len, void *value, bool *inserted)
+{
+  if (sht == NULL || key == NULL || len > UINT32_MAX || thread >= sht->threads || sht->result != NULL)
+    return NULL;
+
+  Shard *shard = &sht->shards[thread];
+
+  if (shard->parts == NULL)
+    shardInit(sht, shard);
+
+  /* Every part hashes the same way, the first one hashes for all */
+  uint64_t hash = hashTableHashN(shard->parts[0], key, len);
+
+  HashTable *ht = shard->parts[partitionOf(sht, hash)];
+
+  bool added;
+
+  void **slot = ht->getOrInsert(ht, key, len, hash, &added);
+
+  if (added)
+    *slot = hashValueCopy(ht, value);
+
+  if (inserted != NULL)
+    *inserted = added;
+
+  return slot;
+}
+
+void **shardedHashTableGetOrInsert(ShardedHashTable *sht, uint32_t thread, const char *key, void *value, bool *inserted)
+{
+  if (key == NULL)
+    return NULL;
+
+  return shardedHashTableGetOrInsertN(sht, thread, key, strlen(key), value, inserted);
+}
+
+/*
+  No shard may be used while this runs. Partitions hold disjoint keys, so
+  the merge threads share nothing but the counter they take partitions from
+*/
+void shardedHashTableMerge(ShardedHashTable *sht, shardedHashTableReduce *reduce, void *ctx)
+{
+  if (sht == NULL || sht->result != NULL)
+    return;
+
+  sht->result = malloc(sizeof(HashTable *) * sht->partitions);
+
+  MergeJob job = {.sht = sht, .reduce = reduce, .ctx = ctx};
+
+  atomic_init(&job.next, 0);
+
+  uint32_t workers = sht->threads < sht->partitions ? sht->threads : sht->partitions;
+
+  pthread_t *threads = malloc(sizeof(pthread_t) * workers);
+
+  /* The calling thread is the last worker */
+  for (uint32_t i = 1; i < workers; i++)
+    pthread_create(&threads[i], NULL, mergeWorker, &job);
+
+  mergeWorker(&job);
+
+  for (uint32_t i = 1; i < workers; i++)
+    pthread_join(threads[i], NULL);
+
+  free(threads);
+
+  for (uint32_t t = 0; t < sht->threads; t++)
+  {
+    free(sht->shards[t].parts);
+
+    sht->shards[t].parts = NULL;
+  }
+}
+
+void *shardedHashTableGet(ShardedHashTable *sht, const char *key)
+{
+  if (sht == NULL || key == NULL || sht->result == NULL)
+    return NULL;
+
+  size_t len = strlen(key);
+
+  uint64_t hash = hashTableHashString(sht->result[0], key, len);
+
+  HashTable *ht = sht->result[partitionOf(sht, hash)];
+
+  return ht->get(ht, key, len, hash);
+}
+
+uint32_t shardedHashTablePartitions(ShardedHashTable *sht)
+{
+  return sht->partitions;
+}
+
+/* NULL before the merge */
+HashTable *shardedHashTablePartition(ShardedHashTable *sht, uint32_t partition)
+{
+  if (sht == NULL || sht->result == NULL || partition >= sht->partitions)
+    return NULL;
+
+  return sht->result[partition];
+}
+
+/* Before the merge keys are counted once for every shard that has them */
+uint32_t shardedHashTableCount(ShardedHashTable *sht)
+{
+  uint32_t count = 0;
+
+  for (uint32_t p = 0; p < sht->partitions; p++)
+  {
+    if (sht->result != NULL)
+    {
+      count += sht->result[p]->count;
+
+      continue;
+    }
+
+    for (uint32_t t = 0; t < sht->threads; t++)
+    {
+      if (sht->shards[t].parts != NULL)
+        count += sht->shards[t].parts[p]->count;
+    }
+  }
+
+  return count;
+}
+
+void shardedHashTableDestroy(ShardedHashTable *sht)
+{
+  if (sht == NULL)
+    return;
+
+  for (uint32_t p = 0; sht->result != NULL && p < sht->partitions; p++)
+    hashTableDestroy(sht->result[p]);
+
+  for (uint32_t t = 0; t < sht->threads; t++)
+  {
+    for (uint32_t p = 0; sht->shards[t].parts != NULL && p < sht->partitions; p++)
+      hashTableDestroy(sht->shards[t].parts[p]);
+
+    free(sht->shards[t].parts);
+  }
+
+  free(sht->result);
+
+  free(sht->shards);
+
+  free(sht);
+}
@@ -0,0 +1,510 @@
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "hash-table-internal.h"
+
+/*
+  On disk image of a HashTable that is used straight from a read-only
+  mapping. The file is a header, an open addressing slot array and a blob
+  with the keys. Slots refer to keys by their offset in the file, so the
+  image does not depend on where it is mapped. The slots are always
+  indexed with wyhash, whatever hash the saved table used.
+
+  Values are written as their bits, so they have to be plain data such as
+  integers or offsets into something the caller maps as well.
+*/
+
+/* Private */
+
+#define SNAPSHOT_MAGIC 0x50414e5354485348ULL /* "HSHTSNAP" */
+
+#define SNAPSHOT_VERSION 1
+
+/* Reads back differently on a machine with the other byte order */
+#define SNAPSHOT_ENDIAN 0x0102030405060708ULL
+
+typedef struct SnapshotHeader
+{
+  uint64_t magic;
+  uint64_t endian;
+  uint32_t version;
+  uint32_t headerSize;
+  uint64_t fileSize;
+  uint64_t count;
+  uint64_t capacity;
+  /* xxh3 of everything after the header */
+  uint64_t checksum;
+  uint64_t reserved;
+} SnapshotHeader;
+
+/* An offset of 0 points into the header, so it marks an empty slot */
+typedef struct SnapshotSlot
+{
+  uint64_t hash;
+  uint64_t keyOffset;
+  uint64_t keyLen;
+  uint64_t value;
+} SnapshotSlot;
+
+typedef struct MappedTable
+{
+  HashTable base;
+  const uint8_t *data;
+  size_t size;
+  const SnapshotSlot *slots;
+  uint64_t mask;
+} MappedTable;
+
+typedef struct SnapshotWriter
+{
+  SnapshotSlot *slots;
+  uint64_t mask;
+  char *keys;
+  size_t keysSize;
+  size_t keysCapacity;
+  uint64_t keysStart;
+} SnapshotWriter;
+
+static void writerAdd(void *ctx, const char *key, size_t len, void *value)
+{
+  SnapshotWriter *w = ctx;
+
+  /* Keys keep their NUL so a mapped table can print them */
+  if (w->keysSize + len + 1 > w->keysCapacity)
+  {
+    while (w->keysSize + len + 1 > w->keysCapacity)
+      w->keysCapacity = w->keysCapacity * 2 + 64;
+
+    w->keys = realloc(w->keys, w->keysCapacity);
+  }
+
+  uint64_t hash = wyhash(key, len);
+
+  uint64_t index = hash & w->mask;
+
+  while (w->slots[index].keyOffset != 0)
+    index = (index + 1) & w->mask;
+
+  w->slots[index].hash = hash;
+
+  w->slots[index].keyOffset = w->keysStart + w->keysSize;
+
+  w->slots[index].keyLen = len;
+
+  w->slots[index].value = (uint64_t)(uintptr_t)value;
+
+  memcpy(w->keys + w->keysSize, key, len);
+
+  w->keys[w->keysSize + len] = '\0';
+
+  w->keysSize += len + 1;
+}
+
+static bool writeAll(FILE *file, const void *data, size_t size)
+{
+  return size == 0 || fwrite(data, 1, size, file) == size;
+}
+
+static int64_t mappedFind(MappedTable *mt, const void *key, size_t len, uint64_t hash)
+{
+  uint64_t index = hash & mt->mask;
+
+  HASH_STAT_ADD(&mt->base, lookups, 1);
+
+  while (mt->slots[index].keyOffset != 0)
+  {
+    const SnapshotSlot *slot = &mt->slots[index];
+
+    HASH_STAT_ADD(&mt->base, probes, 1);
+
+    if (slot->hash == hash && slot->keyLen == len && memcmp(mt->data + slot->keyOffset, key, len) == 0)
+      return (int64_t)index;
+
+    index = (index + 1) & mt->mask;
+  }
+
+  return -1;
+}
+
+static void *mappedGet(HashTable *ht, const void *key, size_t len, uint64_t hash)
+{
+  MappedTable *mt = (MappedTable *)ht;
+
+  int64_t index = mappedFind(mt, key, len, hash);
+
+  if (index < 0)
+    return NULL;
+
+  return (void *)(uintptr_t)mt->slots[index].value;
+}
+
+static bool mappedAdd(HashTable *ht, const void *key, size_t len, uint64_t hash, void *value)
+{
+  return false;
+}
+
+static bool mappedRemove(HashTable *ht, const void *key, size_t len, uint64_t hash)
+{
+  return false;
+}
+
+static void mappedPrefetch(HashTable *ht, uint64_t hash, uint32_t stage)
+{
+  MappedTable *mt = (MappedTable *)ht;
+
+  const SnapshotSlot *slot = &mt->slots[hash & mt->mask];
+
+  if (stage == 0)
+    __builtin_prefetch(slot);
+  else if (slot->keyOffset != 0)
+    __builtin_prefetch(mt->data + slot->keyOffset);
+}
+
+/* Slots visited */
+static uint32_t mappedProbeLength(HashTable *ht, const void *key, size_t len, uint64_t hash)
+{
+  MappedTable *mt = (MappedTable *)ht;
+
+  uint64_t index = hash & mt->mask;
+
+  uint32_t probes = 1;
+
+  while (mt->slots[index].keyOffset != 0)
+  {
+    const SnapshotSlot *slot = &mt->slots[index];
+
+    if (slot->hash == hash && slot->keyLen == len && memcmp(mt->data + slot->keyOffset, key, len) == 0)
+      break;
+
+    index = (index + 1) & mt->mask;
+
+    probes++;
+  }
+
+  return probes;
+}
+
+/* The whole mapping, it may not all be resident */
+static size_t mappedMemoryUsage(HashTable *ht)
+{
+  return sizeof(MappedTable) + ((MappedTable *)ht)->size;
+}
+
+/* Keys live in the mapping, they are part of its table bytes */
+static void mappedStats(HashTable *ht, HashTableStats *stats)
+{
+  MappedTable *mt = (MappedTable *)ht;
+
+  uint32_t *lengths = calloc(mt->mask + 1, sizeof(uint32_t));
+
+  stats->tableBytes = mappedMemoryUsage(ht);
+
+  for (uint64_t i = 0; i <= mt->mask; i++)
+  {
+    if (mt->slots[i].keyOffset != 0)
+      lengths[mt->slots[i].hash & mt->mask]++;
+  }
+
+  for (uint64_t i = 0; i <= mt->mask; i++)
+    hashStatsChain(stats, lengths[i]);
+
+  free(lengths);
+}
+
+/* Nothing ever moves, a position is simply a slot */
+static uint64_t mappedScan(HashTable *ht, uint64_t cursor, hashTableVisit *visit, void *ctx)
+{
+  MappedTable *mt = (MappedTable *)ht;
+
+  const SnapshotSlot *slot = &mt->slots[cursor & mt->mask];
+
+  if (slot->keyOffset != 0)
+    visit(ctx, (const char *)mt->data + slot->keyOffset, slot->keyLen, (void *)(uintptr_t)slot->value);
+
+  return scanCursorNext(cursor, mt->mask);
+}
+
+static void mappedForEach(HashTable *ht, hashTableVisit *visit, void *ctx)
+{
+  MappedTable *mt = (MappedTable *)ht;
+
+  for (uint64_t i = 0; i <= mt->mask; i++)
+  {
+    const SnapshotSlot *slot = &mt->slots[i];
+
+    if (slot->keyOffset != 0)
+      visit(ctx, (const char *)mt->data + slot->keyOffset, slot->keyLen, (void *)(uintptr_t)slot->value);
+  }
+}
+
+static void mappedDestroy(HashTable *ht)
+{
+  MappedTable *mt = (MappedTable *)ht;
+
+  munmap((void *)mt->data, mt->size);
+
+  free(mt);
+}
+
+static void mappedPrint(HashTable *ht)
+{
+  MappedTable *mt = (MappedTable *)ht;
+
+  printf("------ Mapped Table ------\n");
+
+  printf("count -> %u\n", ht->count);
+
+  printf("size -> %u\n\n", ht->size);
+
+  printf("------ Entries ------\n");
+
+  for (uint64_t i = 0; i <= mt->mask; i++)
+  {
+    if (mt->slots[i].keyOffset != 0)
+      printf("key -> %s, index -> %lu\n", (const char *)mt->data + mt->slots[i].keyOffset, (unsigned long)i);
+  }
+
+  printf("-------------\n\n");
+}
+
+/* Everything a lookup relies on, checked once so lookups do not have to */
+static bool snapshotValid(const uint8_t *data, size_t size)
+{
+  if (size < sizeof(SnapshotHeader))
+    return false;
+
+  const SnapshotHeader *header = (const SnapshotHeader *)data;
+
+  if (header->magic != SNAPSHOT_MAGIC || header->endian != SNAPSHOT_ENDIAN)
+    return false;
+
+  if (header->version != SNAPSHOT_VERSION || header->headerSize != sizeof(SnapshotHeader))
+    return false;
+
+  if (header->fileSize != size)
+    return false;
+
+  uint64_t capacity = header->capacity;
+
+  /* Power of two with at least one empty slot, so every probe ends */
+  if (capacity == 0 || (capacity & (capacity - 1)) != 0 || header->count >= capacity || header->count > UINT32_MAX)
+    return false;
+
+  if (capacity > (size - sizeof(SnapshotHeader)) / sizeof(SnapshotSlot))
+    return false;
+
+  if (xxh3Hash(data + sizeof(SnapshotHeader), size - sizeof(SnapshotHeader)) != header->checksum)
+    return false;
+
+  const SnapshotSlot *slots = (const SnapshotSlot *)(data + sizeof(SnapshotHeader));
+
+  uint64_t keysStart = sizeof(SnapshotHeader) + capacity * sizeof(SnapshotSlot);
+
+  uint64_t count = 0;
+
+  for (uint64_t i = 0; i < capacity; i++)
+  {
+    if (slots[i].keyOffset == 0)
+      continue;
+
+    if (slots[i].keyOffset < keysStart || slots[i].keyOffset >= size || slots[i].keyLen >= size - slots[i].keyOffset)
+      return false;
+
+    count++;
+  }
+
+  return count == header->count;
+}
+
+/* Public functions */
+
+/*
+  Writes ht to path as a snapshot that hashTableMap can open. The file is
+  written next to path and renamed over it, so readers never see half of it
+*/
+bool hashTableSave(HashTable *ht, const char *path)
+{
+  if (ht == NULL || path == NULL)
+    return false;
+
+  uint64_t capacity = 8;
+
+  /* At most half full, probes stay short without tags */
+  while (capacity < (uint64_t)ht->count * 2)
+    capacity *= 2;
+
+  SnapshotWriter writer = {0};
+
+  writer.slots = calloc(capacity, sizeof(SnapshotSlot));
+
+  writer.mask = capacity - 1;
+
+  writer.keysStart = sizeof(SnapshotHeader) + capacity * sizeof(SnapshotSlot);
+
+  ht->forEach(ht, writerAdd, &writer);
+
+  size_t slotsSize = capacity * sizeof(SnapshotSlot);
+
+  size_t bodySize = slotsSize + writer.keysSize;
+
+  /* The checksum covers slots and keys as one run of bytes */
+  uint8_t *body = malloc(bodySize);
+
+  memcpy(body, writer.slots, slotsSize);
+
+  if (writer.keysSize > 0)
+    memcpy(body + slotsSize, writer.keys, writer.keysSize);
+
+  free(writer.slots);
+
+  free(writer.keys);
+
+  SnapshotHeader header = {0};
+
+  header.magic = SNAPSHOT_MAGIC;
+
+  header.endian = SNAPSHOT_ENDIAN;
+
+  header.version = SNAPSHOT_VERSION;
+
+  header.headerSize = sizeof(SnapshotHeader);
+
+  header.fileSize = sizeof(SnapshotHeader) + bodySize;
+
+  header.count = ht->count;
+
+  header.capacity = capacity;
+
+  header.checksum = xxh3Hash(body, bodySize);
+
+  size_t pathLen = strlen(path);
+
+  char *tmp = malloc(pathLen + 5);
+
+  memcpy(tmp, path, pathLen);
+
+  memcpy(tmp + pathLen, ".tmp", 5);
+
+  FILE *file = fopen(tmp, "wb");
+
+  bool ok = file != NULL;
+
+  if (ok)
+  {
+    ok = writeAll(file, &header, sizeof(header)) && writeAll(file, body, bodySize);
+
+    ok = fflush(file) == 0 && fsync(fileno(file)) == 0 && ok;
+
+    ok = fclose(file) == 0 && ok;
+  }
+
+  if (ok)
+    ok = rename(tmp, path) == 0;
+  else
+    unlink(tmp);
+
+  free(tmp);
+
+  free(body);
+
+  return ok;
+}
+
+/*
+  Maps a file written by hashTableSave. The table is read-only, adds,
+  upserts and removes fail. Returns NULL when the file is missing, truncated or does not
+  match its checksum
+*/
+HashTable *hashTableMap(const char *path)
+{
+  if (path == NULL)
+    return NULL;
+
+  int fd = open(path, O_RDONLY);
+
+  if (fd < 0)
+    return NULL;
+
+  struct stat st;
+
+  if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(SnapshotHeader))
+  {
+    close(fd);
+
+    return NULL;
+  }
+
+  size_t size = (size_t)st.st_size;
+
+  void *data = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+  close(fd);
+
+  if (data == MAP_FAILED)
+    return NULL;
+
+  if (!snapshotValid(data, size))
+  {
+    munmap(data, size);
+
+    return NULL;
+  }
+
+  const SnapshotHeader *header = data;
+
+  MappedTable *mt = malloc(sizeof(MappedTable));
+
+  /* The string API then hashes with wyhash as well */
+  HashTableOptions options = {.hashN = wyhash};
+
+  hashTableInit(&mt->base, &options);
+
+  mt->base.type = HashTableMapped;
+
+  mt->base.size = (uint32_t)(header->capacity > UINT32_MAX ? UINT32_MAX : header->capacity);
+
+  mt->base.initialSize = mt->base.size;
+
+  mt->base.count = (uint32_t)header->count;
+
+  mt->base.loadFactor = 0.5;
+
+  mt->base.get = mappedGet;
+
+  mt->base.add = mappedAdd;
+
+  mt->base.prefetch = mappedPrefetch;
+
+  mt->base.remove = mappedRemove;
+
+  mt->base.probeLength = mappedProbeLength;
+
+  mt->base.memoryUsage = mappedMemoryUsage;
+
+  mt->base.scan = mappedScan;
+
+  mt->base.stats = mappedStats;
+
+  mt->base.forEach = mappedForEach;
+
+  mt->base.destroy = mappedDestroy;
+
+  mt->base.print = mappedPrint;
+
+  mt->data = data;
+
+  mt->size = size;
+
+  mt->slots = (const SnapshotSlot *)((const uint8_t *)data + sizeof(SnapshotHeader));
+
+  mt->mask = header->capacity - 1;
+
+  return (HashTable *)mt;
+}
@@ -0,0 +1,712 @@
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stdio.h>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "hash-table-internal.h"
+
+/*
+  Open addressing table in the style of the SwissTable. Slots are split in
+  groups, every slot has one control byte: EMPTY, DELETED or the low 7 bits
+  of the hash of the key stored in it. A lookup compares the tag against a
+  whole group of control bytes at once and only compares keys on matches.
+*/
+
+/* Private */
+
+#if defined(__AVX2__)
+#define GROUP_WIDTH 32
+#elif defined(__SSE2__)
+#define GROUP_WIDTH 16
+#else
+#define GROUP_WIDTH 8
+#endif
+
+#define CTRL_EMPTY ((int8_t)-128)
+#define CTRL_DELETED ((int8_t)-2)
+
+/* Slots stay below 7/8 of the capacity, so every probe ends at an EMPTY */
+#define MAX_LOAD_NUM 7
+#define MAX_LOAD_DEN 8
+
+typedef struct SwissSlot
+{
+  uint64_t hash;
+  void *value;
+  HashKey key;
+} SwissSlot;
+
+typedef struct SwissTable
+{
+  HashTable base;
+  int8_t *ctrl;
+  SwissSlot *slots;
+  uint32_t groupMask;
+  uint32_t growthLeft;
+  uint32_t tombstones;
+} SwissTable;
+
+typedef uint32_t GroupMask;
+
+#if defined(__AVX2__)
+
+static inline GroupMask groupMatch(const int8_t *ctrl, int8_t tag)
+{
+  __m256i group = _mm256_loadu_si256((const __m256i *)ctrl);
+
+  return (GroupMask)_mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_set1_epi8(tag), group));
+}
+
+static inline GroupMask groupMatchEmptyOrDeleted(const int8_t *ctrl)
+{
+  __m256i group = _mm256_loadu_si256((const __m256i *)ctrl);
+
+  /* EMPTY and DELETED are the only negative values below -1 */
+  return (GroupMask)_mm256_movemask_epi8(_mm256_cmpgt_epi8(_mm256_set1_epi8(-1), group));
+}
+
+#elif defined(__SSE2__)
+
+static inline GroupMask groupMatch(const int8_t *ctrl, int8_t tag)
+{
+  __m128i group = _mm_loadu_si128((const __m128i *)ctrl);
+
+  return (GroupMask)_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_set1_epi8(tag), group));
+}
+
+static inline GroupMask groupMatchEmptyOrDeleted(const int8_t *ctrl)
+{
+  __m128i group = _mm_loadu_si128((const __m128i *)ctrl);
+
+  return (GroupMask)_mm_movemask_epi8(_mm_cmpgt_epi8(_mm_set1_epi8(-1), group));
+}
+
+#else
+
+static inline GroupMask groupMatch(const int8_t *ctrl, int8_t tag)
+{
+  GroupMask mask = 0;
+
+  for (uint32_t i = 0; i < GROUP_WIDTH; i++)
+    mask |= (GroupMask)(ctrl[i] == tag) << i;
+
+  return mask;
+}
+
+static inline GroupMask groupMatchEmptyOrDeleted(const int8_t *ctrl)
+{
+  GroupMask mask = 0;
+
+  for (uint32_t i = 0; i < GROUP_WIDTH; i++)
+    mask |= (GroupMask)(ctrl[i] < -1) << i;
+
+  return mask;
+}
+
+#endif
+
+static inline GroupMask groupMatchEmpty(const int8_t *ctrl)
+{
+  return groupMatch(ctrl, CTRL_EMPTY);
+}
+
+static inline uint32_t maskNext(GroupMask *mask)
+{
+  uint32_t index = (uint32_t)__builtin_ctz(*mask);
+
+  *mask &= *mask - 1;
+
+  return index;
+}
+
+/* djb2 and friends leave the high bits weak, spread them before splitting */
+static inline uint64_t swissHash(uint64_t hash)
+{
+  hash *= 0x9E3779B97F4A7C15ULL;
+
+  return hash ^ (hash >> 32);
+}
+
+static inline int8_t hashTag(uint64_t hash)
+{
+  return (int8_t)(hash & 0x7F);
+}
+
+static inline uint32_t hashGroup(SwissTable *st, uint64_t hash)
+{
+  return (uint32_t)(hash >> 7) & st->groupMask;
+}
+
+static inline uint32_t capacityOf(SwissTable *st)
+{
+  return (st->groupMask + 1) * GROUP_WIDTH;
+}
+
+static inline uint32_t maxGrowth(uint32_t capacity)
+{
+  return capacity / MAX_LOAD_DEN * MAX_LOAD_NUM;
+}
+
+/*
+  Groups are probed quadratically (triangular numbers), which visits every
+  group once when the number of groups is a power of two
+*/
+static int64_t swissFind(SwissTable *st, const void *key, size_t len, uint64_t hash)
+{
+  int8_t tag = hashTag(hash);
+
+  uint32_t group = hashGroup(st, hash);
+
+  uint32_t step = 0;
+
+  HASH_STAT_ADD(&st->base, lookups, 1);
+
+  while (true)
+  {
+    const int8_t *ctrl = st->ctrl + (size_t)group * GROUP_WIDTH;
+
+    GroupMask mask = groupMatch(ctrl, tag);
+
+    HASH_STAT_ADD(&st->base, probes, 1);
+
+    while (mask)
+    {
+      uint32_t slot = group * GROUP_WIDTH + maskNext(&mask);
+
+      if (st->slots[slot].hash == hash && hashKeyEquals(&st->slots[slot].key, key, len))
+        return slot;
+    }
+
+    if (groupMatchEmpty(ctrl))
+      return -1;
+
+    step++;
+
+    group = (group + step) & st->groupMask;
+  }
+}
+
+static uint32_t swissFindFree(SwissTable *st, uint64_t hash)
+{
+  uint32_t group = hashGroup(st, hash);
+
+  uint32_t step = 0;
+
+  while (true)
+  {
+    GroupMask mask = groupMatchEmptyOrDeleted(st->ctrl + (size_t)group * GROUP_WIDTH);
+
+    if (mask)
+      return group * GROUP_WIDTH + maskNext(&mask);
+
+    step++;
+
+    group = (group + step) & st->groupMask;
+  }
+}
+
+static void swissAllocate(SwissTable *st, uint32_t capacity)
+{
+  st->groupMask = capacity / GROUP_WIDTH - 1;
+
+  st->ctrl = malloc(capacity);
+
+  memset(st->ctrl, CTRL_EMPTY, capacity);
+
+  st->slots = malloc(sizeof(SwissSlot) * capacity);
+
+  st->growthLeft = maxGrowth(capacity);
+
+  st->tombstones = 0;
+
+  st->base.size = capacity;
+}
+
+static void swissResize(SwissTable *st, uint32_t newCapacity)
+{
+  uint64_t started = HASH_STAT_NOW();
+
+  int8_t *oldCtrl = st->ctrl;
+
+  SwissSlot *oldSlots = st->slots;
+
+  uint32_t oldCapacity = capacityOf(st);
+
+  swissAllocate(st, newCapacity);
+
+  for (uint32_t i = 0; i < oldCapacity; i++)
+  {
+    if (oldCtrl[i] < 0)
+      continue;
+
+    uint64_t hash = oldSlots[i].hash;
+
+    uint32_t slot = swissFindFree(st, hash);
+
+    st->ctrl[slot] = hashTag(hash);
+
+    st->slots[slot] = oldSlots[i];
+  }
+
+  st->growthLeft -= st->base.count;
+
+  free(oldCtrl);
+
+  free(oldSlots);
+
+  HASH_STAT_RESIZE(&st->base, started);
+}
+
+/*
+  Reclaims tombstones without growing. Full slots are first marked DELETED
+  (still to be placed) and DELETED ones EMPTY, then every pending slot is
+  moved to the first free slot of its own probe sequence.
+*/
+static void swissRehashInPlace(SwissTable *st)
+{
+  uint64_t started = HASH_STAT_NOW();
+
+  uint32_t capacity = capacityOf(st);
+
+  for (uint32_t i = 0; i < capacity; i++)
+    st->ctrl[i] = st->ctrl[i] >= 0 ? CTRL_DELETED : CTRL_EMPTY;
+
+  for (uint32_t i = 0; i < capacity; i++)
+  {
+    if (st->ctrl[i] != CTRL_DELETED)
+      continue;
+
+    uint64_t hash = st->slots[i].hash;
+
+    uint32_t target = swissFindFree(st, hash);
+
+    /* Already in the first group that has room, leave it there */
+    if (target / GROUP_WIDTH == i / GROUP_WIDTH)
+    {
+      st->ctrl[i] = hashTag(hash);
+
+      continue;
+    }
+
+    if (st->ctrl[target] == CTRL_EMPTY)
+    {
+      st->slots[target] = st->slots[i];
+
+      st->ctrl[target] = hashTag(hash);
+
+      st->ctrl[i] = CTRL_EMPTY;
+
+      continue;
+    }
+
+    /* Target still holds a pending entry, swap and place that one next */
+    SwissSlot tmp = st->slots[target];
+
+    st->slots[target] = st->slots[i];
+
+    st->slots[i] = tmp;
+
+    st->ctrl[target] = hashTag(hash);
+
+    i--;
+  }
+
+  st->growthLeft = maxGrowth(capacity) - st->base.count;
+
+  st->tombstones = 0;
+
+  HASH_STAT_RESIZE(&st->base, started);
+}
+
+static void swissReserveOne(SwissTable *st)
+{
+  if (st->growthLeft > 0)
+    return;
+
+  uint32_t capacity = capacityOf(st);
+
+  /* Mostly tombstones: cleaning them up is cheaper than doubling */
+  if (st->tombstones > 0 && st->base.count <= maxGrowth(capacity) / 2)
+    swissRehashInPlace(st);
+  else
+    swissResize(st, capacity * 2);
+}
+
+static void *swissGet(HashTable *ht, const void *key, size_t len, uint64_t hash)
+{
+  SwissTable *st = (SwissTable *)ht;
+
+  int64_t slot = swissFind(st, key, len, swissHash(hash));
+
+  if (slot < 0)
+    return NULL;
+
+  return st->slots[slot].value;
+}
+
+/*
+  Stage 0 pulls in the control group of the first probe, stage 1 finds the
+  tag in it and pulls in the slot it points at
+*/
+static void swissPrefetch(HashTable *ht, uint64_t hash, uint32_t stage)
+{
+  SwissTable *st = (SwissTable *)ht;
+
+  hash = swissHash(hash);
+
+  uint32_t group = hashGroup(st, hash);
+
+  const int8_t *ctrl = st->ctrl + (size_t)group * GROUP_WIDTH;
+
+  if (stage == 0)
+  {
+    __builtin_prefetch(ctrl);
+
+    return;
+  }
+
+  GroupMask mask = groupMatch(ctrl, hashTag(hash));
+
+  if (mask)
+    __builtin_prefetch(&st->slots[group * GROUP_WIDTH + maskNext(&mask)]);
+}
+
+/* Takes a free slot for key, which must not be in the table yet */
+static uint32_t swissInsert(SwissTable *st, const void *key, size_t len, uint64_t hash, void *value)
+{
+  uint32_t slot = swissFindFree(st, hash);
+
+  /* Reusing a tombstone never brings a probe closer to running out of EMPTY */
+  if (st->ctrl[slot] == CTRL_DELETED)
+  {
+    st->tombstones--;
+  }
+  else
+  {
+    swissReserveOne(st);
+
+    slot = swissFindFree(st, hash);
+
+    if (st->ctrl[slot] == CTRL_DELETED)
+      st->tombstones--;
+    else
+      st->growthLeft--;
+  }
+
+  st->ctrl[slot] = hashTag(hash);
+
+  st->slots[slot].hash = hash;
+
+  hashKeySet(&st->base, &st->slots[slot].key, key, len);
+
+  st->slots[slot].value = value;
+
+  st->base.count++;
+
+  st->base.version++;
+
+  return slot;
+}
+
+static bool swissAdd(HashTable *ht, const void *key, size_t len, uint64_t hash, void *value)
+{
+  SwissTable *st = (SwissTable *)ht;
+
+  hash = swissHash(hash);
+
+  if (swissFind(st, key, len, hash) >= 0)
+    return false;
+
+  swissInsert(st, key, len, hash, hashValueCopy(ht, value));
+
+  return true;
+}
+
+static void **swissGetOrInsert(HashTable *ht, const void *key, size_t len, uint64_t hash, bool *inserted)
+{
+  SwissTable *st = (SwissTable *)ht;
+
+  hash = swissHash(hash);
+
+  int64_t slot = swissFind(st, key, len, hash);
+
+  *inserted = slot < 0;
+
+  if (slot < 0)
+    slot = swissInsert(st, key, len, hash, NULL);
+
+  return &st->slots[slot].value;
+}
+
+static bool swissRemove(HashTable *ht, const void *key, size_t len, uint64_t hash)
+{
+  SwissTable *st = (SwissTable *)ht;
+
+  int64_t slot = swissFind(st, key, len, swissHash(hash));
+
+  if (slot < 0)
+    return false;
+
+  hashKeyFree(ht, &st->slots[slot].key);
+
+  hashValueFree(ht, st->slots[slot].value);
+
+  /*
+    A group that still has an EMPTY has never been full, so no probe went
+    past it and the slot can be handed back as EMPTY
+  */
+  if (groupMatchEmpty(st->ctrl + (slot / GROUP_WIDTH) * GROUP_WIDTH))
+  {
+    st->ctrl[slot] = CTRL_EMPTY;
+
+    st->growthLeft++;
+  }
+  else
+  {
+    st->ctrl[slot] = CTRL_DELETED;
+
+    st->tombstones++;
+  }
+
+  ht->count--;
+
+  ht->version++;
+
+  return true;
+}
+
+/* Groups visited, one for a key found in its home group */
+static uint32_t swissProbeLength(HashTable *ht, const void *key, size_t len, uint64_t hash)
+{
+  SwissTable *st = (SwissTable *)ht;
+
+  hash = swissHash(hash);
+
+  int8_t tag = hashTag(hash);
+
+  uint32_t group = hashGroup(st, hash);
+
+  uint32_t step = 0;
+
+  while (true)
+  {
+    const int8_t *ctrl = st->ctrl + (size_t)group * GROUP_WIDTH;
+
+    GroupMask mask = groupMatch(ctrl, tag);
+
+    while (mask)
+    {
+      uint32_t slot = group * GROUP_WIDTH + maskNext(&mask);
+
+      if (st->slots[slot].hash == hash && hashKeyEquals(&st->slots[slot].key, key, len))
+        return step + 1;
+    }
+
+    if (groupMatchEmpty(ctrl))
+      return step + 1;
+
+    step++;
+
+    group = (group + step) & st->groupMask;
+  }
+}
+
+static size_t swissMemoryUsage(HashTable *ht)
+{
+  SwissTable *st = (SwissTable *)ht;
+
+  uint32_t capacity = capacityOf(st);
+
+  size_t bytes = sizeof(SwissTable) + (size_t)capacity * (sizeof(SwissSlot) + 1);
+
+  for (uint32_t i = 0; i < capacity; i++)
+  {
+    if (st->ctrl[i] >= 0)
+      bytes += hashKeyHeapSize(&st->slots[i].key);
+  }
+
+  return bytes;
+}
+
+/* Chains are the entries of each home group, wherever they were placed */
+static void swissStats(HashTable *ht, HashTableStats *stats)
+{
+  SwissTable *st = (SwissTable *)ht;
+
+  uint32_t capacity = capacityOf(st);
+
+  uint32_t *lengths = calloc(st->groupMask + 1, sizeof(uint32_t));
+
+  stats->tableBytes = sizeof(SwissTable) + (size_t)capacity * (sizeof(SwissSlot) + 1);
+
+  for (uint32_t i = 0; i < capacity; i++)
+  {
+    if (st->ctrl[i] < 0)
+      continue;
+
+    lengths[hashGroup(st, st->slots[i].hash)]++;
+
+    stats->keyBytes += hashKeyHeapSize(&st->slots[i].key);
+  }
+
+  for (uint32_t i = 0; i <= st->groupMask; i++)
+    hashStatsChain(stats, lengths[i]);
+
+  free(lengths);
+}
+
+/*
+  A position is a home group. Its entries can sit anywhere along its probe
+  sequence up to the first group with an EMPTY, the same groups a lookup
+  would visit
+*/
+static uint64_t swissScan(HashTable *ht, uint64_t cursor, hashTableVisit *visit, void *ctx)
+{
+  SwissTable *st = (SwissTable *)ht;
+
+  uint32_t home = (uint32_t)(cursor & st->groupMask);
+
+  uint32_t group = home;
+
+  uint32_t step = 0;
+
+  while (true)
+  {
+    const int8_t *ctrl = st->ctrl + (size_t)group * GROUP_WIDTH;
+
+    for (uint32_t i = 0; i < GROUP_WIDTH; i++)
+    {
+      SwissSlot *slot = &st->slots[group * GROUP_WIDTH + i];
+
+      if (ctrl[i] >= 0 && hashGroup(st, slot->hash) == home)
+        visit(ctx, hashKeyBytes(&slot->key), slot->key.len, slot->value);
+    }
+
+    if (groupMatchEmpty(ctrl))
+      break;
+
+    step++;
+
+    group = (group + step) & st->groupMask;
+  }
+
+  return scanCursorNext(cursor, st->groupMask);
+}
+
+static void swissForEach(HashTable *ht, hashTableVisit *visit, void *ctx)
+{
+  SwissTable *st = (SwissTable *)ht;
+
+  uint32_t capacity = capacityOf(st);
+
+  for (uint32_t i = 0; i < capacity; i++)
+  {
+    if (st->ctrl[i] >= 0)
+      visit(ctx, hashKeyBytes(&st->slots[i].key), st->slots[i].key.len, st->slots[i].value);
+  }
+}
+
+static void swissDestroy(HashTable *ht)
+{
+  SwissTable *st = (SwissTable *)ht;
+
+  uint32_t capacity = capacityOf(st);
+
+  if (ht->arena == NULL)
+  {
+    for (uint32_t i = 0; i < capacity; i++)
+    {
+      if (st->ctrl[i] >= 0)
+        hashKeyFree(ht, &st->slots[i].key);
+    }
+  }
+
+  arenaDestroy(ht->arena);
+
+  free(st->ctrl);
+
+  free(st->slots);
+
+  free(st);
+}
+
+static void swissPrint(HashTable *ht)
+{
+  SwissTable *st = (SwissTable *)ht;
+
+  uint32_t capacity = capacityOf(st);
+
+  printf("------ Swiss Table ------\n");
+
+  printf("count -> %u\n", ht->count);
+
+  printf("size -> %u\n", ht->size);
+
+  printf("tombstones -> %u\n\n", st->tombstones);
+
+  printf("------ Entries ------\n");
+
+  for (uint32_t i = 0; i < capacity; i++)
+  {
+    if (st->ctrl[i] >= 0)
+      printf("key -> %s, index -> %u, group -> %u\n", hashKeyBytes(&st->slots[i].key), i, i / GROUP_WIDTH);
+  }
+
+  printf("-------------\n\n");
+}
+
+/* Public functions */
+
+HashTable *swissTableCreate(uint32_t size, const HashTableOptions *options)
+{
+  SwissTable *st = malloc(sizeof(SwissTable));
+
+  hashTableInit(&st->base, options);
+
+  uint32_t capacity = GROUP_WIDTH;
+
+  /* Room for size entries below the maximum load */
+  while (maxGrowth(capacity) < size)
+    capacity *= 2;
+
+  swissAllocate(st, capacity);
+
+  st->base.type = HashTableSwiss;
+
+  st->base.initialSize = capacity;
+
+  st->base.loadFactor = (double)MAX_LOAD_NUM / MAX_LOAD_DEN;
+
+  st->base.get = swissGet;
+
+  st->base.add = swissAdd;
+
+  st->base.getOrInsert = swissGetOrInsert;
+
+  st->base.prefetch = swissPrefetch;
+
+  st->base.remove = swissRemove;
+
+  st->base.probeLength = swissProbeLength;
+
+  st->base.memoryUsage = swissMemoryUsage;
+
+  st->base.scan = swissScan;
+
+  st->base.stats = swissStats;
+
+  st->base.forEach = swissForEach;
+
+  st->base.destroy = swissDestroy;
+
+  st->base.print = swissPrint;
+
+  return (HashTable *)st;
+}
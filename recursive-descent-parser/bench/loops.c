@@ -0,0 +1,383 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+
+#include "parser.h"
+#include "compiler.h"
+#include "vm.h"
+
+/*
+  Arithmetic loops run two ways: compiled to bytecode for the stack vm, and
+  evaluated straight off the tree by a walker written the usual way, with
+  variables looked up by name and every node dispatched on its type. Both
+  must end with the same value. Parse and compile time is left out of the
+  vm numbers, the walker gets the same tree for free
+
+  usage: bench-loops [scale]
+*/
+
+#define MAX_VARIABLES 256
+
+typedef struct Variable
+{
+  const char *name;
+  int64_t value;
+} Variable;
+
+typedef struct Walker
+{
+  Node *functions[32];
+  size_t functionCount;
+  Variable variables[MAX_VARIABLES];
+  size_t count;
+  /* Lookups stop at the frame of the function being run */
+  size_t frame;
+  int returning;
+  int64_t returned;
+} Walker;
+
+static uint64_t now(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+
+  return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+static int64_t evaluate(Walker *walker, Node *node);
+
+static void execute(Walker *walker, Node *node);
+
+static Variable *lookup(Walker *walker, const char *name)
+{
+  for (size_t i = walker->count; i > walker->frame; i--)
+    if (strcmp(walker->variables[i - 1].name, name) == 0)
+      return &walker->variables[i - 1];
+
+  fprintf(stderr, "unknown variable %s\n", name);
+
+  exit(1);
+}
+
+static void declare(Walker *walker, const char *name, int64_t value)
+{
+  walker->variables[walker->count++] = (Variable){name, value};
+}
+
+static int64_t call(Walker *walker, Node *node)
+{
+  const char *name = node->data.callExpression.callee->data.identifier.name;
+
+  Node *function = NULL;
+
+  for (size_t i = 0; i < walker->functionCount; i++)
+    if (strcmp(walker->functions[i]->data.functionDeclaration.id->data.identifier.name, name) == 0)
+      function = walker->functions[i];
+
+  LinkedListNode *param = function->data.functionDeclaration.params->data.list->head;
+
+  int64_t values[16];
+
+  size_t count = 0;
+
+  for (LinkedListNode *current = node->data.callExpression.arguments->data.list->head; current; current = current->next)
+    values[count++] = evaluate(walker, current->data);
+
+  size_t saved = walker->count, frame = walker->frame;
+
+  walker->frame = walker->count;
+
+  for (size_t i = 0; i < count; i++, param = param->next)
+    declare(walker, ((Node *)param->data)->data.identifier.name, values[i]);
+
+  Node *body = function->data.functionDeclaration.body;
+
+  int64_t result = 0;
+
+  if (body->type == BlockStatementNodeType)
+  {
+    execute(walker, body);
+
+    result = walker->returning ? walker->returned : 0;
+
+    walker->returning = 0;
+  }
+  else
+    result = evaluate(walker, body);
+
+  walker->count = saved;
+
+  walker->frame = frame;
+
+  return result;
+}
+
+static int64_t binary(const char *op, int64_t a, int64_t b)
+{
+  if (strcmp(op, "+") == 0)
+    return a + b;
+  if (strcmp(op, "-") == 0)
+    return a - b;
+  if (strcmp(op, "*") == 0)
+    return a * b;
+  if (strcmp(op, "/") == 0)
+    return a / b;
+  if (strcmp(op, "&") == 0)
+    return a & b;
+  if (strcmp(op, "|") == 0)
+    return a | b;
+  if (strcmp(op, "^") == 0)
+    return a ^ b;
+  if (strcmp(op, "==") == 0)
+    return a == b;
+  if (strcmp(op, "!=") == 0)
+    return a != b;
+  if (strcmp(op, "<") == 0)
+    return a < b;
+  if (strcmp(op, "<=") == 0)
+    return a <= b;
+  if (strcmp(op, ">") == 0)
+    return a > b;
+  if (strcmp(op, ">=") == 0)
+    return a >= b;
+
+  fprintf(stderr, "unknown operator %s\n", op);
+
+  exit(1);
+}
+
+static int64_t evaluate(Walker *walker, Node *node)
+{
+  switch (node->type)
+  {
+  case NumericLiteralNodeType:
+    return strtoll(node->data.literal, NULL, 10);
+  case IdentifierNodeType:
+    return lookup(walker, node->data.identifier.name)->value;
+  case BinaryExpressionNodeType:
+  {
+    const char *op = node->data.binary.operator;
+
+    if (strcmp(op, "=") == 0)
+      return lookup(walker, node->data.binary.left->data.identifier.name)->value = evaluate(walker, node->data.binary.right);
+
+    int64_t left = evaluate(walker, node->data.binary.left);
+
+    if (strcmp(op, "&&") == 0)
+      return left ? evaluate(walker, node->data.binary.right) : left;
+
+    if (strcmp(op, "||") == 0)
+      return left ? left : evaluate(walker, node->data.binary.right);
+
+    return binary(op, left, evaluate(walker, node->data.binary.right));
+  }
+  case UpdateExpressionNodeType:
+  {
+    Variable *variable = lookup(walker, node->data.updateExpression.argument->data.identifier.name);
+
+    int64_t old = variable->value;
+
+    variable->value += strcmp(node->data.updateExpression.operator, "++") == 0 ? 1 : -1;
+
+    return node->data.updateExpression.prefix ? variable->value : old;
+  }
+  case CallExpressionNodeType:
+    return call(walker, node);
+  default:
+    fprintf(stderr, "unsupported expression %d\n", node->type);
+
+    exit(1);
+  }
+}
+
+static void execute(Walker *walker, Node *node)
+{
+  if (walker->returning)
+    return;
+
+  switch (node->type)
+  {
+  case NodeListNodeType:
+    for (LinkedListNode *current = node->data.list->head; current && !walker->returning; current = current->next)
+      execute(walker, current->data);
+
+    break;
+  case BlockStatementNodeType:
+  {
+    size_t saved = walker->count;
+
+    if (node->data.block.body != NULL)
+      execute(walker, node->data.block.body);
+
+    walker->count = saved;
+
+    break;
+  }
+  case VariableDeclarationNodeType:
+    for (LinkedListNode *current = node->data.variableDeclaration.declarations->data.list->head; current; current = current->next)
+    {
+      Node *declarator = current->data;
+
+      Node *init = declarator->data.variableDeclarator.init;
+
+      declare(walker, declarator->data.variableDeclarator.id->data.identifier.name, init ? evaluate(walker, init) : 0);
+    }
+
+    break;
+  case ExpressionStatementNodeType:
+    evaluate(walker, node->data.expressionStatement.expression);
+
+    break;
+  case IfStatementNodeType:
+    if (evaluate(walker, node->data.ifStatement.test))
+      execute(walker, node->data.ifStatement.consequent);
+    else if (node->data.ifStatement.alternate != NULL)
+      execute(walker, node->data.ifStatement.alternate);
+
+    break;
+  case WhileStatementNodeType:
+    while (!walker->returning && evaluate(walker, node->data.whileStatement.test))
+      execute(walker, node->data.whileStatement.body);
+
+    break;
+  case ForStatementNodeType:
+  {
+    size_t saved = walker->count;
+
+    Node *init = node->data.forStatement.init;
+
+    if (init != NULL && init->type == VariableDeclarationNodeType)
+      execute(walker, init);
+    else if (init != NULL)
+      evaluate(walker, init);
+
+    while (!walker->returning && (node->data.forStatement.test == NULL || evaluate(walker, node->data.forStatement.test)))
+    {
+      execute(walker, node->data.forStatement.body);
+
+      if (node->data.forStatement.update != NULL)
+        evaluate(walker, node->data.forStatement.update);
+    }
+
+    walker->count = saved;
+
+    break;
+  }
+  case ReturnStatementNodeType:
+    walker->returned = node->data.returnStatement.argument ? evaluate(walker, node->data.returnStatement.argument) : 0;
+
+    walker->returning = 1;
+
+    break;
+  case FunctionDeclarationNodeType:
+    walker->functions[walker->functionCount++] = node;
+
+    break;
+  default:
+    break;
+  }
+}
+
+static int64_t walk(Node *program)
+{
+  Walker *walker = calloc(1, sizeof(Walker));
+
+  execute(walker, program->data.program.body);
+
+  int64_t result = walker->returned;
+
+  free(walker);
+
+  return result;
+}
+
+static Node *parseSource(const char *format, long n)
+{
+  char source[1024];
+
+  snprintf(source, sizeof(source), format, n, n);
+
+  char *input = source;
+
+  return parse(&input);
+}
+
+static void bench(const char *name, const char *format, long n)
+{
+  Node *program = parseSource(format, n);
+
+  Bytecode *bytecode = compile(program);
+
+  if (bytecode->error != NULL)
+  {
+    fprintf(stderr, "%s: %s\n", name, bytecode->error);
+
+    exit(1);
+  }
+
+  Vm *vm = vm_create();
+
+  uint64_t start = now();
+
+  Vm_Status status = vm_run(vm, bytecode->code, bytecode->count);
+
+  uint64_t vmTime = now() - start;
+
+  int64_t vmResult = vm_result(vm);
+
+  start = now();
+
+  int64_t walkResult = walk(program);
+
+  uint64_t walkTime = now() - start;
+
+  printf("%-8s %12lld %10.2f %10.2f %8.2fx %s\n", name, (long long)vmResult, walkTime / 1e6, vmTime / 1e6,
+         (double)walkTime / vmTime, status == VM_OK && vmResult == walkResult ? "ok" : "wrong result");
+
+  vm_destroy(vm);
+
+  freeBytecode(bytecode);
+
+  freeNode(program);
+}
+
+int main(int argc, char *argv[])
+{
+  long scale = argc > 1 ? atol(argv[1]) : 1;
+
+  printf("%-8s %12s %10s %10s %9s\n", "", "result", "tree ms", "vm ms", "speedup");
+
+  bench("sum",
+        "let sum = 0;\n"
+        "for (let i = 0; i < %ld; i++) {\n"
+        "  sum = sum + i * 3 - i / 2;\n"
+        "}\n"
+        "return sum;\n",
+        3000000 * scale);
+
+  bench("nested",
+        "let count = 0, i = 0;\n"
+        "while (i < %ld) {\n"
+        "  let j = 0;\n"
+        "  while (j < 1000) {\n"
+        "    if ((i ^ j) & 1) { count++; } else { count = count + 2; }\n"
+        "    j++;\n"
+        "  }\n"
+        "  i++;\n"
+        "}\n"
+        "return count;\n",
+        2000 * scale);
+
+  bench("fib",
+        "func fib(n: number): number => {\n"
+        "  if (n < 2) { return n; }\n"
+        "  return fib(n - 1) + fib(n - 2);\n"
+        "}\n"
+        "return fib(%ld);\n",
+        24 + scale);
+
+  return 0;
+}
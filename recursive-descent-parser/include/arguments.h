@@ -12,6 +12,8 @@
 typedef struct Arguments
 {
   char *file;
+  int run;
+  int bytecode;
 } Arguments;
 
 /* Function prototypes */
@@ -0,0 +1,43 @@
+#ifndef compiler_H
+#define compiler_H
+
+#include <stdlib.h>
+
+#include "node.h"
+#include "vm.h"
+
+/* Set EXTERN macro: */
+#ifdef compiler_IMPORT
+#define EXTERN
+#else
+#define EXTERN extern
+#endif
+
+/* Type declarations */
+
+typedef struct Bytecode
+{
+  Instruction *code;
+  size_t count;
+  size_t capacity;
+  char *error;
+} Bytecode;
+
+/* Function prototypes */
+
+/*
+  Lowers a program to bytecode for the stack vm. Values are integers,
+  variables live in stack slots and functions are called with CALL and
+  RET. print(x) prints x and evaluates to it, a return at the top level
+  ends the program with its value. When the tree has an error node or
+  uses something the vm cannot run, error is set and code is empty
+*/
+EXTERN Bytecode *compile(Node *program);
+
+EXTERN void printBytecode(Bytecode *bytecode);
+
+EXTERN void freeBytecode(Bytecode *bytecode);
+
+#undef compiler_IMPORT
+#undef EXTERN
+#endif
@@ -9,7 +9,7 @@
 
 Arguments *getArguments(int argc, char *argv[])
 {
-  Arguments *args = malloc(sizeof(Arguments));
+  Arguments *args = calloc(1, sizeof(Arguments));
 
   int index = 1;
 
@@ -23,6 +23,10 @@ Arguments *getArguments(int argc, char *argv[])
 
       args->file = value;
     }
+    else if (strcmp(arg, "--run") == 0)
+      args->run = 1;
+    else if (strcmp(arg, "--bytecode") == 0)
+      args->bytecode = 1;
   }
 
   return args;
@@ -0,0 +1,829 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdarg.h>
+
+#define compiler_IMPORT
+
+#include "compiler.h"
+
+/* Type declarations */
+
+/* Parameters get the negative slots below the frame, locals 0 and up */
+typedef struct Local
+{
+  char *name;
+  int64_t slot;
+  int constant;
+} Local;
+
+typedef struct Function
+{
+  char *name;
+  Node *node;
+  size_t params;
+  int64_t address;
+} Function;
+
+/* A CALL whose operand is filled in once every function has an address */
+typedef struct Call
+{
+  size_t at;
+  char *name;
+  size_t arguments;
+} Call;
+
+typedef struct Compiler
+{
+  Bytecode *bytecode;
+  Local *locals;
+  size_t localCount;
+  size_t localCapacity;
+  /* First local of the function being compiled, the ones below are not visible */
+  size_t frameStart;
+  int64_t slots;
+  size_t params;
+  Function *functions;
+  size_t functionCount;
+  size_t functionCapacity;
+  Call *calls;
+  size_t callCount;
+  size_t callCapacity;
+} Compiler;
+
+typedef struct BinaryOperator
+{
+  const char *op;
+  Instruction_Type type;
+} BinaryOperator;
+
+static const BinaryOperator binaryOperators[] = {
+    {"+", INST_PLUS},
+    {"-", INST_MINUS},
+    {"*", INST_MULT},
+    {"/", INST_DIV},
+    {"&", INST_AND},
+    {"|", INST_OR},
+    {"^", INST_XOR},
+    {"==", INST_EQ},
+    {"!=", INST_NE},
+    {"<", INST_LT},
+    {"<=", INST_LE},
+    {">", INST_GT},
+    {">=", INST_GE},
+};
+
+static const char *instructionNames[INST_COUNT] = {
+    [INST_PUSH] = "PUSH",
+    [INST_PLUS] = "PLUS",
+    [INST_MINUS] = "MINUS",
+    [INST_MULT] = "MULT",
+    [INST_DIV] = "DIV",
+    [INST_MOD] = "MOD",
+    [INST_NEG] = "NEG",
+    [INST_AND] = "AND",
+    [INST_OR] = "OR",
+    [INST_XOR] = "XOR",
+    [INST_NOT] = "NOT",
+    [INST_SHL] = "SHL",
+    [INST_SHR] = "SHR",
+    [INST_EQ] = "EQ",
+    [INST_NE] = "NE",
+    [INST_LT] = "LT",
+    [INST_LE] = "LE",
+    [INST_GT] = "GT",
+    [INST_GE] = "GE",
+    [INST_POP] = "POP",
+    [INST_DUP] = "DUP",
+    [INST_SWAP] = "SWAP",
+    [INST_OVER] = "OVER",
+    [INST_LOAD] = "LOAD",
+    [INST_STORE] = "STORE",
+    [INST_JUMP] = "JUMP",
+    [INST_JUMP_IF_ZERO] = "JUMP_IF_ZERO",
+    [INST_JUMP_IF_NOT_ZERO] = "JUMP_IF_NOT_ZERO",
+    [INST_CALL] = "CALL",
+    [INST_RET] = "RET",
+    [INST_PRINT] = "PRINT",
+    [INST_HALT] = "HALT",
+};
+
+static void compileStatement(Compiler *compiler, Node *node);
+
+static void compileExpression(Compiler *compiler, Node *node);
+
+/* Private functions */
+
+static void *grow(void *items, size_t *capacity, size_t count, size_t size)
+{
+  if (count < *capacity)
+    return items;
+
+  *capacity = *capacity ? *capacity * 2 : 16;
+
+  return realloc(items, *capacity * size);
+}
+
+/* Keeps the first error, the rest of the tree is still walked but nothing runs */
+static void error(Compiler *compiler, const char *format, ...)
+{
+  if (compiler->bytecode->error != NULL)
+    return;
+
+  char message[256];
+
+  va_list args;
+
+  va_start(args, format);
+
+  vsnprintf(message, sizeof(message), format, args);
+
+  va_end(args);
+
+  compiler->bytecode->error = strdup(message);
+}
+
+static size_t emit(Compiler *compiler, Instruction_Type type, int64_t operand)
+{
+  Bytecode *bytecode = compiler->bytecode;
+
+  bytecode->code = grow(bytecode->code, &bytecode->capacity, bytecode->count, sizeof(Instruction));
+
+  bytecode->code[bytecode->count] = (Instruction){operand, type};
+
+  return bytecode->count++;
+}
+
+/* Points the jump at index to the next instruction emitted */
+static void patch(Compiler *compiler, size_t index)
+{
+  compiler->bytecode->code[index].operand = (int64_t)compiler->bytecode->count;
+}
+
+static size_t here(Compiler *compiler)
+{
+  return compiler->bytecode->count;
+}
+
+static Local *findLocal(Compiler *compiler, const char *name)
+{
+  for (size_t i = compiler->localCount; i > compiler->frameStart; i--)
+  {
+    Local *local = &compiler->locals[i - 1];
+
+    if (strcmp(local->name, name) == 0)
+      return local;
+  }
+
+  return NULL;
+}
+
+static void addLocal(Compiler *compiler, char *name, int64_t slot, int constant)
+{
+  compiler->locals = grow(compiler->locals, &compiler->localCapacity, compiler->localCount, sizeof(Local));
+
+  compiler->locals[compiler->localCount++] = (Local){name, slot, constant};
+}
+
+/* The value of a new local is the one on top of the stack */
+static void declareLocal(Compiler *compiler, char *name, int constant)
+{
+  addLocal(compiler, name, compiler->slots++, constant);
+}
+
+/* Locals declared since start go out of scope, their slots are popped */
+static void endScope(Compiler *compiler, size_t start)
+{
+  while (compiler->localCount > start)
+  {
+    emit(compiler, INST_POP, 0);
+
+    compiler->localCount--;
+
+    compiler->slots--;
+  }
+}
+
+static Function *findFunction(Compiler *compiler, const char *name)
+{
+  for (size_t i = 0; i < compiler->functionCount; i++)
+    if (strcmp(compiler->functions[i].name, name) == 0)
+      return &compiler->functions[i];
+
+  return NULL;
+}
+
+/* Integer constant subtrees, folded the way the vm would compute them */
+static int foldConstant(Node *node, int64_t *value)
+{
+  if (node->type == NumericLiteralNodeType)
+  {
+    *value = strtoll(node->data.literal, NULL, 10);
+
+    return 1;
+  }
+
+  if (node->type != BinaryExpressionNodeType)
+    return 0;
+
+  int64_t a, b;
+
+  if (!foldConstant(node->data.binary.left, &a) || !foldConstant(node->data.binary.right, &b))
+    return 0;
+
+  const char *op = node->data.binary.operator;
+
+  if (strcmp(op, "+") == 0)
+    *value = (int64_t)((uint64_t)a + (uint64_t)b);
+  else if (strcmp(op, "-") == 0)
+    *value = (int64_t)((uint64_t)a - (uint64_t)b);
+  else if (strcmp(op, "*") == 0)
+    *value = (int64_t)((uint64_t)a * (uint64_t)b);
+  else if (strcmp(op, "/") == 0 && b != 0 && b != -1)
+    *value = a / b;
+  else if (strcmp(op, "&") == 0)
+    *value = a & b;
+  else if (strcmp(op, "|") == 0)
+    *value = a | b;
+  else if (strcmp(op, "^") == 0)
+    *value = a ^ b;
+  else if (strcmp(op, "==") == 0)
+    *value = a == b;
+  else if (strcmp(op, "!=") == 0)
+    *value = a != b;
+  else if (strcmp(op, "<") == 0)
+    *value = a < b;
+  else if (strcmp(op, "<=") == 0)
+    *value = a <= b;
+  else if (strcmp(op, ">") == 0)
+    *value = a > b;
+  else if (strcmp(op, ">=") == 0)
+    *value = a >= b;
+  else
+    return 0;
+
+  return 1;
+}
+
+static void compileAssignment(Compiler *compiler, Node *node)
+{
+  Node *target = node->data.binary.left;
+
+  if (target->type != IdentifierNodeType)
+  {
+    error(compiler, "Can only assign to a variable");
+
+    return;
+  }
+
+  Local *local = findLocal(compiler, target->data.identifier.name);
+
+  if (local == NULL)
+  {
+    error(compiler, "Unknown variable '%s'", target->data.identifier.name);
+
+    return;
+  }
+
+  if (local->constant)
+  {
+    error(compiler, "Assignment to constant '%s'", local->name);
+
+    return;
+  }
+
+  int64_t slot = local->slot;
+
+  compileExpression(compiler, node->data.binary.right);
+
+  emit(compiler, INST_DUP, 0);
+
+  emit(compiler, INST_STORE, slot);
+}
+
+/* Evaluates to the left value when it decides the result, like JavaScript */
+static void compileLogical(Compiler *compiler, Node *node, Instruction_Type shortCircuit)
+{
+  compileExpression(compiler, node->data.binary.left);
+
+  emit(compiler, INST_DUP, 0);
+
+  size_t end = emit(compiler, shortCircuit, 0);
+
+  emit(compiler, INST_POP, 0);
+
+  compileExpression(compiler, node->data.binary.right);
+
+  patch(compiler, end);
+}
+
+static void compileBinary(Compiler *compiler, Node *node)
+{
+  const char *op = node->data.binary.operator;
+
+  if (strcmp(op, "=") == 0)
+    return compileAssignment(compiler, node);
+
+  if (strcmp(op, "&&") == 0)
+    return compileLogical(compiler, node, INST_JUMP_IF_ZERO);
+
+  if (strcmp(op, "||") == 0)
+    return compileLogical(compiler, node, INST_JUMP_IF_NOT_ZERO);
+
+  for (size_t i = 0; i < sizeof(binaryOperators) / sizeof(binaryOperators[0]); i++)
+  {
+    if (strcmp(binaryOperators[i].op, op) != 0)
+      continue;
+
+    compileExpression(compiler, node->data.binary.left);
+
+    compileExpression(compiler, node->data.binary.right);
+
+    emit(compiler, binaryOperators[i].type, 0);
+
+    return;
+  }
+
+  error(compiler, "Unsupported operator '%s'", op);
+}
+
+static void compileUpdate(Compiler *compiler, Node *node)
+{
+  Node *argument = node->data.updateExpression.argument;
+
+  if (argument->type != IdentifierNodeType)
+  {
+    error(compiler, "Can only update a variable");
+
+    return;
+  }
+
+  Local *local = findLocal(compiler, argument->data.identifier.name);
+
+  if (local == NULL)
+  {
+    error(compiler, "Unknown variable '%s'", argument->data.identifier.name);
+
+    return;
+  }
+
+  if (local->constant)
+  {
+    error(compiler, "Assignment to constant '%s'", local->name);
+
+    return;
+  }
+
+  Instruction_Type step = strcmp(node->data.updateExpression.operator, "++") == 0 ? INST_PLUS : INST_MINUS;
+
+  emit(compiler, INST_LOAD, local->slot);
+
+  /* Postfix keeps the old value under the new one */
+  if (!node->data.updateExpression.prefix)
+    emit(compiler, INST_DUP, 0);
+
+  emit(compiler, INST_PUSH, 1);
+
+  emit(compiler, step, 0);
+
+  if (node->data.updateExpression.prefix)
+    emit(compiler, INST_DUP, 0);
+
+  emit(compiler, INST_STORE, local->slot);
+}
+
+static void compileCall(Compiler *compiler, Node *node)
+{
+  Node *callee = node->data.callExpression.callee;
+
+  NodeList *arguments = node->data.callExpression.arguments->data.list;
+
+  if (callee->type != IdentifierNodeType)
+  {
+    error(compiler, "Can only call a function by name");
+
+    return;
+  }
+
+  char *name = callee->data.identifier.name;
+
+  if (strcmp(name, "print") == 0)
+  {
+    if (arguments->count != 1)
+    {
+      error(compiler, "print takes one argument");
+
+      return;
+    }
+
+    compileExpression(compiler, arguments->head->data);
+
+    emit(compiler, INST_DUP, 0);
+
+    emit(compiler, INST_PRINT, 0);
+
+    return;
+  }
+
+  for (LinkedListNode *current = arguments->head; current; current = current->next)
+    compileExpression(compiler, current->data);
+
+  compiler->calls = grow(compiler->calls, &compiler->callCapacity, compiler->callCount, sizeof(Call));
+
+  compiler->calls[compiler->callCount++] = (Call){emit(compiler, INST_CALL, 0), name, (size_t)arguments->count};
+}
+
+static void compileExpression(Compiler *compiler, Node *node)
+{
+  int64_t value;
+
+  if (foldConstant(node, &value))
+  {
+    emit(compiler, INST_PUSH, value);
+
+    return;
+  }
+
+  switch (node->type)
+  {
+  case IdentifierNodeType:
+  {
+    Local *local = findLocal(compiler, node->data.identifier.name);
+
+    if (local == NULL)
+      error(compiler, "Unknown variable '%s'", node->data.identifier.name);
+    else
+      emit(compiler, INST_LOAD, local->slot);
+
+    break;
+  }
+  case BinaryExpressionNodeType:
+    compileBinary(compiler, node);
+
+    break;
+  case UpdateExpressionNodeType:
+    compileUpdate(compiler, node);
+
+    break;
+  case CallExpressionNodeType:
+    compileCall(compiler, node);
+
+    break;
+  case StringLiteralNodeType:
+    error(compiler, "Strings are not supported");
+
+    break;
+  case ErrorNodeType:
+    error(compiler, "%s", node->data.error.msg);
+
+    break;
+  default:
+    error(compiler, "Unsupported expression");
+
+    break;
+  }
+}
+
+/* Returns the jump taken when the test is 0, to be patched */
+static size_t compileTest(Compiler *compiler, Node *test)
+{
+  compileExpression(compiler, test);
+
+  return emit(compiler, INST_JUMP_IF_ZERO, 0);
+}
+
+static void compileVariableDeclaration(Compiler *compiler, Node *node)
+{
+  int constant = strcmp(node->data.variableDeclaration.kind, "const") == 0;
+
+  NodeList *declarations = node->data.variableDeclaration.declarations->data.list;
+
+  for (LinkedListNode *current = declarations->head; current; current = current->next)
+  {
+    Node *declarator = current->data;
+
+    Node *init = declarator->data.variableDeclarator.init;
+
+    if (init != NULL)
+      compileExpression(compiler, init);
+    else
+      emit(compiler, INST_PUSH, 0);
+
+    declareLocal(compiler, declarator->data.variableDeclarator.id->data.identifier.name, constant);
+  }
+}
+
+static void compileBlock(Compiler *compiler, Node *body)
+{
+  if (body == NULL)
+    return;
+
+  size_t start = compiler->localCount;
+
+  compileStatement(compiler, body);
+
+  endScope(compiler, start);
+}
+
+static void compileIf(Compiler *compiler, Node *node)
+{
+  size_t otherwise = compileTest(compiler, node->data.ifStatement.test);
+
+  compileStatement(compiler, node->data.ifStatement.consequent);
+
+  if (node->data.ifStatement.alternate == NULL)
+  {
+    patch(compiler, otherwise);
+
+    return;
+  }
+
+  size_t end = emit(compiler, INST_JUMP, 0);
+
+  patch(compiler, otherwise);
+
+  compileStatement(compiler, node->data.ifStatement.alternate);
+
+  patch(compiler, end);
+}
+
+static void compileWhile(Compiler *compiler, Node *node)
+{
+  size_t top = here(compiler);
+
+  size_t end = compileTest(compiler, node->data.whileStatement.test);
+
+  compileStatement(compiler, node->data.whileStatement.body);
+
+  emit(compiler, INST_JUMP, (int64_t)top);
+
+  patch(compiler, end);
+}
+
+/* The init declarations are scoped to the loop */
+static void compileFor(Compiler *compiler, Node *node)
+{
+  size_t start = compiler->localCount;
+
+  Node *init = node->data.forStatement.init;
+
+  if (init != NULL && init->type == VariableDeclarationNodeType)
+    compileVariableDeclaration(compiler, init);
+  else if (init != NULL)
+  {
+    compileExpression(compiler, init);
+
+    emit(compiler, INST_POP, 0);
+  }
+
+  size_t top = here(compiler);
+
+  size_t end = 0;
+
+  int hasTest = node->data.forStatement.test != NULL;
+
+  if (hasTest)
+    end = compileTest(compiler, node->data.forStatement.test);
+
+  compileStatement(compiler, node->data.forStatement.body);
+
+  if (node->data.forStatement.update != NULL)
+  {
+    compileExpression(compiler, node->data.forStatement.update);
+
+    emit(compiler, INST_POP, 0);
+  }
+
+  emit(compiler, INST_JUMP, (int64_t)top);
+
+  if (hasTest)
+    patch(compiler, end);
+
+  endScope(compiler, start);
+}
+
+static void compileReturn(Compiler *compiler, Node *node)
+{
+  if (node->data.returnStatement.argument != NULL)
+    compileExpression(compiler, node->data.returnStatement.argument);
+  else
+    emit(compiler, INST_PUSH, 0);
+
+  emit(compiler, INST_RET, (int64_t)compiler->params);
+}
+
+/* Functions are global and compiled after the main program, calls are patched at the end */
+static void declareFunction(Compiler *compiler, Node *node)
+{
+  char *name = node->data.functionDeclaration.id->data.identifier.name;
+
+  if (findFunction(compiler, name) != NULL || strcmp(name, "print") == 0)
+  {
+    error(compiler, "Function '%s' is already declared", name);
+
+    return;
+  }
+
+  compiler->functions = grow(compiler->functions, &compiler->functionCapacity, compiler->functionCount, sizeof(Function));
+
+  size_t params = (size_t)node->data.functionDeclaration.params->data.list->count;
+
+  compiler->functions[compiler->functionCount++] = (Function){name, node, params, -1};
+}
+
+static void compileStatement(Compiler *compiler, Node *node)
+{
+  switch (node->type)
+  {
+  case NodeListNodeType:
+  {
+    for (LinkedListNode *current = node->data.list->head; current; current = current->next)
+      compileStatement(compiler, current->data);
+
+    break;
+  }
+  case BlockStatementNodeType:
+    compileBlock(compiler, node->data.block.body);
+
+    break;
+  case VariableDeclarationNodeType:
+    compileVariableDeclaration(compiler, node);
+
+    break;
+  case ExpressionStatementNodeType:
+    compileExpression(compiler, node->data.expressionStatement.expression);
+
+    emit(compiler, INST_POP, 0);
+
+    break;
+  case IfStatementNodeType:
+    compileIf(compiler, node);
+
+    break;
+  case WhileStatementNodeType:
+    compileWhile(compiler, node);
+
+    break;
+  case ForStatementNodeType:
+    compileFor(compiler, node);
+
+    break;
+  case ReturnStatementNodeType:
+    compileReturn(compiler, node);
+
+    break;
+  case FunctionDeclarationNodeType:
+    declareFunction(compiler, node);
+
+    break;
+  case EmptyStatementNodeType:
+  case TypeAliasDeclarationNodeType:
+    break;
+  case ErrorNodeType:
+    error(compiler, "%s", node->data.error.msg);
+
+    break;
+  default:
+    error(compiler, "Unsupported statement");
+
+    break;
+  }
+}
+
+/* By index, declarations in the body can move the function table */
+static void compileFunction(Compiler *compiler, size_t index)
+{
+  Function function = compiler->functions[index];
+
+  Node *node = function.node;
+
+  compiler->functions[index].address = (int64_t)here(compiler);
+
+  compiler->frameStart = compiler->localCount;
+
+  compiler->slots = 0;
+
+  compiler->params = function.params;
+
+  int64_t slot = -(int64_t)function.params;
+
+  for (LinkedListNode *current = node->data.functionDeclaration.params->data.list->head; current; current = current->next)
+  {
+    Node *param = current->data;
+
+    if (param->type == IdentifierNodeType)
+      addLocal(compiler, param->data.identifier.name, slot++, 0);
+    else
+      error(compiler, "Default parameters are not supported in '%s'", function.name);
+  }
+
+  Node *body = node->data.functionDeclaration.body;
+
+  if (body->type == BlockStatementNodeType)
+  {
+    if (body->data.block.body != NULL)
+      compileStatement(compiler, body->data.block.body);
+
+    /* Falling off the end returns 0 */
+    emit(compiler, INST_PUSH, 0);
+  }
+  else
+    compileExpression(compiler, body);
+
+  emit(compiler, INST_RET, (int64_t)function.params);
+
+  compiler->localCount = compiler->frameStart;
+}
+
+static void linkCalls(Compiler *compiler)
+{
+  for (size_t i = 0; i < compiler->callCount; i++)
+  {
+    Call *call = &compiler->calls[i];
+
+    Function *function = findFunction(compiler, call->name);
+
+    if (function == NULL)
+    {
+      error(compiler, "Unknown function '%s'", call->name);
+
+      return;
+    }
+
+    if (function->params != call->arguments)
+    {
+      error(compiler, "'%s' takes %zu arguments, got %zu", call->name, function->params, call->arguments);
+
+      return;
+    }
+
+    compiler->bytecode->code[call->at].operand = function->address;
+  }
+}
+
+/* Public functions */
+
+Bytecode *compile(Node *program)
+{
+  Bytecode *bytecode = calloc(1, sizeof(Bytecode));
+
+  Compiler compiler = {.bytecode = bytecode};
+
+  compileStatement(&compiler, program->data.program.body);
+
+  emit(&compiler, INST_HALT, 0);
+
+  /* Declarations inside function bodies add to the list while it is walked */
+  for (size_t i = 0; i < compiler.functionCount; i++)
+    compileFunction(&compiler, i);
+
+  linkCalls(&compiler);
+
+  if (bytecode->error != NULL)
+    bytecode->count = 0;
+
+  free(compiler.locals);
+
+  free(compiler.functions);
+
+  free(compiler.calls);
+
+  return bytecode;
+}
+
+void printBytecode(Bytecode *bytecode)
+{
+  for (size_t i = 0; i < bytecode->count; i++)
+  {
+    Instruction inst = bytecode->code[i];
+
+    switch (inst.type)
+    {
+    case INST_PUSH:
+    case INST_LOAD:
+    case INST_STORE:
+    case INST_JUMP:
+    case INST_JUMP_IF_ZERO:
+    case INST_JUMP_IF_NOT_ZERO:
+    case INST_CALL:
+    case INST_RET:
+      printf("%4zu  %-16s %lld\n", i, instructionNames[inst.type], (long long)inst.operand);
+
+      break;
+    default:
+      printf("%4zu  %s\n", i, instructionNames[inst.type]);
+
+      break;
+    }
+  }
+}
+
+void freeBytecode(Bytecode *bytecode)
+{
+  free(bytecode->code);
+
+  free(bytecode->error);
+
+  free(bytecode);
+}
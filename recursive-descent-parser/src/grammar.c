@@ -10,16 +10,6 @@
 
 #include "grammar.h"
 
-typedef struct
-{
-  Token current;
-  Token previous;
-  bool hadError;
-  bool panicMode;
-} Parser;
-
-Parser parser;
-
 typedef Node *(*ParseFunction)(Lexer *lexer);
 
 typedef int (*IsOperator)(TokenType type);
@@ -743,21 +733,13 @@ Node *statements(Lexer *lexer)
 */
 Node *statementItem(Lexer *lexer)
 {
-  Node *s = statement(lexer);
-
-  if (s->type != ErrorNodeType)
-    return s;
-
+  /* Declarations start with a keyword, no statement does */
   Node *d = declaration(lexer);
 
-  printf("ERROR -> %s\n", s->data.error.msg);
-
-  if (d == NULL)
-    return s;
+  if (d != NULL)
+    return d;
 
-  freeNode(s);
-
-  return d;
+  return statement(lexer);
 }
 
 /*
@@ -812,11 +794,14 @@ Node *returnStatement(Lexer *lexer)
 
   Node *arg = NULL;
 
-  if (lexer->peek(lexer) == TokenSemicolon)
-    lexer->advance(lexer);
-  else
+  if (lexer->peek(lexer) != TokenSemicolon)
+  {
     arg = expression(lexer);
 
+    if (arg->type == ErrorNodeType)
+      return arg;
+  }
+
   if (lexer->peek(lexer) != TokenSemicolon)
   {
     if (arg)
@@ -1438,6 +1423,25 @@ Node *assignmentExpression(Lexer *lexer)
 
   Node *ce = conditionalExpression(lexer);
 
+  /* An identifier followed by "=" parses fine as a conditional expression */
+  if (ce->type == IdentifierNodeType && lexer->peek(lexer) == TokenEqual)
+  {
+    Token *operator= lexer->next(lexer);
+
+    Node *ae = assignmentExpression(lexer);
+
+    if (ae->type == ErrorNodeType)
+    {
+      freeToken(operator);
+
+      freeNode(ce);
+
+      return ae;
+    }
+
+    return binaryExpressionNodeFactory(ce, operator, ae);
+  }
+
   if (ce->type != ErrorNodeType || ce->data.error.type == LexicalError)
     return ce;
 
@@ -1447,8 +1451,6 @@ Node *assignmentExpression(Lexer *lexer)
 
   Node *lhse = leftHandSideExpression(lexer);
 
-  printf("SOURCE -> %s\n", *lexer->source);
-
   if (lhse->type == ErrorNodeType)
     return lhse;
 
@@ -1611,11 +1613,11 @@ Node *memberExpression(Lexer *lexer)
 
 /*
   ConditionalExpression ::=
-    EqualityExpression
+    LogicalOrExpression
 */
 Node *conditionalExpression(Lexer *lexer)
 {
-  return equalityExpression(lexer);
+  return logicalOrExpression(lexer);
 }
 
 /*
@@ -1631,15 +1633,15 @@ Node *equalityExpression(Lexer *lexer)
 
 /*
   RelationExpression ::=
-      LogicalOrExpression
-    | RelationExpression "<" LogicalOrExpression
-    | RelationExpression ">" LogicalOrExpression
-    | RelationExpression ">=" LogicalOrExpression
-    | RelationExpression "<=" LogicalOrExpression
+      AdditiveExpression
+    | RelationExpression "<" AdditiveExpression
+    | RelationExpression ">" AdditiveExpression
+    | RelationExpression ">=" AdditiveExpression
+    | RelationExpression "<=" AdditiveExpression
 */
 Node *relationalExpression(Lexer *lexer)
 {
-  return parseBinaryExpression(lexer, logicalOrExpression, isRelationalOp, logicalOrExpression);
+  return parseBinaryExpression(lexer, additiveExpression, isRelationalOp, additiveExpression);
 }
 
 /*
@@ -1654,7 +1656,7 @@ Node *logicalOrExpression(Lexer *lexer)
 
 /*
   LogicalAndExpression ::=
-      LogicalAndExpression
+      BitwiseOrExpression
     | LogicalAndExpression "&&" BitwiseOrExpression
 */
 Node *logicalAndExpression(Lexer *lexer)
@@ -1684,12 +1686,12 @@ Node *bitwiseXOrExpression(Lexer *lexer)
 
 /*
   BitwiseAndExpression ::=
-      AdditiveExpression
-    | BitwiseAndExpression "&" AdditiveExpression
+      EqualityExpression
+    | BitwiseAndExpression "&" EqualityExpression
 */
 Node *bitwiseAndExpression(Lexer *lexer)
 {
-  return parseBinaryExpression(lexer, additiveExpression, isBitwiseAndOp, additiveExpression);
+  return parseBinaryExpression(lexer, equalityExpression, isBitwiseAndOp, equalityExpression);
 }
 
 /*
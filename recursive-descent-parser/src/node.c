@@ -362,7 +362,7 @@ Node *errorNodeFactory(const char *message, Lexer *lexer, ...)
 
   char *suffix = " on line ";
 
-  size_t length = getCharacterCountInt(lexer->line) + getCharacterCountInt(lexer->col) + strlen(message) + strlen(suffix) + 1;
+  size_t length = getCharacterCountInt(lexer->line) + getCharacterCountInt(lexer->col) + strlen(message) + strlen(suffix) + 2;
 
   char result[length];
 
@@ -376,13 +376,9 @@ Node *errorNodeFactory(const char *message, Lexer *lexer, ...)
 
   va_end(args);
 
-  printf("%d\n", errorType);
-
   node->data.error.msg = strdup(result);
   node->data.error.type = !errorType ? SyntacticalError : errorType;
 
-  fprintf(stderr, "%s\n", result);
-
   return node;
 }
 
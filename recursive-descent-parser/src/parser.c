@@ -733,7 +733,7 @@ typedef struct Parser
   void (*advance)(void);
 } Parser;
 
-Parser parser;
+static Parser parser;
 
 static void advance()
 {
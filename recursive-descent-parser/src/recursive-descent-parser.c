@@ -6,6 +6,8 @@
 
 #include "parser.h"
 #include "arguments.h"
+#include "compiler.h"
+#include "vm.h"
 
 #define INITIAL_SIZE 10
 
@@ -37,6 +39,46 @@ void tokenize(Lexer *lexer)
   free(lexer);
 }
 
+/* Compiles the tree to bytecode and runs it on the stack vm, or prints the bytecode */
+int run(Node *program, Arguments *args)
+{
+  Bytecode *bytecode = compile(program);
+
+  if (bytecode->error != NULL)
+  {
+    fprintf(stderr, "Error: %s\n", bytecode->error);
+
+    freeBytecode(bytecode);
+
+    return 1;
+  }
+
+  if (args->bytecode)
+    printBytecode(bytecode);
+
+  int status = 0;
+
+  if (args->run)
+  {
+    Vm *vm = vm_create();
+
+    Vm_Status result = vm_run(vm, bytecode->code, bytecode->count);
+
+    if (result != VM_OK)
+    {
+      fprintf(stderr, "Runtime error: %s\n", vm_status_name(result));
+
+      status = 1;
+    }
+
+    vm_destroy(vm);
+  }
+
+  freeBytecode(bytecode);
+
+  return status;
+}
+
 int main(int argc, char *argv[])
 {
   char *input = malloc(INITIAL_SIZE * sizeof(char));
@@ -86,7 +128,12 @@ int main(int argc, char *argv[])
 
   Node *result = parse(&input);
 
-  visitNode(result, 0);
+  int status = 0;
+
+  if (args->run || args->bytecode)
+    status = run(result, args);
+  else
+    visitNode(result, 0);
 
   freeNode(result);
 
@@ -96,6 +143,9 @@ int main(int argc, char *argv[])
 
   input = NULL;
 
+  if (status != 0)
+    return status;
+
   // char *test = "\n\n\n\n\n\n\n\n";
 
   // Lexer *lexer = lexerFactory(&test);
@@ -0,0 +1,380 @@
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <sys/epoll.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+
+#include "bench.h"
+
+/*
+  Load generator for a running server. Keeps concurrency connections in
+  flight. Each one connects and sends requests GETs, depth of them
+  pipelined at a time, reading every response by its Content-Length,
+  then closes and the slot starts the next connection. Reports requests
+  and connections per second and the latency of a request, from sending
+  its batch to reading its response. A multi worker server needs as many
+  load threads to be kept busy.
+
+  usage: bench-connections [connections] [concurrency] [port] [threads] [requests] [depth]
+*/
+
+#define HOST "127.0.0.1"
+#define DEFAULT_PORT 1234
+#define MAX_DEPTH 64
+
+static const char request[] = "GET / HTTP/1.1\r\nHost: localhost\r\n\r\n";
+
+#define REQUEST_LENGTH (sizeof(request) - 1)
+
+typedef struct Client
+{
+  int fd;
+  /* Requests of the connection sent and answered so far */
+  size_t requests;
+  size_t responses;
+  /* The batch in flight */
+  size_t batch;
+  size_t sent;
+  uint64_t batch_start;
+  char buffer[16384];
+  size_t buffered;
+} Client;
+
+typedef struct Load
+{
+  pthread_t thread;
+  size_t connections;
+  size_t concurrency;
+  uint64_t *latencies;
+  size_t done;
+  size_t failed;
+  size_t answered;
+} Load;
+
+static struct sockaddr_in address;
+
+static size_t requests_per_connection = 1;
+
+static size_t depth = 1;
+
+static char batch[MAX_DEPTH * REQUEST_LENGTH];
+
+static int compare(const void *a, const void *b)
+{
+  uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+
+  return x < y ? -1 : x > y;
+}
+
+static void client_watch(int epoll_fd, Client *client, uint32_t events, int operation)
+{
+  struct epoll_event event = {.events = events, .data.ptr = client};
+
+  epoll_ctl(epoll_fd, operation, client->fd, &event);
+}
+
+static void client_next_batch(Client *client)
+{
+  size_t left = requests_per_connection - client->requests;
+
+  client->batch = left < depth ? left : depth;
+
+  client->sent = 0;
+}
+
+static int client_start(int epoll_fd, Client *client)
+{
+  client->fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
+
+  client->requests = 0;
+
+  client->responses = 0;
+
+  client->buffered = 0;
+
+  client_next_batch(client);
+
+  int one = 1;
+
+  setsockopt(client->fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+  if (connect(client->fd, (struct sockaddr *)&address, sizeof(address)) < 0 && errno != EINPROGRESS)
+  {
+    close(client->fd);
+
+    return -1;
+  }
+
+  client->batch_start = bench_now();
+
+  client_watch(epoll_fd, client, EPOLLOUT, EPOLL_CTL_ADD);
+
+  return 0;
+}
+
+/* Takes complete responses off the front of the buffer, returns how many */
+static size_t client_parse(Client *client)
+{
+  size_t count = 0;
+
+  while (1)
+  {
+    char *end = memmem(client->buffer, client->buffered, "\r\n\r\n", 4);
+
+    if (end == NULL)
+      return count;
+
+    size_t header = end + 4 - client->buffer, body = 0;
+
+    char *length = memmem(client->buffer, header, "Content-Length: ", 16);
+
+    if (length != NULL)
+      body = strtoul(length + 16, NULL, 10);
+
+    /* Responses are small pages, they have to fit in the buffer */
+    if (client->buffered < header + body)
+      return count;
+
+    memmove(client->buffer, client->buffer + header + body, client->buffered - header - body);
+
+    client->buffered -= header + body;
+
+    count++;
+  }
+}
+
+/* Returns 1 when the connection is done, -1 on an error and 0 to wait for more */
+static int client_step(int epoll_fd, Client *client, uint32_t events, Load *load)
+{
+  if (events & EPOLLERR)
+    return -1;
+
+  if (client->sent < client->batch * REQUEST_LENGTH)
+  {
+    ssize_t sent = send(client->fd, batch + client->sent, client->batch * REQUEST_LENGTH - client->sent, MSG_NOSIGNAL);
+
+    if (sent < 0)
+      return errno == EAGAIN ? 0 : -1;
+
+    client->sent += (size_t)sent;
+
+    if (client->sent == client->batch * REQUEST_LENGTH)
+    {
+      client->requests += client->batch;
+
+      client_watch(epoll_fd, client, EPOLLIN, EPOLL_CTL_MOD);
+    }
+
+    return 0;
+  }
+
+  while (1)
+  {
+    ssize_t received = recv(client->fd, client->buffer + client->buffered, sizeof(client->buffer) - client->buffered, 0);
+
+    if (received == 0)
+      return -1;
+
+    if (received < 0)
+      return errno == EAGAIN ? 0 : -1;
+
+    client->buffered += (size_t)received;
+
+    size_t answered = client_parse(client);
+
+    uint64_t latency = bench_now() - client->batch_start;
+
+    for (size_t i = 0; i < answered; i++)
+      load->latencies[load->answered++] = latency;
+
+    client->responses += answered;
+
+    if (client->responses < client->requests)
+      continue;
+
+    if (client->requests == requests_per_connection)
+      return 1;
+
+    client_next_batch(client);
+
+    client->batch_start = bench_now();
+
+    client_watch(epoll_fd, client, EPOLLOUT, EPOLL_CTL_MOD);
+
+    return 0;
+  }
+}
+
+/* One load generator thread, with its own epoll set and share of the connections */
+static void *load_run(void *arg)
+{
+  Load *load = arg;
+
+  int epoll_fd = epoll_create1(0);
+
+  Client *clients = calloc(load->concurrency, sizeof(Client));
+
+  size_t started = 0;
+
+  for (size_t i = 0; i < load->concurrency; i++, started++)
+    if (client_start(epoll_fd, &clients[i]) < 0)
+      load->failed++;
+
+  struct epoll_event events[256];
+
+  while (load->done + load->failed < load->connections)
+  {
+    int count = epoll_wait(epoll_fd, events, 256, 5000);
+
+    if (count == 0)
+    {
+      fprintf(stderr, "timed out with %zu connections in flight\n", started - load->done - load->failed);
+
+      load->failed += load->connections - load->done - load->failed;
+
+      break;
+    }
+
+    for (int i = 0; i < count; i++)
+    {
+      Client *client = events[i].data.ptr;
+
+      int result = client_step(epoll_fd, client, events[i].events, load);
+
+      if (result == 0)
+        continue;
+
+      close(client->fd);
+
+      if (result > 0)
+        load->done++;
+      else
+        load->failed++;
+
+      if (started < load->connections)
+      {
+        started++;
+
+        if (client_start(epoll_fd, client) < 0)
+          load->failed++;
+      }
+    }
+  }
+
+  free(clients);
+
+  close(epoll_fd);
+
+  return NULL;
+}
+
+int main(int argc, char *argv[])
+{
+  size_t connections = argc > 1 ? (size_t)atol(argv[1]) : 20000;
+
+  size_t concurrency = argc > 2 ? (size_t)atol(argv[2]) : 64;
+
+  int port = argc > 3 ? atoi(argv[3]) : DEFAULT_PORT;
+
+  size_t threads = argc > 4 ? (size_t)atol(argv[4]) : 1;
+
+  requests_per_connection = argc > 5 ? (size_t)atol(argv[5]) : 1;
+
+  depth = argc > 6 ? (size_t)atol(argv[6]) : 1;
+
+  if (threads == 0)
+    threads = 1;
+
+  if (requests_per_connection == 0)
+    requests_per_connection = 1;
+
+  if (depth == 0 || depth > MAX_DEPTH)
+    depth = depth == 0 ? 1 : MAX_DEPTH;
+
+  if (concurrency < threads)
+    concurrency = threads;
+
+  if (concurrency > connections)
+    concurrency = connections;
+
+  for (size_t i = 0; i < depth; i++)
+    memcpy(batch + i * REQUEST_LENGTH, request, REQUEST_LENGTH);
+
+  address.sin_family = AF_INET;
+  address.sin_port = htons(port);
+
+  inet_pton(AF_INET, HOST, &address.sin_addr);
+
+  uint64_t *latencies = malloc(connections * requests_per_connection * sizeof(uint64_t));
+
+  Load *loads = calloc(threads, sizeof(Load));
+
+  size_t offset = 0;
+
+  for (size_t i = 0; i < threads; i++)
+  {
+    loads[i].connections = connections / threads + (i < connections % threads);
+
+    loads[i].concurrency = concurrency / threads + (i < concurrency % threads);
+
+    loads[i].latencies = latencies + offset;
+
+    offset += loads[i].connections * requests_per_connection;
+  }
+
+  uint64_t start = bench_now();
+
+  for (size_t i = 0; i < threads; i++)
+    pthread_create(&loads[i].thread, NULL, load_run, &loads[i]);
+
+  size_t done = 0, failed = 0, answered = 0;
+
+  for (size_t i = 0; i < threads; i++)
+  {
+    pthread_join(loads[i].thread, NULL);
+
+    /* Packs the latencies of every thread at the front */
+    memmove(latencies + answered, loads[i].latencies, loads[i].answered * sizeof(uint64_t));
+
+    answered += loads[i].answered;
+
+    done += loads[i].done;
+
+    failed += loads[i].failed;
+  }
+
+  uint64_t elapsed = bench_now() - start;
+
+  qsort(latencies, answered, sizeof(uint64_t), compare);
+
+  printf("%zu connections, %zu concurrent, %zu threads, %zu requests each, %zu deep, %zu failed\n\n", connections,
+         concurrency, threads, requests_per_connection, depth, failed);
+
+  printf("%-14s %10.0f\n", "requests/s", answered / (elapsed / 1e9));
+
+  printf("%-14s %10.0f\n", "connections/s", done / (elapsed / 1e9));
+
+  if (answered > 0)
+  {
+    printf("%-14s %10.1f us\n", "latency p50", latencies[answered / 2] / 1e3);
+
+    printf("%-14s %10.1f us\n", "latency p99", latencies[answered * 99 / 100] / 1e3);
+
+    printf("%-14s %10.1f us\n", "latency max", latencies[answered - 1] / 1e3);
+  }
+
+  free(loads);
+
+  free(latencies);
+
+  return failed > 0 ? EXIT_FAILURE : EXIT_SUCCESS;
+}
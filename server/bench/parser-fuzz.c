@@ -0,0 +1,305 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "http-parser.h"
+
+/*
+  Differential fuzzer for the request parser, built with ASAN and UBSAN.
+  Every case is a random head or a mutated real one in a buffer of its
+  exact length, so any read past the end is caught. It is parsed whole by
+  the SSE2 parser and by the byte at a time one, linked in a second time
+  as http_parse_scalar, and fed to both a byte at a time and in random
+  splits. All of them have to agree on the result and on every slice.
+
+  usage: bench-parser-fuzz [cases] [seed]
+*/
+
+void http_parser_init_scalar(Http_Parser *parser);
+
+Http_Parse_Result http_parse_scalar(Http_Parser *parser, const char *data, size_t length, Http_Request *request);
+
+typedef Http_Parse_Result (*Parse)(Http_Parser *parser, const char *data, size_t length, Http_Request *request);
+
+#define MAX_CASE (80 * 1024)
+
+static const char *seeds[] = {
+    "GET / HTTP/1.1\r\nHost: localhost:1234\r\nUser-Agent: curl/7.88.1\r\nAccept: */*\r\n\r\n",
+    "HEAD /index.html?x=1 HTTP/1.0\r\nConnection: keep-alive\r\n\r\n",
+    "POST /form HTTP/1.1\r\nHost: a\r\nContent-Length: 12\r\nTransfer-Encoding: chunked\r\n\r\nhello world!",
+    "GET /assets/app.css HTTP/1.1\r\nHost: www.example.com\r\nConnection: keep-alive, Upgrade\r\n"
+    "Accept-Encoding: gzip, deflate, br\r\nCookie: session=8f14e45fceea167a5a36dedd4bea2543; theme=dark\r\n"
+    "If-None-Match: \"5f1c3e9a-2b4d\"\r\n\r\nGET / HTTP/1.1\r\n\r\n",
+};
+
+#define SEEDS (sizeof(seeds) / sizeof(seeds[0]))
+
+/* Pieces that make the parser take its other branches */
+static const char *tokens[] = {"\r\n", "\r\n\r\n", ": ", ":", " ", "\t", "\r", "\n", "HTTP/1.1", "HTTP/1.0",
+                               "Content-Length: ", "Connection: close", "\x7f", "\x80", "\0", "9999999999999999999"};
+
+#define TOKENS (sizeof(tokens) / sizeof(tokens[0]))
+
+static uint64_t state;
+
+static uint64_t next(void)
+{
+  state ^= state << 13;
+
+  state ^= state >> 7;
+
+  state ^= state << 17;
+
+  return state;
+}
+
+static size_t below(size_t n)
+{
+  return n == 0 ? 0 : (size_t)(next() % n);
+}
+
+static size_t append(char *data, size_t length, const char *piece, size_t piece_length)
+{
+  if (length + piece_length > MAX_CASE)
+    return length;
+
+  memcpy(data + length, piece, piece_length);
+
+  return length + piece_length;
+}
+
+static size_t token_length(const char *token)
+{
+  /* The NUL token is one byte long */
+  return token[0] == '\0' ? 1 : strlen(token);
+}
+
+/* Random tokens and bytes, mostly printable */
+static size_t generate(char *data)
+{
+  size_t length = 0, pieces = below(64) + 1;
+
+  for (size_t i = 0; i < pieces; i++)
+  {
+    if (below(3) == 0)
+    {
+      const char *token = tokens[below(TOKENS)];
+
+      length = append(data, length, token, token_length(token));
+    }
+    else
+    {
+      char run[32];
+
+      size_t run_length = below(sizeof(run)) + 1;
+
+      for (size_t j = 0; j < run_length; j++)
+        run[j] = below(8) == 0 ? (char)below(256) : (char)(0x21 + below(94));
+
+      length = append(data, length, run, run_length);
+    }
+  }
+
+  return length;
+}
+
+/* A head with a header too long to be buffered, whether or not it ends */
+static size_t oversize(char *data)
+{
+  size_t length = append(data, 0, "GET / HTTP/1.1\r\nX: ", 20);
+
+  size_t value_length = 60 * 1024 + below(12 * 1024);
+
+  memset(data + length, 'a', value_length);
+
+  length += value_length;
+
+  return below(2) ? append(data, length, "\r\n\r\n", 4) : length;
+}
+
+/* A seed head with a few bytes flipped, tokens inserted and ranges deleted or doubled */
+static size_t mutate(char *data)
+{
+  const char *seed = seeds[below(SEEDS)];
+
+  size_t length = append(data, 0, seed, strlen(seed));
+
+  size_t mutations = below(4) + 1;
+
+  for (size_t i = 0; i < mutations; i++)
+  {
+    size_t at = below(length + 1);
+
+    switch (below(4))
+    {
+    case 0:
+      if (at < length)
+        data[at] = (char)below(256);
+
+      break;
+    case 1:
+    {
+      const char *token = tokens[below(TOKENS)];
+
+      size_t token_size = token_length(token);
+
+      if (length + token_size > MAX_CASE)
+        break;
+
+      memmove(data + at + token_size, data + at, length - at);
+
+      memcpy(data + at, token, token_size);
+
+      length += token_size;
+
+      break;
+    }
+    case 2:
+    {
+      size_t count = below(length - at + 1);
+
+      memmove(data + at, data + at + count, length - at - count);
+
+      length -= count;
+
+      break;
+    }
+    default:
+    {
+      size_t count = below(length - at + 1);
+
+      if (length + count > MAX_CASE)
+        break;
+
+      memmove(data + at + count, data + at, length - at);
+
+      length += count;
+
+      break;
+    }
+    }
+  }
+
+  return length;
+}
+
+static int same_slice(const Http_Slice *a, const Http_Slice *b, const char *a_data, const char *b_data)
+{
+  return a->length == b->length && a->data - a_data == b->data - b_data;
+}
+
+/* Whether two parses of the same bytes, at a_data and b_data, came out the same */
+static int same(Http_Parse_Result a_result, const Http_Request *a, const char *a_data, Http_Parse_Result b_result,
+                const Http_Request *b, const char *b_data)
+{
+  if (a_result != b_result)
+    return 0;
+
+  /* Only a finished parse fills in the request */
+  if (a_result != HTTP_PARSE_DONE)
+    return 1;
+
+  if (a->head_length != b->head_length || a->minor_version != b->minor_version || a->header_count != b->header_count ||
+      a->content_length != b->content_length || a->chunked != b->chunked || a->keep_alive != b->keep_alive ||
+      !same_slice(&a->method, &b->method, a_data, b_data) || !same_slice(&a->target, &b->target, a_data, b_data))
+    return 0;
+
+  for (size_t i = 0; i < a->header_count; i++)
+    if (!same_slice(&a->headers[i].name, &b->headers[i].name, a_data, b_data) ||
+        !same_slice(&a->headers[i].value, &b->headers[i].value, a_data, b_data))
+      return 0;
+
+  return 1;
+}
+
+/* Feeds data in pieces of at most step bytes, or random ones when step is 0, until the parser is done with it */
+static Http_Parse_Result feed(Parse parse, const char *data, size_t length, size_t step, Http_Request *request)
+{
+  Http_Parser parser;
+
+  http_parser_init(&parser);
+
+  size_t available = 0;
+
+  while (1)
+  {
+    available += step ? step : below(48) + 1;
+
+    if (available > length)
+      available = length;
+
+    Http_Parse_Result result = parse(&parser, data, available, request);
+
+    if (result != HTTP_PARSE_INCOMPLETE || available == length)
+      return result;
+  }
+}
+
+static void fail(size_t number, const char *what, const char *data, size_t length)
+{
+  fprintf(stderr, "case %zu: %s disagree on %zu bytes:\n", number, what, length);
+
+  for (size_t i = 0; i < length; i++)
+    fprintf(stderr, "%02x%s", (unsigned char)data[i], i % 32 == 31 ? "\n" : " ");
+
+  fprintf(stderr, "\n");
+
+  exit(EXIT_FAILURE);
+}
+
+int main(int argc, char *argv[])
+{
+  size_t cases = argc > 1 ? strtoul(argv[1], NULL, 10) : 300000;
+
+  state = argc > 2 ? strtoull(argv[2], NULL, 10) : 0x9e3779b97f4a7c15ULL;
+
+  if (state == 0)
+    state = 1;
+
+  static char scratch[MAX_CASE];
+
+  size_t results[4] = {0};
+
+  for (size_t number = 0; number < cases; number++)
+  {
+    size_t length = below(1024) == 0 ? oversize(scratch) : below(2) ? generate(scratch) : mutate(scratch);
+
+    /* Exactly length bytes, so ASAN sees any read past them */
+    char *data = malloc(length ? length : 1);
+
+    memcpy(data, scratch, length);
+
+    Http_Parser parser;
+
+    Http_Request whole, scalar, split;
+
+    http_parser_init(&parser);
+
+    Http_Parse_Result result = http_parse(&parser, data, length, &whole);
+
+    http_parser_init_scalar(&parser);
+
+    if (!same(result, &whole, data, http_parse_scalar(&parser, data, length, &scalar), &scalar, data))
+      fail(number, "sse2 and scalar", data, length);
+
+    if (!same(result, &whole, data, feed(http_parse, data, length, 1, &split), &split, data))
+      fail(number, "whole and byte at a time", data, length);
+
+    if (!same(result, &whole, data, feed(http_parse, data, length, 0, &split), &split, data))
+      fail(number, "whole and random splits", data, length);
+
+    if (!same(result, &whole, data, feed(http_parse_scalar, data, length, 0, &split), &split, data))
+      fail(number, "whole and scalar random splits", data, length);
+
+    results[result]++;
+
+    free(data);
+  }
+
+  printf("%zu cases agree: %zu done, %zu incomplete, %zu invalid, %zu too large\n", cases,
+         results[HTTP_PARSE_DONE], results[HTTP_PARSE_INCOMPLETE], results[HTTP_PARSE_INVALID],
+         results[HTTP_PARSE_TOO_LARGE]);
+
+  return 0;
+}
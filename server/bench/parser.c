@@ -0,0 +1,146 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bench.h"
+#include "http-parser.h"
+
+/*
+  Parse throughput of the request parser. Each request is parsed whole,
+  as when a read brought all of it, and then fed chunk bytes at a time,
+  as when it trickles in, which is where only scanning the new bytes
+  pays off. Reports GB/s of request heads and requests per second. Build
+  with -DHTTP_PARSER_SCALAR in BENCHFLAGS to time the byte at a time loop.
+
+  usage: bench-parser [iterations] [chunk]
+*/
+
+typedef struct Sample
+{
+  const char *name;
+  const char *data;
+  const char *target;
+  size_t headers;
+  int keep_alive;
+} Sample;
+
+static const Sample samples[] = {
+    {"curl", "GET / HTTP/1.1\r\nHost: localhost:1234\r\nUser-Agent: curl/7.88.1\r\nAccept: */*\r\n\r\n", "/", 3, 1},
+    {"browser",
+     "GET /assets/stylesheets/application-5f1c3e9a.css?v=20240611 HTTP/1.1\r\n"
+     "Host: www.example.com\r\n"
+     "Connection: keep-alive\r\n"
+     "sec-ch-ua: \"Chromium\";v=\"124\", \"Google Chrome\";v=\"124\", \"Not-A.Brand\";v=\"99\"\r\n"
+     "sec-ch-ua-mobile: ?0\r\n"
+     "User-Agent: Mozilla/5.0 (X11; Linux x86_64) AppleWebKit/537.36 (KHTML, like Gecko) Chrome/124.0.0.0 Safari/537.36\r\n"
+     "sec-ch-ua-platform: \"Linux\"\r\n"
+     "Accept: text/css,*/*;q=0.1\r\n"
+     "Sec-Fetch-Site: same-origin\r\n"
+     "Sec-Fetch-Mode: no-cors\r\n"
+     "Sec-Fetch-Dest: style\r\n"
+     "Referer: https://www.example.com/articles/2024/06/zero-copy-parsing\r\n"
+     "Accept-Encoding: gzip, deflate, br, zstd\r\n"
+     "Accept-Language: en-GB,en-US;q=0.9,en;q=0.8,nl;q=0.7\r\n"
+     "Cookie: session=8f14e45fceea167a5a36dedd4bea2543; theme=dark; consent=analytics%3Dfalse%26ads%3Dfalse; _ga=GA1.1.1234567890.1717000000\r\n"
+     "If-None-Match: \"5f1c3e9a-2b4d\"\r\n"
+     "If-Modified-Since: Tue, 11 Jun 2024 08:15:27 GMT\r\n"
+     "\r\n",
+     "/assets/stylesheets/application-5f1c3e9a.css?v=20240611", 16, 1},
+    {"close", "HEAD /index.html HTTP/1.1\r\nHost: localhost\r\nConnection: close\r\n\r\n", "/index.html", 2, 0},
+};
+
+#define SAMPLES (sizeof(samples) / sizeof(samples[0]))
+
+/* Exits when the request did not come back as expected, so a broken parser cannot look fast */
+static void check(const Sample *sample, Http_Parse_Result result, const Http_Request *request)
+{
+  size_t length = strlen(sample->data);
+
+  if (result != HTTP_PARSE_DONE || request->head_length != length || request->header_count != sample->headers ||
+      request->keep_alive != sample->keep_alive || request->target.length != strlen(sample->target) ||
+      memcmp(request->target.data, sample->target, request->target.length) != 0)
+  {
+    fprintf(stderr, "%s: parsed wrong (result %d)\n", sample->name, result);
+
+    exit(EXIT_FAILURE);
+  }
+}
+
+/* Returns the result of the call that got the whole head */
+static Http_Parse_Result parse_chunked(Http_Parser *parser, const char *data, size_t length, size_t chunk, Http_Request *request)
+{
+  Http_Parse_Result result = HTTP_PARSE_INCOMPLETE;
+
+  for (size_t available = chunk; result == HTTP_PARSE_INCOMPLETE; available += chunk)
+    result = http_parse(parser, data, available < length ? available : length, request);
+
+  return result;
+}
+
+int main(int argc, char *argv[])
+{
+  size_t iterations = argc > 1 ? strtoul(argv[1], NULL, 10) : 2000000;
+
+  size_t chunk = argc > 2 ? strtoul(argv[2], NULL, 10) : 64;
+
+  if (iterations == 0 || chunk == 0)
+  {
+    fprintf(stderr, "usage: bench-parser [iterations] [chunk]\n");
+
+    return EXIT_FAILURE;
+  }
+
+#ifdef HTTP_PARSER_SCALAR
+  printf("scalar parser, %zu iterations, %zu byte chunks\n", iterations, chunk);
+#else
+  printf("sse2 parser, %zu iterations, %zu byte chunks\n", iterations, chunk);
+#endif
+
+  Http_Parser parser;
+
+  Http_Request request;
+
+  http_parser_init(&parser);
+
+  for (size_t i = 0; i < SAMPLES; i++)
+  {
+    const Sample *sample = &samples[i];
+
+    size_t length = strlen(sample->data);
+
+    check(sample, http_parse(&parser, sample->data, length, &request), &request);
+
+    check(sample, parse_chunked(&parser, sample->data, length, chunk, &request), &request);
+
+    uint64_t start = bench_now();
+
+    for (size_t j = 0; j < iterations; j++)
+    {
+      /* Keeps the compiler from hoisting the parse out of the loop */
+      __asm__ volatile("" : : "r"(sample->data) : "memory");
+
+      http_parse(&parser, sample->data, length, &request);
+    }
+
+    uint64_t whole = bench_now() - start;
+
+    start = bench_now();
+
+    for (size_t j = 0; j < iterations; j++)
+    {
+      __asm__ volatile("" : : "r"(sample->data) : "memory");
+
+      parse_chunked(&parser, sample->data, length, chunk, &request);
+    }
+
+    uint64_t chunked = bench_now() - start;
+
+    double bytes = (double)length * (double)iterations;
+
+    printf("%-8s %4zu bytes  whole %6.2f GB/s %6.2f Mreq/s  chunked %6.2f GB/s %6.2f Mreq/s\n", sample->name, length,
+           bytes / (double)whole, (double)iterations * 1000.0 / (double)whole, bytes / (double)chunked,
+           (double)iterations * 1000.0 / (double)chunked);
+  }
+
+  return 0;
+}
@@ -0,0 +1,24 @@
+#ifndef ARGUMENTS_H
+#define ARGUMENTS_H
+
+typedef struct Arguments
+{
+  int port;
+  /* One worker per core for 0 */
+  int workers;
+  int backlog;
+  /* Pin worker i to cpu i */
+  int pin;
+  /* Files are served from under here */
+  char *root;
+  /* Seconds a kept alive connection may sit idle */
+  int idle_timeout;
+} Arguments;
+
+/*
+  usage: server [--port n] [--workers n] [--backlog n] [--no-pin] [--root dir]
+                [--idle-timeout seconds]
+*/
+Arguments get_arguments(int argc, char *argv[]);
+
+#endif
@@ -0,0 +1,104 @@
+#ifndef CONNECTION_H
+#define CONNECTION_H
+
+#include <stdlib.h>
+#include <stdint.h>
+
+#include "event-loop.h"
+#include "file-cache.h"
+#include "http-parser.h"
+
+/*
+  A non-blocking client socket driven by the event loop. Reads are
+  buffered until they hold whole request heads, however many reads that
+  takes, and a head that does not parse is answered with 400 or 431 and
+  closes the connection.
+  Every complete request in the buffer is answered in order before the
+  responses are written out together, so pipelined requests share their
+  writes. The connection stays open for the next request unless respond
+  says otherwise, and is closed once it has been idle for too long. A
+  cached file is sent from the cache, its body is never copied into the
+  connection
+*/
+
+typedef struct Buffer
+{
+  char *data;
+  size_t length;
+  size_t capacity;
+} Buffer;
+
+/* A piece of queued output, bytes in the out buffer or a cached file */
+typedef struct Output
+{
+  Cached_File *file;
+  size_t offset;
+  size_t length;
+  int head;
+  int close;
+} Output;
+
+typedef struct Connection Connection;
+
+/*
+  Queues the response to the request with connection_send and
+  connection_send_file. The request points into the connection's buffer
+  and is only valid during the call. Returns 0 to close the connection
+  after it
+*/
+typedef int (*Connection_Respond)(Connection *connection, const Http_Request *request);
+
+/* The connections of one event loop, least recently active first */
+typedef struct Connections
+{
+  Connection *head;
+  Connection *tail;
+  uint64_t idle_timeout;
+  Connection_Respond respond;
+  void *context;
+  /* Counts every close, so an owner out of descriptors can tell when one is free again */
+  size_t closed;
+} Connections;
+
+struct Connection
+{
+  Event_Watcher watcher;
+  Connections *owner;
+  Connection *previous;
+  Connection *next;
+  uint64_t last_active;
+  Buffer in;
+  /* Start of the first request not answered yet */
+  size_t parsed;
+  Http_Parser parser;
+  Buffer out;
+  Output *queue;
+  size_t queue_head;
+  size_t queue_count;
+  size_t queue_capacity;
+  /* Bytes of the output at queue_head already sent */
+  size_t sent;
+  /* Set once a response said to close, nothing after it is answered */
+  int closing;
+  int eof;
+};
+
+/* idle_timeout is in ms */
+void connections_init(Connections *connections, uint64_t idle_timeout, Connection_Respond respond, void *context);
+
+/* An Event_Timeout, closes idle connections and returns the time until the next one expires */
+int connections_expire(Event_Loop *loop, void *connections);
+
+void connections_close_all(Connections *connections);
+
+/* Takes ownership of fd, which has to be non-blocking */
+Connection *connection_create(Connections *owner, int fd);
+
+void connection_send(Connection *connection, const void *data, size_t length);
+
+/* Takes over the reference to file, close picks the header that says so */
+void connection_send_file(Connection *connection, Cached_File *file, int head, int close);
+
+void connection_close(Connection *connection);
+
+#endif
@@ -0,0 +1,46 @@
+#ifndef EVENT_LOOP_H
+#define EVENT_LOOP_H
+
+#include <stdint.h>
+#include <sys/epoll.h>
+
+/*
+  An edge triggered epoll reactor. A file descriptor is watched through an
+  Event_Watcher, usually the first member of the struct that owns the fd,
+  so the handler gets its state back without a lookup. Being edge
+  triggered, a handler has to read or write until EAGAIN, or it will not
+  hear about that fd again
+*/
+
+typedef struct Event_Loop Event_Loop;
+
+typedef struct Event_Watcher Event_Watcher;
+
+typedef void (*Event_Handler)(Event_Loop *loop, Event_Watcher *watcher, uint32_t events);
+
+/* Runs before every wait, returns how many ms the loop may sleep, or -1 for no limit */
+typedef int (*Event_Timeout)(Event_Loop *loop, void *context);
+
+struct Event_Watcher
+{
+  int fd;
+  Event_Handler handler;
+};
+
+Event_Loop *event_loop_create(void);
+
+/* Adds fd with EPOLLET on top of events, returns -1 with errno set on failure */
+int event_loop_add(Event_Loop *loop, Event_Watcher *watcher, uint32_t events);
+
+int event_loop_remove(Event_Loop *loop, Event_Watcher *watcher);
+
+void event_loop_set_timeout(Event_Loop *loop, Event_Timeout timeout, void *context);
+
+/* Dispatches events until event_loop_stop is called from a handler */
+void event_loop_run(Event_Loop *loop);
+
+void event_loop_stop(Event_Loop *loop);
+
+void event_loop_destroy(Event_Loop *loop);
+
+#endif
@@ -0,0 +1,49 @@
+#ifndef FILE_CACHE_H
+#define FILE_CACHE_H
+
+#include <stdlib.h>
+
+#include "event-loop.h"
+
+/*
+  Files under a document root, with their response header built once.
+  Small files are mapped and their fd closed, so a response goes out in
+  one writev from the page cache. Big ones are kept open and sent with
+  sendfile. An inotify watch on every directory a file was loaded from
+  drops entries when they change. A cache belongs to one event loop and
+  is not shared between threads
+*/
+
+typedef struct File_Cache File_Cache;
+
+typedef struct Cached_File
+{
+  char *key;
+  /* -1 unless the file is sent with sendfile */
+  int fd;
+  size_t size;
+  /* NULL when the file is sent with sendfile */
+  char *map;
+  char *header;
+  size_t header_length;
+  char *close_header;
+  size_t close_header_length;
+  int references;
+  struct Cached_File *next;
+} Cached_File;
+
+/* Registers the inotify watcher with loop, returns NULL with errno set on failure */
+File_Cache *file_cache_create(const char *root, Event_Loop *loop);
+
+/*
+  Looks up path, relative to the root without a leading slash, loading it
+  on a miss. Returns a file the caller has to release, or NULL with the
+  http status to answer with in status
+*/
+Cached_File *file_cache_get(File_Cache *cache, const char *path, int *status);
+
+void file_cache_release(Cached_File *file);
+
+void file_cache_destroy(File_Cache *cache);
+
+#endif
@@ -0,0 +1,72 @@
+#ifndef HTTP_PARSER_H
+#define HTTP_PARSER_H
+
+#include <stdlib.h>
+
+/*
+  An HTTP/1.1 request head parser that does not allocate or copy. Method,
+  target and headers come back as slices into the caller's buffer, so they
+  are only valid until that buffer changes. Feed it the bytes of a request
+  as they arrive, it remembers how far it looked for the end of the head
+  and only scans the new bytes on the next call. Line ends and header
+  delimiters are found 16 bytes at a time with SSE2, build with
+  -DHTTP_PARSER_SCALAR for the byte at a time loop
+*/
+
+#define HTTP_MAX_HEADERS 32
+
+typedef struct Http_Slice
+{
+  const char *data;
+  size_t length;
+} Http_Slice;
+
+typedef struct Http_Header
+{
+  Http_Slice name;
+  Http_Slice value;
+} Http_Header;
+
+typedef struct Http_Request
+{
+  Http_Slice method;
+  Http_Slice target;
+  /* 0 for HTTP/1.0, 1 for HTTP/1.1 */
+  int minor_version;
+  Http_Header headers[HTTP_MAX_HEADERS];
+  size_t header_count;
+  /* Length of the head, up to and including the empty line */
+  size_t head_length;
+  size_t content_length;
+  int chunked;
+  int keep_alive;
+} Http_Request;
+
+typedef enum
+{
+  HTTP_PARSE_DONE,
+  HTTP_PARSE_INCOMPLETE,
+  HTTP_PARSE_INVALID,
+  HTTP_PARSE_TOO_LARGE,
+} Http_Parse_Result;
+
+typedef struct Http_Parser
+{
+  /* Bytes of the current request known not to end the head */
+  size_t scanned;
+} Http_Parser;
+
+void http_parser_init(Http_Parser *parser);
+
+/*
+  Parses the request at the start of data. Returns HTTP_PARSE_INCOMPLETE
+  until the whole head is there, with the same data start and more bytes
+  each time. After any other result the parser is ready for the next
+  request
+*/
+Http_Parse_Result http_parse(Http_Parser *parser, const char *data, size_t length, Http_Request *request);
+
+/* Case insensitive lookup, NULL when the header is missing */
+const Http_Slice *http_header(const Http_Request *request, const char *name);
+
+#endif
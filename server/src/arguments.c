@@ -0,0 +1,60 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "arguments.h"
+
+#define DEFAULT_PORT 1234
+#define DEFAULT_BACKLOG 4096
+#define DEFAULT_ROOT "../public"
+#define DEFAULT_IDLE_TIMEOUT 10
+
+/* Private */
+
+static int number(int argc, char *argv[], int *index)
+{
+  if (*index >= argc)
+  {
+    fprintf(stderr, "Missing value for %s\n", argv[*index - 1]);
+
+    exit(EXIT_FAILURE);
+  }
+
+  return atoi(argv[(*index)++]);
+}
+
+/* Public functions */
+
+Arguments get_arguments(int argc, char *argv[])
+{
+  Arguments args = {.port = DEFAULT_PORT, .workers = 0, .backlog = DEFAULT_BACKLOG, .pin = 1, .root = DEFAULT_ROOT,
+                    .idle_timeout = DEFAULT_IDLE_TIMEOUT};
+
+  int index = 1;
+
+  while (index < argc)
+  {
+    char *arg = argv[index++];
+
+    if (strcmp(arg, "--port") == 0)
+      args.port = number(argc, argv, &index);
+    else if (strcmp(arg, "--workers") == 0)
+      args.workers = number(argc, argv, &index);
+    else if (strcmp(arg, "--backlog") == 0)
+      args.backlog = number(argc, argv, &index);
+    else if (strcmp(arg, "--no-pin") == 0)
+      args.pin = 0;
+    else if (strcmp(arg, "--idle-timeout") == 0)
+      args.idle_timeout = number(argc, argv, &index);
+    else if (strcmp(arg, "--root") == 0 && index < argc)
+      args.root = argv[index++];
+    else
+    {
+      fprintf(stderr, "Unknown argument: %s\n", arg);
+
+      exit(EXIT_FAILURE);
+    }
+  }
+
+  return args;
+}
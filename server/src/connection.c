@@ -0,0 +1,497 @@
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+#include <unistd.h>
+#include <errno.h>
+#include <time.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <sys/sendfile.h>
+
+#include "connection.h"
+
+#define READ_SIZE 4096
+
+/* Stops answering a pipeline that does not read its responses */
+#define MAX_QUEUED 64
+
+#define IOVECS 64
+
+/* Private */
+
+static uint64_t now_ms(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+
+  return (uint64_t)ts.tv_sec * 1000 + (uint64_t)ts.tv_nsec / 1000000;
+}
+
+static void buffer_reserve(Buffer *buffer, size_t extra)
+{
+  if (buffer->length + extra <= buffer->capacity)
+    return;
+
+  size_t capacity = buffer->capacity ? buffer->capacity : READ_SIZE;
+
+  while (capacity < buffer->length + extra)
+    capacity *= 2;
+
+  buffer->data = realloc(buffer->data, capacity);
+
+  buffer->capacity = capacity;
+}
+
+static void connections_unlink(Connection *connection)
+{
+  Connections *owner = connection->owner;
+
+  if (connection->previous != NULL)
+    connection->previous->next = connection->next;
+  else
+    owner->head = connection->next;
+
+  if (connection->next != NULL)
+    connection->next->previous = connection->previous;
+  else
+    owner->tail = connection->previous;
+
+  connection->previous = connection->next = NULL;
+}
+
+static void connections_append(Connection *connection)
+{
+  Connections *owner = connection->owner;
+
+  connection->previous = owner->tail;
+
+  if (owner->tail != NULL)
+    owner->tail->next = connection;
+  else
+    owner->head = connection;
+
+  owner->tail = connection;
+}
+
+/* Moves the connection to the back of the idle list */
+static void connection_touch(Connection *connection)
+{
+  connection->last_active = now_ms();
+
+  if (connection->owner->tail == connection)
+    return;
+
+  connections_unlink(connection);
+
+  connections_append(connection);
+}
+
+static void connection_queue(Connection *connection, Output output)
+{
+  if (connection->queue_count == connection->queue_capacity)
+  {
+    connection->queue_capacity = connection->queue_capacity ? connection->queue_capacity * 2 : 8;
+
+    connection->queue = realloc(connection->queue, connection->queue_capacity * sizeof(Output));
+  }
+
+  connection->queue[connection->queue_count++] = output;
+}
+
+static const char *output_header(Output *output, size_t *length)
+{
+  *length = output->close ? output->file->close_header_length : output->file->header_length;
+
+  return output->close ? output->file->close_header : output->file->header;
+}
+
+static size_t output_length(Output *output)
+{
+  if (output->file == NULL)
+    return output->length;
+
+  size_t header_length;
+
+  output_header(output, &header_length);
+
+  return header_length + (output->head ? 0 : output->file->size);
+}
+
+/* Drops the outputs the sent bytes covered */
+static void connection_advance(Connection *connection, size_t sent)
+{
+  while (sent > 0)
+  {
+    Output *output = &connection->queue[connection->queue_head];
+
+    size_t remaining = output_length(output) - connection->sent;
+
+    if (sent < remaining)
+    {
+      connection->sent += sent;
+
+      return;
+    }
+
+    sent -= remaining;
+
+    if (output->file != NULL)
+      file_cache_release(output->file);
+
+    connection->queue_head++;
+
+    connection->sent = 0;
+  }
+
+  if (connection->queue_head == connection->queue_count)
+  {
+    connection->queue_head = connection->queue_count = 0;
+
+    connection->out.length = 0;
+  }
+}
+
+/*
+  One write of as much queued output as fits in a sendmsg. Headers and
+  mapped bodies are gathered into iovecs, an unmapped body is sent with
+  sendfile once everything before it is out, MSG_MORE keeps what comes
+  before it from leaving in a packet of its own
+*/
+static ssize_t connection_write(Connection *connection)
+{
+  struct iovec parts[IOVECS];
+
+  struct msghdr message = {.msg_iov = parts, .msg_iovlen = 0};
+
+  int flags = MSG_NOSIGNAL;
+
+  size_t skip = connection->sent;
+
+  for (size_t i = connection->queue_head; i < connection->queue_count && message.msg_iovlen < IOVECS - 1; i++, skip = 0)
+  {
+    Output *output = &connection->queue[i];
+
+    if (output->file == NULL)
+    {
+      parts[message.msg_iovlen++] = (struct iovec){connection->out.data + output->offset + skip, output->length - skip};
+
+      continue;
+    }
+
+    size_t header_length;
+
+    const char *header = output_header(output, &header_length);
+
+    if (skip < header_length)
+      parts[message.msg_iovlen++] = (struct iovec){(char *)header + skip, header_length - skip};
+
+    size_t body_length = output->head ? 0 : output->file->size;
+
+    size_t body_at = skip > header_length ? skip - header_length : 0;
+
+    if (body_length == 0)
+      continue;
+
+    if (output->file->map != NULL)
+    {
+      parts[message.msg_iovlen++] = (struct iovec){output->file->map + body_at, body_length - body_at};
+
+      continue;
+    }
+
+    if (message.msg_iovlen == 0)
+    {
+      off_t offset = (off_t)body_at;
+
+      return sendfile(connection->watcher.fd, output->file->fd, &offset, body_length - body_at);
+    }
+
+    flags |= MSG_MORE;
+
+    break;
+  }
+
+  return sendmsg(connection->watcher.fd, &message, flags);
+}
+
+/* Returns false once the connection is closed */
+static bool connection_flush(Connection *connection)
+{
+  while (connection->queue_head < connection->queue_count)
+  {
+    ssize_t sent = connection_write(connection);
+
+    if (sent < 0)
+    {
+      if (errno == EAGAIN || errno == EWOULDBLOCK)
+        return true;
+
+      if (errno == EINTR)
+        continue;
+
+      connection_close(connection);
+
+      return false;
+    }
+
+    /* Only sendfile returns 0, when the file shrank under it */
+    if (sent == 0)
+    {
+      connection_close(connection);
+
+      return false;
+    }
+
+    connection_advance(connection, (size_t)sent);
+
+    connection_touch(connection);
+  }
+
+  return true;
+}
+
+/* Answers a request that could not be parsed and stops reading, there is no telling where the next one starts */
+static void connection_reject(Connection *connection, Http_Parse_Result result)
+{
+  static const char bad_request[] = "HTTP/1.1 400 Bad Request\r\nContent-Length: 0\r\nConnection: close\r\n\r\n";
+
+  static const char too_large[] = "HTTP/1.1 431 Request Header Fields Too Large\r\nContent-Length: 0\r\nConnection: close\r\n\r\n";
+
+  if (result == HTTP_PARSE_TOO_LARGE)
+    connection_send(connection, too_large, sizeof(too_large) - 1);
+  else
+    connection_send(connection, bad_request, sizeof(bad_request) - 1);
+
+  connection->closing = 1;
+}
+
+/* Answers the complete requests in the buffer, returns whether there were any */
+static bool connection_answer(Connection *connection)
+{
+  bool answered = false;
+
+  while (!connection->closing && connection->parsed < connection->in.length &&
+         connection->queue_count - connection->queue_head < MAX_QUEUED)
+  {
+    Http_Request request;
+
+    Http_Parse_Result result = http_parse(&connection->parser, connection->in.data + connection->parsed,
+                                          connection->in.length - connection->parsed, &request);
+
+    if (result == HTTP_PARSE_INCOMPLETE)
+      break;
+
+    answered = true;
+
+    if (result != HTTP_PARSE_DONE)
+    {
+      connection_reject(connection, result);
+
+      break;
+    }
+
+    if (!connection->owner->respond(connection, &request))
+      connection->closing = 1;
+
+    connection->parsed += request.head_length;
+  }
+
+  return answered;
+}
+
+/* Returns 1 after reading something or the end of the stream, 0 on EAGAIN and -1 on an error */
+static int connection_read(Connection *connection)
+{
+  Buffer *in = &connection->in;
+
+  /* Keeps the unanswered part at the front, usually nothing is left. The parser only counts from there */
+  if (connection->parsed > 0)
+  {
+    memmove(in->data, in->data + connection->parsed, in->length - connection->parsed);
+
+    in->length -= connection->parsed;
+
+    connection->parsed = 0;
+  }
+
+  buffer_reserve(in, READ_SIZE);
+
+  while (1)
+  {
+    ssize_t received = recv(connection->watcher.fd, in->data + in->length, in->capacity - in->length, 0);
+
+    if (received < 0 && errno == EINTR)
+      continue;
+
+    if (received < 0)
+      return errno == EAGAIN || errno == EWOULDBLOCK ? 0 : -1;
+
+    if (received == 0)
+      connection->eof = 1;
+
+    in->length += (size_t)received;
+
+    connection_touch(connection);
+
+    return 1;
+  }
+}
+
+/*
+  Answers, writes and reads until the socket would block in the direction
+  the connection is waiting on. Being edge triggered, that is the only
+  point where it is safe to go back to the loop
+*/
+static void connection_run(Connection *connection)
+{
+  while (1)
+  {
+    bool answered = connection_answer(connection);
+
+    if (!connection_flush(connection))
+      return;
+
+    if (connection->queue_head < connection->queue_count)
+      return;
+
+    if (connection->closing)
+    {
+      connection_close(connection);
+
+      return;
+    }
+
+    if (answered)
+      continue;
+
+    if (connection->eof)
+    {
+      connection_close(connection);
+
+      return;
+    }
+
+    int result = connection_read(connection);
+
+    if (result < 0)
+    {
+      connection_close(connection);
+
+      return;
+    }
+
+    if (result == 0)
+      return;
+  }
+}
+
+static void connection_handle(Event_Loop *loop, Event_Watcher *watcher, uint32_t events)
+{
+  Connection *connection = (Connection *)watcher;
+
+  if (events & EPOLLERR)
+  {
+    connection_close(connection);
+
+    return;
+  }
+
+  connection_run(connection);
+}
+
+/* Public functions */
+
+void connections_init(Connections *connections, uint64_t idle_timeout, Connection_Respond respond, void *context)
+{
+  *connections = (Connections){.idle_timeout = idle_timeout, .respond = respond, .context = context};
+}
+
+int connections_expire(Event_Loop *loop, void *context)
+{
+  Connections *connections = context;
+
+  uint64_t now = now_ms();
+
+  while (connections->head != NULL && connections->head->last_active + connections->idle_timeout <= now)
+    connection_close(connections->head);
+
+  if (connections->head == NULL)
+    return -1;
+
+  return (int)(connections->head->last_active + connections->idle_timeout - now);
+}
+
+void connections_close_all(Connections *connections)
+{
+  while (connections->head != NULL)
+    connection_close(connections->head);
+}
+
+Connection *connection_create(Connections *owner, int fd)
+{
+  Connection *connection = calloc(1, sizeof(Connection));
+
+  connection->watcher.fd = fd;
+
+  connection->watcher.handler = connection_handle;
+
+  connection->owner = owner;
+
+  connection->last_active = now_ms();
+
+  http_parser_init(&connection->parser);
+
+  connections_append(connection);
+
+  return connection;
+}
+
+void connection_send(Connection *connection, const void *data, size_t length)
+{
+  if (length == 0)
+    return;
+
+  buffer_reserve(&connection->out, length);
+
+  memcpy(connection->out.data + connection->out.length, data, length);
+
+  Output *last = connection->queue_count > connection->queue_head ? &connection->queue[connection->queue_count - 1] : NULL;
+
+  /* Bytes sent right after other bytes go out as one piece */
+  if (last != NULL && last->file == NULL && last->offset + last->length == connection->out.length)
+    last->length += length;
+  else
+    connection_queue(connection, (Output){.offset = connection->out.length, .length = length});
+
+  connection->out.length += length;
+}
+
+void connection_send_file(Connection *connection, Cached_File *file, int head, int close)
+{
+  connection_queue(connection, (Output){.file = file, .head = head, .close = close});
+}
+
+/* Closing the only descriptor for the socket also takes it out of epoll */
+void connection_close(Connection *connection)
+{
+  connection->owner->closed++;
+
+  connections_unlink(connection);
+
+  close(connection->watcher.fd);
+
+  for (size_t i = connection->queue_head; i < connection->queue_count; i++)
+    if (connection->queue[i].file != NULL)
+      file_cache_release(connection->queue[i].file);
+
+  free(connection->queue);
+
+  free(connection->in.data);
+
+  free(connection->out.data);
+
+  free(connection);
+}
@@ -0,0 +1,95 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdbool.h>
+#include <unistd.h>
+#include <errno.h>
+
+#include "event-loop.h"
+
+#define MAX_EVENTS 256
+
+struct Event_Loop
+{
+  int epoll_fd;
+  bool running;
+  Event_Timeout timeout;
+  void *timeout_context;
+};
+
+/* Public functions */
+
+Event_Loop *event_loop_create(void)
+{
+  int epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+
+  if (epoll_fd < 0)
+    return NULL;
+
+  Event_Loop *loop = calloc(1, sizeof(Event_Loop));
+
+  loop->epoll_fd = epoll_fd;
+
+  return loop;
+}
+
+int event_loop_add(Event_Loop *loop, Event_Watcher *watcher, uint32_t events)
+{
+  struct epoll_event event = {.events = events | EPOLLET, .data.ptr = watcher};
+
+  return epoll_ctl(loop->epoll_fd, EPOLL_CTL_ADD, watcher->fd, &event);
+}
+
+int event_loop_remove(Event_Loop *loop, Event_Watcher *watcher)
+{
+  return epoll_ctl(loop->epoll_fd, EPOLL_CTL_DEL, watcher->fd, NULL);
+}
+
+void event_loop_set_timeout(Event_Loop *loop, Event_Timeout timeout, void *context)
+{
+  loop->timeout = timeout;
+
+  loop->timeout_context = context;
+}
+
+void event_loop_run(Event_Loop *loop)
+{
+  struct epoll_event events[MAX_EVENTS];
+
+  loop->running = true;
+
+  while (loop->running)
+  {
+    int wait = loop->timeout != NULL ? loop->timeout(loop, loop->timeout_context) : -1;
+
+    int count = epoll_wait(loop->epoll_fd, events, MAX_EVENTS, wait);
+
+    if (count < 0)
+    {
+      if (errno == EINTR)
+        continue;
+
+      perror("epoll_wait");
+
+      break;
+    }
+
+    for (int i = 0; i < count; i++)
+    {
+      Event_Watcher *watcher = events[i].data.ptr;
+
+      watcher->handler(loop, watcher, events[i].events);
+    }
+  }
+}
+
+void event_loop_stop(Event_Loop *loop)
+{
+  loop->running = false;
+}
+
+void event_loop_destroy(Event_Loop *loop)
+{
+  close(loop->epoll_fd);
+
+  free(loop);
+}
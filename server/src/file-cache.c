@@ -0,0 +1,552 @@
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <limits.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/inotify.h>
+
+#include "file-cache.h"
+
+/* Bigger files are not mapped, sendfile streams them from the fd */
+#define MAP_LIMIT (1024 * 1024)
+
+/* Past this many entries files are still served, just not kept */
+#define MAX_ENTRIES 4096
+
+#define WATCH_MASK (IN_MODIFY | IN_CLOSE_WRITE | IN_ATTRIB | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | \
+                    IN_DELETE_SELF | IN_MOVE_SELF)
+
+typedef struct Directory_Watch
+{
+  int wd;
+  /* Relative to the root, "" for the root itself */
+  char *path;
+} Directory_Watch;
+
+struct File_Cache
+{
+  Event_Watcher watcher;
+  int root_fd;
+  char *root;
+  Cached_File **buckets;
+  size_t bucket_count;
+  size_t count;
+  Directory_Watch *watches;
+  size_t watch_count;
+  size_t watch_capacity;
+};
+
+typedef struct Content_Type
+{
+  const char *extension;
+  const char *type;
+} Content_Type;
+
+static const Content_Type content_types[] = {
+    {"html", "text/html"},
+    {"htm", "text/html"},
+    {"css", "text/css"},
+    {"js", "text/javascript"},
+    {"json", "application/json"},
+    {"txt", "text/plain"},
+    {"svg", "image/svg+xml"},
+    {"png", "image/png"},
+    {"jpg", "image/jpeg"},
+    {"jpeg", "image/jpeg"},
+    {"gif", "image/gif"},
+    {"ico", "image/x-icon"},
+    {"wasm", "application/wasm"},
+};
+
+/* Private */
+
+static uint64_t hash(const char *key)
+{
+  uint64_t hash = 14695981039346656037ULL;
+
+  for (; *key; key++)
+    hash = (hash ^ (uint8_t)*key) * 1099511628211ULL;
+
+  return hash;
+}
+
+static const char *content_type(const char *path)
+{
+  const char *dot = strrchr(path, '.');
+
+  if (dot != NULL && strchr(dot, '/') == NULL)
+    for (size_t i = 0; i < sizeof(content_types) / sizeof(content_types[0]); i++)
+      if (strcasecmp(dot + 1, content_types[i].extension) == 0)
+        return content_types[i].type;
+
+  return "application/octet-stream";
+}
+
+static void file_free(Cached_File *file)
+{
+  if (file->map != NULL)
+    munmap(file->map, file->size);
+
+  if (file->fd >= 0)
+    close(file->fd);
+
+  free(file->header);
+
+  free(file->close_header);
+
+  free(file->key);
+
+  free(file);
+}
+
+static void file_cache_grow(File_Cache *cache)
+{
+  size_t bucket_count = cache->bucket_count * 2;
+
+  Cached_File **buckets = calloc(bucket_count, sizeof(Cached_File *));
+
+  for (size_t i = 0; i < cache->bucket_count; i++)
+  {
+    Cached_File *file = cache->buckets[i];
+
+    while (file != NULL)
+    {
+      Cached_File *next = file->next;
+
+      size_t index = hash(file->key) & (bucket_count - 1);
+
+      file->next = buckets[index];
+
+      buckets[index] = file;
+
+      file = next;
+    }
+  }
+
+  free(cache->buckets);
+
+  cache->buckets = buckets;
+
+  cache->bucket_count = bucket_count;
+}
+
+static void file_cache_insert(File_Cache *cache, Cached_File *file)
+{
+  if (cache->count >= cache->bucket_count)
+    file_cache_grow(cache);
+
+  size_t index = hash(file->key) & (cache->bucket_count - 1);
+
+  file->next = cache->buckets[index];
+
+  cache->buckets[index] = file;
+
+  file->references++;
+
+  cache->count++;
+}
+
+/* Drops the cache's reference, connections still sending the file keep it alive */
+static void file_cache_evict(File_Cache *cache, const char *key)
+{
+  Cached_File **link = &cache->buckets[hash(key) & (cache->bucket_count - 1)];
+
+  for (; *link != NULL; link = &(*link)->next)
+  {
+    if (strcmp((*link)->key, key) != 0)
+      continue;
+
+    Cached_File *file = *link;
+
+    *link = file->next;
+
+    cache->count--;
+
+    file_cache_release(file);
+
+    return;
+  }
+}
+
+/* Evicts every key under prefix, or everything for an empty prefix */
+static void file_cache_evict_prefix(File_Cache *cache, const char *prefix)
+{
+  size_t length = strlen(prefix);
+
+  for (size_t i = 0; i < cache->bucket_count; i++)
+  {
+    Cached_File **link = &cache->buckets[i];
+
+    while (*link != NULL)
+    {
+      Cached_File *file = *link;
+
+      if (strncmp(file->key, prefix, length) != 0)
+      {
+        link = &file->next;
+
+        continue;
+      }
+
+      *link = file->next;
+
+      cache->count--;
+
+      file_cache_release(file);
+    }
+  }
+}
+
+/*
+  A directory reached by two names, through a symlink, is one inotify
+  watch with an entry for each name, so a change evicts the keys under
+  both
+*/
+static void watch_directory(File_Cache *cache, const char *key)
+{
+  const char *slash = strrchr(key, '/');
+
+  size_t length = slash != NULL ? (size_t)(slash - key) : 0;
+
+  char path[PATH_MAX];
+
+  snprintf(path, sizeof(path), "%s/%.*s", cache->root, (int)length, key);
+
+  int wd = inotify_add_watch(cache->watcher.fd, path, WATCH_MASK);
+
+  if (wd < 0)
+    return;
+
+  for (size_t i = 0; i < cache->watch_count; i++)
+    if (cache->watches[i].wd == wd && strlen(cache->watches[i].path) == length &&
+        strncmp(cache->watches[i].path, key, length) == 0)
+      return;
+
+  if (cache->watch_count == cache->watch_capacity)
+  {
+    cache->watch_capacity = cache->watch_capacity ? cache->watch_capacity * 2 : 8;
+
+    cache->watches = realloc(cache->watches, cache->watch_capacity * sizeof(Directory_Watch));
+  }
+
+  cache->watches[cache->watch_count++] = (Directory_Watch){wd, strndup(key, length)};
+}
+
+static void forget_watch(File_Cache *cache, Directory_Watch *watch)
+{
+  free(watch->path);
+
+  *watch = cache->watches[--cache->watch_count];
+}
+
+static void watch_changed(File_Cache *cache, Directory_Watch *watch, struct inotify_event *event)
+{
+  char key[PATH_MAX];
+
+  if (event->mask & (IN_DELETE_SELF | IN_MOVE_SELF | IN_IGNORED))
+  {
+    snprintf(key, sizeof(key), "%s%s", watch->path, *watch->path ? "/" : "");
+
+    file_cache_evict_prefix(cache, key);
+
+    return;
+  }
+
+  if (event->len == 0)
+    return;
+
+  snprintf(key, sizeof(key), "%s%s%s", watch->path, *watch->path ? "/" : "", event->name);
+
+  file_cache_evict(cache, key);
+
+  if (event->mask & IN_ISDIR)
+  {
+    strncat(key, "/", sizeof(key) - strlen(key) - 1);
+
+    file_cache_evict_prefix(cache, key);
+  }
+}
+
+static void file_cache_changed(File_Cache *cache, struct inotify_event *event)
+{
+  if (event->mask & IN_Q_OVERFLOW)
+  {
+    file_cache_evict_prefix(cache, "");
+
+    return;
+  }
+
+  /*
+    A moved directory keeps its watch, which would then go on evicting
+    under the old name. It is dropped, the new name gets a watch of its own
+    when a file is loaded from there
+  */
+  if (event->mask & IN_MOVE_SELF)
+    inotify_rm_watch(cache->watcher.fd, event->wd);
+
+  bool gone = (event->mask & (IN_MOVE_SELF | IN_IGNORED)) != 0;
+
+  for (size_t i = 0; i < cache->watch_count;)
+  {
+    Directory_Watch *watch = &cache->watches[i];
+
+    if (watch->wd != event->wd)
+    {
+      i++;
+
+      continue;
+    }
+
+    watch_changed(cache, watch, event);
+
+    if (gone)
+      forget_watch(cache, watch);
+    else
+      i++;
+  }
+}
+
+static void file_cache_handle(Event_Loop *loop, Event_Watcher *watcher, uint32_t events)
+{
+  File_Cache *cache = (File_Cache *)watcher;
+
+  char buffer[16384] __attribute__((aligned(__alignof__(struct inotify_event))));
+
+  while (1)
+  {
+    ssize_t length = read(cache->watcher.fd, buffer, sizeof(buffer));
+
+    if (length <= 0)
+      return;
+
+    for (char *at = buffer; at < buffer + length;)
+    {
+      struct inotify_event *event = (struct inotify_event *)at;
+
+      file_cache_changed(cache, event);
+
+      at += sizeof(struct inotify_event) + event->len;
+    }
+  }
+}
+
+/* Opens key under the root and checks it did not resolve to somewhere outside it */
+static int open_beneath(File_Cache *cache, const char *key)
+{
+  int fd = openat(cache->root_fd, key, O_RDONLY | O_CLOEXEC);
+
+  if (fd < 0)
+    return -1;
+
+  char link[64], target[PATH_MAX];
+
+  snprintf(link, sizeof(link), "/proc/self/fd/%d", fd);
+
+  ssize_t length = readlink(link, target, sizeof(target) - 1);
+
+  size_t root_length = strlen(cache->root);
+
+  if (root_length == 1)
+    root_length = 0;
+
+  if (length < 0 || (size_t)length <= root_length || strncmp(target, cache->root, root_length) != 0 ||
+      target[root_length] != '/')
+  {
+    close(fd);
+
+    errno = EACCES;
+
+    return -1;
+  }
+
+  return fd;
+}
+
+static Cached_File *file_load(File_Cache *cache, const char *key, int *status)
+{
+  int fd = open_beneath(cache, key);
+
+  if (fd < 0)
+  {
+    /* Out of descriptors is this server's trouble, the file may well be there */
+    *status = errno == EACCES ? 403 : errno == EMFILE || errno == ENFILE ? 503 : 404;
+
+    return NULL;
+  }
+
+  struct stat info;
+
+  if (fstat(fd, &info) < 0 || !S_ISREG(info.st_mode))
+  {
+    close(fd);
+
+    *status = 404;
+
+    return NULL;
+  }
+
+  Cached_File *file = calloc(1, sizeof(Cached_File));
+
+  file->key = strdup(key);
+
+  file->fd = fd;
+
+  file->size = (size_t)info.st_size;
+
+  if (file->size > 0 && file->size <= MAP_LIMIT)
+  {
+    file->map = mmap(NULL, file->size, PROT_READ, MAP_SHARED, fd, 0);
+
+    if (file->map == MAP_FAILED)
+      file->map = NULL;
+  }
+
+  /* Only sendfile needs the fd, a worker may hold thousands of mapped entries */
+  if (file->map != NULL || file->size == 0)
+  {
+    close(fd);
+
+    file->fd = -1;
+  }
+
+  /* HTTP/1.1 keeps the connection open by default, the other one is for the last response */
+  char header[512];
+
+  int length = snprintf(header, sizeof(header),
+                        "HTTP/1.1 200 OK\r\n"
+                        "Content-Type: %s\r\n"
+                        "Content-Length: %zu\r\n"
+                        "\r\n",
+                        content_type(key), file->size);
+
+  file->header = strndup(header, length);
+
+  file->header_length = (size_t)length;
+
+  length = snprintf(header, sizeof(header),
+                    "HTTP/1.1 200 OK\r\n"
+                    "Content-Type: %s\r\n"
+                    "Content-Length: %zu\r\n"
+                    "Connection: close\r\n"
+                    "\r\n",
+                    content_type(key), file->size);
+
+  file->close_header = strndup(header, length);
+
+  file->close_header_length = (size_t)length;
+
+  file->references = 1;
+
+  return file;
+}
+
+/* Public functions */
+
+File_Cache *file_cache_create(const char *root, Event_Loop *loop)
+{
+  char *real_root = realpath(root, NULL);
+
+  if (real_root == NULL)
+    return NULL;
+
+  int root_fd = open(real_root, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+
+  int inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+
+  if (root_fd < 0 || inotify_fd < 0)
+  {
+    int error = errno;
+
+    close(root_fd);
+
+    close(inotify_fd);
+
+    free(real_root);
+
+    errno = error;
+
+    return NULL;
+  }
+
+  File_Cache *cache = calloc(1, sizeof(File_Cache));
+
+  cache->watcher = (Event_Watcher){inotify_fd, file_cache_handle};
+
+  cache->root_fd = root_fd;
+
+  cache->root = real_root;
+
+  cache->bucket_count = 64;
+
+  cache->buckets = calloc(cache->bucket_count, sizeof(Cached_File *));
+
+  if (event_loop_add(loop, &cache->watcher, EPOLLIN) < 0)
+  {
+    int error = errno;
+
+    file_cache_destroy(cache);
+
+    errno = error;
+
+    return NULL;
+  }
+
+  return cache;
+}
+
+Cached_File *file_cache_get(File_Cache *cache, const char *path, int *status)
+{
+  for (Cached_File *file = cache->buckets[hash(path) & (cache->bucket_count - 1)]; file; file = file->next)
+    if (strcmp(file->key, path) == 0)
+    {
+      file->references++;
+
+      return file;
+    }
+
+  bool keep = cache->count < MAX_ENTRIES;
+
+  /* Watched before loading, so a change in between is not missed */
+  if (keep)
+    watch_directory(cache, path);
+
+  Cached_File *file = file_load(cache, path, status);
+
+  if (file != NULL && keep)
+    file_cache_insert(cache, file);
+
+  return file;
+}
+
+void file_cache_release(Cached_File *file)
+{
+  if (--file->references == 0)
+    file_free(file);
+}
+
+void file_cache_destroy(File_Cache *cache)
+{
+  file_cache_evict_prefix(cache, "");
+
+  for (size_t i = 0; i < cache->watch_count; i++)
+    free(cache->watches[i].path);
+
+  free(cache->watches);
+
+  free(cache->buckets);
+
+  close(cache->watcher.fd);
+
+  close(cache->root_fd);
+
+  free(cache->root);
+
+  free(cache);
+}
@@ -0,0 +1,305 @@
+#include <string.h>
+#include <strings.h>
+
+#if defined(__SSE2__) && !defined(HTTP_PARSER_SCALAR)
+#include <emmintrin.h>
+#define HTTP_PARSER_SSE2
+#endif
+
+#include "http-parser.h"
+
+/* Bigger heads are refused before they end */
+#define MAX_HEAD (64 * 1024)
+
+/* Private */
+
+static int is_stop(unsigned char c, char a, char b, int allow_tab)
+{
+  return (c < 0x20 && !(allow_tab && c == '\t')) || c == 0x7f || c == (unsigned char)a || c == (unsigned char)b;
+}
+
+/*
+  First byte from p that is a or b, or a control character, which includes
+  the CR ending the line. Tabs only stop the scan when allow_tab is 0.
+  Returns end when there is none
+*/
+static const char *scan(const char *p, const char *end, char a, char b, int allow_tab)
+{
+#ifdef HTTP_PARSER_SSE2
+  const __m128i space = _mm_set1_epi8(0x20);
+
+  const __m128i del = _mm_set1_epi8(0x7f);
+
+  const __m128i tab = _mm_set1_epi8('\t');
+
+  const __m128i first = _mm_set1_epi8(a);
+
+  const __m128i second = _mm_set1_epi8(b);
+
+  const __m128i tabs = allow_tab ? tab : _mm_set1_epi8(0x20);
+
+  for (; p + 16 <= end; p += 16)
+  {
+    __m128i x = _mm_loadu_si128((const __m128i *)p);
+
+    /* max(x, 0x20) == x holds for the bytes from 0x20 up, compared unsigned */
+    __m128i printable = _mm_or_si128(_mm_cmpeq_epi8(_mm_max_epu8(x, space), x), _mm_cmpeq_epi8(x, tabs));
+
+    __m128i stops = _mm_or_si128(_mm_cmpeq_epi8(x, del), _mm_or_si128(_mm_cmpeq_epi8(x, first), _mm_cmpeq_epi8(x, second)));
+
+    int mask = _mm_movemask_epi8(stops) | (~_mm_movemask_epi8(printable) & 0xffff);
+
+    if (mask != 0)
+      return p + __builtin_ctz(mask);
+  }
+#endif
+
+  for (; p < end; p++)
+    if (is_stop((unsigned char)*p, a, b, allow_tab))
+      return p;
+
+  return end;
+}
+
+/* Index just past the blank line ending the head, or 0 when it is not in [from, length) yet */
+static size_t find_head_end(const char *data, size_t from, size_t length)
+{
+  /* The terminator may straddle the last call's bytes and the new ones */
+  size_t i = from > 3 ? from - 3 : 0;
+
+#ifdef HTTP_PARSER_SSE2
+  const __m128i newline = _mm_set1_epi8('\n');
+
+  for (; i + 16 <= length; i += 16)
+  {
+    int mask = _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)(data + i)), newline));
+
+    while (mask != 0)
+    {
+      size_t at = i + __builtin_ctz(mask);
+
+      if (at >= 3 && memcmp(data + at - 3, "\r\n\r\n", 4) == 0)
+        return at + 1;
+
+      mask &= mask - 1;
+    }
+  }
+#endif
+
+  for (; i < length; i++)
+    if (data[i] == '\n' && i >= 3 && memcmp(data + i - 3, "\r\n\r\n", 4) == 0)
+      return i + 1;
+
+  return 0;
+}
+
+static int slice_equals(const Http_Slice *slice, const char *text)
+{
+  size_t length = strlen(text);
+
+  return slice->length == length && strncasecmp(slice->data, text, length) == 0;
+}
+
+/* Whether the comma separated list in value holds token */
+static int has_token(const Http_Slice *value, const char *token)
+{
+  size_t length = strlen(token);
+
+  const char *p = value->data, *end = value->data + value->length;
+
+  while (p < end)
+  {
+    while (p < end && (*p == ' ' || *p == '\t' || *p == ','))
+      p++;
+
+    const char *start = p;
+
+    while (p < end && *p != ',')
+      p++;
+
+    const char *stop = p;
+
+    while (stop > start && (stop[-1] == ' ' || stop[-1] == '\t'))
+      stop--;
+
+    if ((size_t)(stop - start) == length && strncasecmp(start, token, length) == 0)
+      return 1;
+  }
+
+  return 0;
+}
+
+static Http_Parse_Result parse_request_line(const char **at, const char *end, Http_Request *request)
+{
+  const char *p = *at;
+
+  const char *stop = scan(p, end, ' ', ' ', 0);
+
+  if (stop == p || stop == end || *stop != ' ')
+    return HTTP_PARSE_INVALID;
+
+  request->method = (Http_Slice){p, (size_t)(stop - p)};
+
+  p = stop + 1;
+
+  stop = scan(p, end, ' ', ' ', 0);
+
+  if (stop == p || stop == end || *stop != ' ')
+    return HTTP_PARSE_INVALID;
+
+  request->target = (Http_Slice){p, (size_t)(stop - p)};
+
+  p = stop + 1;
+
+  if (end - p < 10 || memcmp(p, "HTTP/1.", 7) != 0 || (p[7] != '0' && p[7] != '1') || p[8] != '\r' || p[9] != '\n')
+    return HTTP_PARSE_INVALID;
+
+  request->minor_version = p[7] - '0';
+
+  *at = p + 10;
+
+  return HTTP_PARSE_DONE;
+}
+
+static Http_Parse_Result parse_headers(const char *p, const char *end, Http_Request *request)
+{
+  while (!(p[0] == '\r' && p[1] == '\n'))
+  {
+    if (request->header_count == HTTP_MAX_HEADERS)
+      return HTTP_PARSE_TOO_LARGE;
+
+    const char *colon = scan(p, end, ':', ' ', 0);
+
+    if (colon == p || *colon != ':')
+      return HTTP_PARSE_INVALID;
+
+    Http_Header *header = &request->headers[request->header_count++];
+
+    header->name = (Http_Slice){p, (size_t)(colon - p)};
+
+    p = colon + 1;
+
+    while (*p == ' ' || *p == '\t')
+      p++;
+
+    const char *line_end = scan(p, end, 0x7f, 0x7f, 1);
+
+    if (line_end + 1 >= end || line_end[0] != '\r' || line_end[1] != '\n')
+      return HTTP_PARSE_INVALID;
+
+    const char *value_end = line_end;
+
+    while (value_end > p && (value_end[-1] == ' ' || value_end[-1] == '\t'))
+      value_end--;
+
+    header->value = (Http_Slice){p, (size_t)(value_end - p)};
+
+    p = line_end + 2;
+  }
+
+  return HTTP_PARSE_DONE;
+}
+
+/* Fills in what the server needs to know about the body and the connection */
+static Http_Parse_Result read_known_headers(Http_Request *request)
+{
+  request->keep_alive = request->minor_version == 1;
+
+  for (size_t i = 0; i < request->header_count; i++)
+  {
+    Http_Header *header = &request->headers[i];
+
+    if (slice_equals(&header->name, "content-length"))
+    {
+      size_t length = 0;
+
+      if (header->value.length == 0 || header->value.length > 18)
+        return HTTP_PARSE_INVALID;
+
+      for (size_t j = 0; j < header->value.length; j++)
+      {
+        char c = header->value.data[j];
+
+        if (c < '0' || c > '9')
+          return HTTP_PARSE_INVALID;
+
+        length = length * 10 + (size_t)(c - '0');
+      }
+
+      request->content_length = length;
+    }
+    else if (slice_equals(&header->name, "transfer-encoding"))
+      request->chunked = 1;
+    else if (slice_equals(&header->name, "connection"))
+    {
+      if (has_token(&header->value, "close"))
+        request->keep_alive = 0;
+      else if (has_token(&header->value, "keep-alive"))
+        request->keep_alive = 1;
+    }
+  }
+
+  return HTTP_PARSE_DONE;
+}
+
+/* Public functions */
+
+void http_parser_init(Http_Parser *parser)
+{
+  parser->scanned = 0;
+}
+
+Http_Parse_Result http_parse(Http_Parser *parser, const char *data, size_t length, Http_Request *request)
+{
+  size_t head_length = find_head_end(data, parser->scanned, length);
+
+  if (head_length == 0)
+  {
+    parser->scanned = length;
+
+    if (length > MAX_HEAD)
+    {
+      parser->scanned = 0;
+
+      return HTTP_PARSE_TOO_LARGE;
+    }
+
+    return HTTP_PARSE_INCOMPLETE;
+  }
+
+  parser->scanned = 0;
+
+  if (head_length > MAX_HEAD)
+    return HTTP_PARSE_TOO_LARGE;
+
+  request->header_count = 0;
+
+  request->head_length = head_length;
+
+  request->content_length = 0;
+
+  request->chunked = 0;
+
+  const char *p = data, *end = data + head_length;
+
+  Http_Parse_Result result = parse_request_line(&p, end, request);
+
+  if (result != HTTP_PARSE_DONE)
+    return result;
+
+  result = parse_headers(p, end, request);
+
+  if (result != HTTP_PARSE_DONE)
+    return result;
+
+  return read_known_headers(request);
+}
+
+const Http_Slice *http_header(const Http_Request *request, const char *name)
+{
+  for (size_t i = 0; i < request->header_count; i++)
+    if (slice_equals(&request->headers[i].name, name))
+      return &request->headers[i].value;
+
+  return NULL;
+}
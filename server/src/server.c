@@ -1,17 +1,47 @@
+#define _GNU_SOURCE
+
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
 #include <sys/socket.h>
 #include <unistd.h>
 #include <netinet/in.h>
+#include <netinet/tcp.h>
 #include <stdint.h>
 #include <arpa/inet.h>
 #include <fcntl.h>
 #include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <signal.h>
+
+#include "arguments.h"
+#include "event-loop.h"
+#include "connection.h"
+#include "file-cache.h"
 
-#define PORT 1234
 #define MAX_LINE 4096
 
+typedef struct Listener
+{
+  Event_Watcher watcher;
+  /* Held open so a connection can still be accepted and closed when out of descriptors */
+  int spare_fd;
+  /* Set when out of descriptors, accepting waits until a connection has closed since */
+  int paused;
+  size_t paused_at;
+  Connections connections;
+} Listener;
+
+typedef struct Worker
+{
+  pthread_t thread;
+  int index;
+  int cpu;
+  Event_Loop *loop;
+  Listener listener;
+} Worker;
+
 int guard(int num, char *msg)
 {
   if (num < 0)
@@ -24,119 +54,457 @@ int guard(int num, char *msg)
   return num;
 }
 
-int main()
+void respond_status(Connection *connection, int status, int close)
 {
-  int server_socket;
+  const char *reason = status == 400   ? "Bad Request"
+                       : status == 403 ? "Forbidden"
+                       : status == 404 ? "Not Found"
+                       : status == 405 ? "Method Not Allowed"
+                       : status == 503 ? "Service Unavailable"
+                                       : "Internal Server Error";
+
+  char response[MAX_LINE];
+
+  int length = snprintf(response, sizeof(response),
+                        "HTTP/1.1 %d %s\r\n"
+                        "%s"
+                        "Content-Length: 0\r\n"
+                        "%s"
+                        "\r\n",
+                        status, reason, status == 405 ? "Allow: GET, HEAD\r\n" : "",
+                        close ? "Connection: close\r\n" : "");
+
+  connection_send(connection, response, length);
+}
 
-  struct sockaddr_in server_address;
+int hex_value(char c)
+{
+  if (c >= '0' && c <= '9')
+    return c - '0';
 
-  socklen_t server_length = sizeof(server_address);
+  if (c >= 'a' && c <= 'f')
+    return c - 'a' + 10;
 
-  server_socket = socket(AF_INET, SOCK_STREAM, 0);
+  if (c >= 'A' && c <= 'F')
+    return c - 'A' + 10;
 
-  if (server_socket < 0)
+  return -1;
+}
+
+/*
+  Turns the request target into a path relative to the document root.
+  Percent escapes are decoded, the query is dropped, empty segments are
+  skipped and a directory gets its index.html. Fails on anything that
+  could step out of the root
+*/
+int resolve_path(const char *target, size_t length, char *path, size_t size)
+{
+  if (length == 0 || target[0] != '/')
+    return 0;
+
+  size_t written = 0, segment = 0;
+
+  for (size_t i = 1; i <= length; i++)
   {
-    printf("Could not create socket");
+    char c = i < length ? target[i] : '/';
 
-    return EXIT_FAILURE;
+    if (c == '?' || c == '#')
+    {
+      c = '/';
+
+      length = i;
+    }
+    else if (c == '%')
+    {
+      int high = i + 2 < length ? hex_value(target[i + 1]) : -1;
+
+      int low = i + 2 < length ? hex_value(target[i + 2]) : -1;
+
+      if (high < 0 || low < 0 || (high == 0 && low == 0))
+        return 0;
+
+      c = (char)(high * 16 + low);
+
+      i += 2;
+    }
+
+    if (c != '/')
+    {
+      if (written + 1 >= size)
+        return 0;
+
+      path[written++] = c;
+
+      continue;
+    }
+
+    size_t segment_length = written - segment;
+
+    if ((segment_length == 1 && path[segment] == '.') ||
+        (segment_length == 2 && path[segment] == '.' && path[segment + 1] == '.'))
+      return 0;
+
+    if (segment_length > 0 && i < length)
+    {
+      if (written + 1 >= size)
+        return 0;
+
+      path[written++] = '/';
+    }
+
+    segment = written;
   }
 
-  fcntl(server_socket, F_SETFL, O_NONBLOCK);
+  const char *index = "index.html";
 
-  server_address.sin_family = AF_INET;
-  server_address.sin_addr.s_addr = htonl(INADDR_ANY);
-  server_address.sin_port = htons(PORT);
+  int directory = written == 0 || target[length - 1] == '/';
+
+  if (directory && written + strlen(index) + 1 > size)
+    return 0;
 
-  if (bind(server_socket, (struct sockaddr *)&server_address, server_length) < 0)
+  if (directory)
   {
-    printf("Could not bind to port: %d\n", PORT);
+    memcpy(path + written, index, strlen(index));
 
-    return EXIT_FAILURE;
+    written += strlen(index);
   }
 
-  if (listen(server_socket, 1) < 0)
+  path[written] = '\0';
+
+  return 1;
+}
+
+int respond(Connection *connection, const Http_Request *request)
+{
+  File_Cache *cache = connection->owner->context;
+
+  /* HTTP/1.0 keep-alive is not supported, those connections are closed */
+  int keep = request->keep_alive && request->minor_version == 1;
+
+  int head = request->method.length == 4 && memcmp(request->method.data, "HEAD", 4) == 0;
+
+  /* Other methods may have a body, which is not read, so the connection is closed */
+  if (!head && !(request->method.length == 3 && memcmp(request->method.data, "GET", 3) == 0))
   {
-    printf("Error while listening\n");
+    respond_status(connection, 405, 1);
 
-    return EXIT_FAILURE;
+    return 0;
   }
 
-  printf("Listening for connections\n\n");
+  /* Neither is a body sent with GET or HEAD */
+  if (request->content_length > 0 || request->chunked)
+  {
+    respond_status(connection, 400, 1);
 
-  while (1)
+    return 0;
+  }
+
+  char path[MAX_LINE];
+
+  if (!resolve_path(request->target.data, request->target.length, path, sizeof(path)))
   {
-    struct sockaddr_in client_address;
-    socklen_t client_length = sizeof(client_address);
+    respond_status(connection, 400, !keep);
+
+    return keep;
+  }
+
+  int status;
+
+  Cached_File *file = file_cache_get(cache, path, &status);
+
+  if (file == NULL)
+  {
+    respond_status(connection, status, !keep);
+
+    return keep;
+  }
+
+  connection_send_file(connection, file, head, !keep);
+
+  return keep;
+}
+
+void accept_connections(Event_Loop *loop, Event_Watcher *watcher, uint32_t events)
+{
+  Listener *listener = (Listener *)watcher;
 
-    char client_addr[MAX_LINE];
+  if (listener->paused)
+    return;
 
-    int client_socket = accept(server_socket, (struct sockaddr *)&client_address, &client_length);
+  /* Edge triggered, so the whole backlog is drained on every wakeup */
+  while (1)
+  {
+    int client_socket = accept4(listener->watcher.fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
 
-    if (client_socket == -1)
+    if (client_socket < 0)
     {
-      if (errno == EWOULDBLOCK || errno == EAGAIN)
-      {
-        usleep(10000);
+      if (errno == EAGAIN || errno == EWOULDBLOCK)
+        return;
 
+      if (errno == EINTR || errno == ECONNABORTED)
         continue;
+
+      /*
+        Turns the pending connection away so its client is not left hanging,
+        then stops. Accepting again before a descriptor is freed would only
+        fail again, and the loop has to get back to closing idle connections
+      */
+      if (errno == EMFILE || errno == ENFILE)
+      {
+        close(listener->spare_fd);
+
+        int rejected = accept(listener->watcher.fd, NULL, NULL);
+
+        if (rejected >= 0)
+          close(rejected);
+
+        listener->spare_fd = open("/dev/null", O_RDONLY | O_CLOEXEC);
+
+        listener->paused = 1;
+
+        listener->paused_at = listener->connections.closed;
+
+        return;
       }
 
       perror("Could not accept connection");
 
-      exit(EXIT_FAILURE);
+      return;
+    }
+
+    int one = 1;
+
+    setsockopt(client_socket, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+    Connection *connection = connection_create(&listener->connections, client_socket);
+
+    if (event_loop_add(loop, &connection->watcher, EPOLLIN | EPOLLOUT | EPOLLRDHUP) < 0)
+    {
+      perror("Could not watch connection");
+
+      connection_close(connection);
     }
+  }
+}
 
-    fcntl(client_socket, F_SETFL, O_NONBLOCK);
+/* The loop's timeout, expires idle connections and picks up the backlog again once one has closed */
+int listener_timeout(Event_Loop *loop, void *context)
+{
+  Listener *listener = context;
+
+  int timeout = connections_expire(loop, &listener->connections);
+
+  if (!listener->paused || listener->connections.closed == listener->paused_at)
+    return timeout;
+
+  listener->paused = 0;
+
+  accept_connections(loop, &listener->watcher, EPOLLIN);
+
+  /* What was accepted has to expire too */
+  return connections_expire(loop, &listener->connections);
+}
+
+/*
+  SO_REUSEPORT would let a second server on the port bind without error and
+  take half its connections. A bind without it fails while anything holds
+  the port, so this is tried once before the listeners are made
+*/
+int port_available(int port)
+{
+  int probe = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+
+  if (probe < 0)
+    return 0;
+
+  int one = 1;
+
+  setsockopt(probe, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+
+  struct sockaddr_in address = {0};
+
+  address.sin_family = AF_INET;
+  address.sin_addr.s_addr = htonl(INADDR_ANY);
+  address.sin_port = htons(port);
+
+  int available = bind(probe, (struct sockaddr *)&address, sizeof(address)) == 0;
+
+  close(probe);
+
+  return available;
+}
+
+int create_listener(int port, int backlog)
+{
+  int server_socket = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+
+  if (server_socket < 0)
+    return -1;
 
-    inet_ntop(AF_INET, &client_address, client_addr, MAX_LINE);
+  int one = 1;
 
-    printf("Client address: %s\n\n", client_addr);
+  setsockopt(server_socket, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
 
-    printf("Connection accepted\n\n");
+  /* Every worker binds its own socket to the port, the kernel spreads connections over them */
+  setsockopt(server_socket, SOL_SOCKET, SO_REUSEPORT, &one, sizeof(one));
+
+  struct sockaddr_in server_address = {0};
+
+  server_address.sin_family = AF_INET;
+  server_address.sin_addr.s_addr = htonl(INADDR_ANY);
+  server_address.sin_port = htons(port);
+
+  if (bind(server_socket, (struct sockaddr *)&server_address, sizeof(server_address)) < 0 ||
+      listen(server_socket, backlog) < 0)
+  {
+    close(server_socket);
+
+    return -1;
+  }
+
+  return server_socket;
+}
+
+/* The i-th cpu this process may run on, wrapping around */
+int worker_cpu(int index)
+{
+  cpu_set_t allowed;
+
+  if (sched_getaffinity(0, sizeof(allowed), &allowed) < 0 || CPU_COUNT(&allowed) == 0)
+    return -1;
+
+  int target = index % CPU_COUNT(&allowed);
+
+  for (int cpu = 0; cpu < CPU_SETSIZE; cpu++)
+    if (CPU_ISSET(cpu, &allowed) && target-- == 0)
+      return cpu;
+
+  return -1;
+}
+
+/* A worker shares nothing with the others, it has its own listener, loop and connections */
+void *worker_run(void *arg)
+{
+  Worker *worker = arg;
+
+  if (worker->cpu >= 0)
+  {
+    cpu_set_t set;
 
-    uint8_t request_buffer[MAX_LINE + 1];
+    CPU_ZERO(&set);
 
-    ssize_t bytes_read = recv(client_socket, request_buffer, MAX_LINE, MSG_DONTWAIT);
+    CPU_SET(worker->cpu, &set);
 
-    if (bytes_read > 0)
+    if (pthread_setaffinity_np(pthread_self(), sizeof(set), &set) != 0)
+      fprintf(stderr, "Could not pin worker %d to cpu %d\n", worker->index, worker->cpu);
+  }
+
+  event_loop_run(worker->loop);
+
+  return NULL;
+}
+
+int main(int argc, char *argv[])
+{
+  Arguments args = get_arguments(argc, argv);
+
+  /* sendfile has no MSG_NOSIGNAL, a client resetting mid file has to fail with EPIPE rather than kill the server */
+  signal(SIGPIPE, SIG_IGN);
+
+  int workers = args.workers;
+
+  if (workers <= 0)
+  {
+    long cores = sysconf(_SC_NPROCESSORS_ONLN);
+
+    workers = cores > 0 ? (int)cores : 1;
+  }
+
+  Worker *pool = calloc(workers, sizeof(Worker));
+
+  if (!port_available(args.port))
+  {
+    printf("Could not bind to port: %d\n", args.port);
+
+    return EXIT_FAILURE;
+  }
+
+  /* Listeners are all bound before any worker starts, so a failing bind stops the server before it serves anything */
+  for (int i = 0; i < workers; i++)
+  {
+    Worker *worker = &pool[i];
+
+    worker->index = i;
+
+    worker->cpu = args.pin ? worker_cpu(i) : -1;
+
+    int server_socket = create_listener(args.port, args.backlog);
+
+    if (server_socket < 0)
     {
-      uint8_t response_buffer[MAX_LINE + 1];
+      printf("Could not bind to port: %d\n", args.port);
 
-      printf("Read %lu bytes\n\n", bytes_read);
+      return EXIT_FAILURE;
+    }
 
-      printf("%s\n------\n", request_buffer);
+    worker->loop = event_loop_create();
 
-      FILE *file = fopen("../index.html", "r");
+    if (worker->loop == NULL)
+    {
+      perror("Could not create event loop");
 
-      fseek(file, 0L, SEEK_END);
+      return EXIT_FAILURE;
+    }
 
-      long size = ftell(file);
+    worker->listener.watcher = (Event_Watcher){server_socket, accept_connections};
 
-      char response[size + 1];
+    /* Each worker keeps its own cache, the mapped pages are shared through the page cache anyway */
+    File_Cache *cache = file_cache_create(args.root, worker->loop);
 
-      rewind(file);
+    if (cache == NULL)
+    {
+      fprintf(stderr, "Could not serve files from %s: %s\n", args.root, strerror(errno));
+
+      return EXIT_FAILURE;
+    }
 
-      fread(response, size, 1, file);
+    connections_init(&worker->listener.connections, (uint64_t)args.idle_timeout * 1000, respond, cache);
 
-      response[size] = '\0';
+    event_loop_set_timeout(worker->loop, listener_timeout, &worker->listener);
 
-      fclose(file);
+    worker->listener.spare_fd = guard(open("/dev/null", O_RDONLY | O_CLOEXEC), "Could not open /dev/null");
+
+    guard(event_loop_add(worker->loop, &worker->listener.watcher, EPOLLIN), "Could not watch listening socket");
+  }
 
-      snprintf((char *)response_buffer, sizeof(response_buffer),
-               "HTTP/1.1 200 OK\r\n"
-               "Content-Type: text/html\r\n"
-               "Content-Length: %lu\r\n"
-               "\r\n"
-               "%s",
-               strlen(response), response);
+  printf("Serving %s on port %d with %d workers\n\n", args.root, args.port, workers);
 
-      printf("%s\n", response);
+  fflush(stdout);
 
-      send(client_socket, (char *)response_buffer, strlen((char *)response_buffer), 0);
+  for (int i = 0; i < workers; i++)
+    if (pthread_create(&pool[i].thread, NULL, worker_run, &pool[i]) != 0)
+    {
+      perror("Could not start worker");
+
+      return EXIT_FAILURE;
     }
 
-    fflush(stdout);
+  for (int i = 0; i < workers; i++)
+  {
+    pthread_join(pool[i].thread, NULL);
+
+    connections_close_all(&pool[i].listener.connections);
+
+    file_cache_destroy(pool[i].listener.connections.context);
 
-    close(client_socket);
+    event_loop_destroy(pool[i].loop);
+
+    close(pool[i].listener.watcher.fd);
+
+    close(pool[i].listener.spare_fd);
   }
-}
\ No newline at end of file
+
+  free(pool);
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,141 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#include "stack.h"
+#include "lock-free-stack.h"
+#include "bench.h"
+
+/*
+  Work items handed between threads: every thread pushes an item and pops
+  one, over and over, on one shared stack that starts half full. The lock
+  free stack against Stack behind a mutex, from 1 to N threads.
+
+  usage: bench-lock-free [operations per thread] [max threads]
+*/
+
+#define PREFILL 1024
+
+typedef struct Worker
+{
+  pthread_t thread;
+  size_t operations;
+  Lock_Free_Stack *lock_free;
+  Stack *stack;
+  pthread_mutex_t *lock;
+  size_t misses;
+} Worker;
+
+static void *lock_free_worker(void *arg)
+{
+  Worker *w = arg;
+
+  for (size_t i = 0; i < w->operations; i++)
+  {
+    void *item;
+
+    lock_free_stack_push(w->lock_free, (void *)(uintptr_t)(i + 1));
+
+    if (!lock_free_stack_pop(w->lock_free, &item))
+      w->misses++;
+  }
+
+  return NULL;
+}
+
+static void *locked_worker(void *arg)
+{
+  Worker *w = arg;
+
+  for (size_t i = 0; i < w->operations; i++)
+  {
+    pthread_mutex_lock(w->lock);
+
+    stack_push(w->stack, (void *)(uintptr_t)(i + 1));
+
+    pthread_mutex_unlock(w->lock);
+
+    pthread_mutex_lock(w->lock);
+
+    if (stack_pop(w->stack) == NULL)
+      w->misses++;
+
+    pthread_mutex_unlock(w->lock);
+  }
+
+  return NULL;
+}
+
+static uint64_t run_workers(Worker *workers, uint32_t threads, void *(*body)(void *))
+{
+  uint64_t start = bench_now();
+
+  for (uint32_t i = 0; i < threads; i++)
+    pthread_create(&workers[i].thread, NULL, body, &workers[i]);
+
+  for (uint32_t i = 0; i < threads; i++)
+    pthread_join(workers[i].thread, NULL);
+
+  return bench_now() - start;
+}
+
+static void run(uint32_t threads, size_t operations)
+{
+  Worker *workers = calloc(threads, sizeof(Worker));
+
+  Lock_Free_Stack *lock_free = lock_free_stack_create(PREFILL * 2 + threads);
+
+  Stack *stack = stack_create(PREFILL * 2 + threads);
+
+  pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+
+  for (size_t i = 0; i < PREFILL; i++)
+  {
+    lock_free_stack_push(lock_free, (void *)(uintptr_t)(i + 1));
+
+    stack_push(stack, (void *)(uintptr_t)(i + 1));
+  }
+
+  for (uint32_t i = 0; i < threads; i++)
+    workers[i] = (Worker){.operations = operations, .lock_free = lock_free, .stack = stack, .lock = &lock};
+
+  uint64_t lock_free_ns = run_workers(workers, threads, lock_free_worker);
+
+  uint64_t locked_ns = run_workers(workers, threads, locked_worker);
+
+  size_t misses = 0;
+
+  for (uint32_t i = 0; i < threads; i++)
+    misses += workers[i].misses;
+
+  /* A push and a pop per operation */
+  size_t total = threads * operations * 2;
+
+  printf("%7u %16.2f %16.2f %8zu\n", threads, total / (lock_free_ns / 1000.0), total / (locked_ns / 1000.0), misses);
+
+  lock_free_stack_destroy(lock_free);
+
+  stack_destroy(stack);
+
+  free(workers);
+}
+
+int main(int argc, char *argv[])
+{
+  size_t operations = argc > 1 ? (size_t)atol(argv[1]) : 2000000;
+
+  long cores = sysconf(_SC_NPROCESSORS_ONLN);
+
+  uint32_t max_threads = argc > 2 ? (uint32_t)atoi(argv[2]) : (uint32_t)(cores > 4 ? cores : 4);
+
+  printf("%zu push/pop pairs per thread\n\n", operations);
+
+  printf("%7s %16s %16s %8s\n", "threads", "lock free Mops/s", "mutex Mops/s", "misses");
+
+  for (uint32_t threads = 1; threads <= max_threads; threads *= 2)
+    run(threads, operations);
+
+  return 0;
+}
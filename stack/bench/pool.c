@@ -0,0 +1,137 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include <unistd.h>
+
+#include "pool.h"
+#include "bench.h"
+
+/*
+  Two unbalanced loads on the pool, from 1 to N threads, against running
+  them on the calling thread. Tree is a fibonacci shaped tree of tasks,
+  every node spawns its two subtrees, one much smaller than the other, and
+  the leaves do a little work. Range is a parallel for whose cost per index
+  grows with the index, so equal halves are far from equal work.
+
+  usage: bench-pool [tree depth] [range] [max threads]
+*/
+
+#define LEAF_WORK 2000
+
+static Pool *tree_pool;
+
+static _Atomic uint64_t tree_sum;
+
+static uint64_t work(uint64_t seed, size_t rounds)
+{
+  uint64_t x = seed | 1;
+
+  for (size_t i = 0; i < rounds; i++)
+    x = x * 6364136223846793005ULL + 1442695040888963407ULL;
+
+  return x >> 60;
+}
+
+static uint64_t tree_serial(size_t n)
+{
+  if (n < 2)
+    return work(n, LEAF_WORK);
+
+  return tree_serial(n - 1) + tree_serial(n - 2);
+}
+
+static void tree_task(void *arg)
+{
+  size_t n = (size_t)(uintptr_t)arg;
+
+  /* Spawns the bigger subtree and walks down the smaller ones itself */
+  while (n >= 2)
+  {
+    pool_submit(tree_pool, tree_task, (void *)(uintptr_t)(n - 1));
+
+    n -= 2;
+  }
+
+  atomic_fetch_add_explicit(&tree_sum, work(n, LEAF_WORK), memory_order_relaxed);
+}
+
+static void range_body(void *ctx, size_t begin, size_t end)
+{
+  uint64_t sum = 0;
+
+  for (size_t i = begin; i < end; i++)
+    sum += work(i, i / 4);
+
+  atomic_fetch_add_explicit((_Atomic uint64_t *)ctx, sum, memory_order_relaxed);
+}
+
+static void report(const char *name, uint32_t threads, uint64_t elapsed, uint64_t serial, bool ok)
+{
+  printf("%-6s %7u %10.2f %8.2fx %s\n", name, threads, elapsed / 1e6, (double)serial / elapsed, ok ? "ok" : "wrong result");
+}
+
+int main(int argc, char *argv[])
+{
+  size_t depth = argc > 1 ? (size_t)atol(argv[1]) : 22;
+
+  size_t range = argc > 2 ? (size_t)atol(argv[2]) : 20000;
+
+  long cores = sysconf(_SC_NPROCESSORS_ONLN);
+
+  uint32_t max_threads = argc > 3 ? (uint32_t)atoi(argv[3]) : (uint32_t)(cores > 0 ? cores : 4);
+
+  uint64_t start = bench_now();
+
+  uint64_t tree_expected = tree_serial(depth);
+
+  uint64_t tree_serial_ns = bench_now() - start;
+
+  _Atomic uint64_t range_sum = 0;
+
+  start = bench_now();
+
+  range_body(&range_sum, 0, range);
+
+  uint64_t range_expected = range_sum;
+
+  uint64_t range_serial_ns = bench_now() - start;
+
+  printf("tree depth %zu, range %zu\n\n", depth, range);
+
+  printf("%-6s %7s %10s %9s\n", "", "threads", "ms", "speedup");
+
+  printf("%-6s %7s %10.2f\n", "tree", "serial", tree_serial_ns / 1e6);
+
+  printf("%-6s %7s %10.2f\n", "range", "serial", range_serial_ns / 1e6);
+
+  for (uint32_t threads = 1; threads <= max_threads; threads *= 2)
+  {
+    Pool *pool = pool_create(threads);
+
+    tree_pool = pool;
+
+    atomic_store(&tree_sum, 0);
+
+    start = bench_now();
+
+    pool_submit(pool, tree_task, (void *)(uintptr_t)depth);
+
+    pool_wait(pool);
+
+    report("tree", threads, bench_now() - start, tree_serial_ns, atomic_load(&tree_sum) == tree_expected);
+
+    atomic_store(&range_sum, 0);
+
+    start = bench_now();
+
+    pool_parallel_for(pool, 0, range, 0, range_body, &range_sum);
+
+    report("range", threads, bench_now() - start, range_serial_ns, atomic_load(&range_sum) == range_expected);
+
+    pool_destroy(pool);
+  }
+
+  return 0;
+}
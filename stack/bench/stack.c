@@ -0,0 +1,131 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+
+#include "stack.h"
+#include "typed-stack.h"
+#include "bench.h"
+
+/*
+  Push and pop throughput of the void * Stack against the generated
+  Stack_int64_t. Deep pushes a long run of values and pops them all,
+  starting from a small stack so growth is part of it. Short lived creates
+  a stack, pushes a few values, pops them and throws it away, which for the
+  typed stack stays in its inline buffer.
+
+  usage: bench-stack [values] [rounds]
+*/
+
+STACK_DEFINE(int64_t)
+
+static void report(const char *name, size_t ops, uint64_t elapsed, int64_t sum)
+{
+  printf("%-28s %10.1f %8.2f   (sum %lld)\n", name, ops / (elapsed / 1000.0), (double)elapsed / ops, (long long)sum);
+}
+
+static void deep(size_t values, size_t rounds)
+{
+  int64_t sum = 0;
+
+  uint64_t start = bench_now();
+
+  for (size_t r = 0; r < rounds; r++)
+  {
+    Stack *stack = stack_create(16);
+
+    for (size_t i = 0; i < values; i++)
+      stack_push(stack, (void *)(intptr_t)i);
+
+    for (size_t i = 0; i < values; i++)
+      sum += (intptr_t)stack_pop(stack);
+
+    stack_destroy(stack);
+  }
+
+  report("deep Stack", values * rounds * 2, bench_now() - start, sum);
+
+  sum = 0;
+
+  start = bench_now();
+
+  for (size_t r = 0; r < rounds; r++)
+  {
+    Stack_int64_t stack;
+
+    stack_int64_t_init(&stack);
+
+    for (size_t i = 0; i < values; i++)
+      stack_int64_t_push(&stack, (int64_t)i);
+
+    int64_t value;
+
+    while (stack_int64_t_pop(&stack, &value))
+      sum += value;
+
+    stack_int64_t_destroy(&stack);
+  }
+
+  report("deep Stack_int64_t", values * rounds * 2, bench_now() - start, sum);
+}
+
+static void short_lived(size_t stacks, size_t depth)
+{
+  int64_t sum = 0;
+
+  uint64_t start = bench_now();
+
+  for (size_t s = 0; s < stacks; s++)
+  {
+    Stack *stack = stack_create(STACK_INLINE_CAPACITY);
+
+    for (size_t i = 0; i < depth; i++)
+      stack_push(stack, (void *)(intptr_t)(s + i));
+
+    for (size_t i = 0; i < depth; i++)
+      sum += (intptr_t)stack_pop(stack);
+
+    stack_destroy(stack);
+  }
+
+  report("short lived Stack", stacks * depth * 2, bench_now() - start, sum);
+
+  sum = 0;
+
+  start = bench_now();
+
+  for (size_t s = 0; s < stacks; s++)
+  {
+    Stack_int64_t stack;
+
+    stack_int64_t_init(&stack);
+
+    for (size_t i = 0; i < depth; i++)
+      stack_int64_t_push(&stack, (int64_t)(s + i));
+
+    int64_t value;
+
+    while (stack_int64_t_pop(&stack, &value))
+      sum += value;
+
+    stack_int64_t_destroy(&stack);
+  }
+
+  report("short lived Stack_int64_t", stacks * depth * 2, bench_now() - start, sum);
+}
+
+int main(int argc, char *argv[])
+{
+  size_t values = argc > 1 ? (size_t)atol(argv[1]) : 1000000;
+
+  size_t rounds = argc > 2 ? (size_t)atol(argv[2]) : 50;
+
+  printf("%zu values, %zu rounds\n\n", values, rounds);
+
+  printf("%-28s %10s %8s\n", "", "Mops/s", "ns/op");
+
+  deep(values, rounds);
+
+  short_lived(values * rounds / 8, 8);
+
+  return 0;
+}
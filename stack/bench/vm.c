@@ -0,0 +1,279 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+
+#include "vm.h"
+#include "bench.h"
+
+/*
+  Loop heavy bytecode on the vm: a counted loop doing arithmetic on two
+  locals, recursive fibonacci through CALL and RET, and counting primes by
+  trial division. Reports instructions per second for each.
+
+  usage: bench-vm [scale]
+*/
+
+#define MAX_CODE 64
+
+typedef struct Program
+{
+  const char *name;
+  Instruction code[MAX_CODE];
+  size_t count;
+  int64_t expected;
+} Program;
+
+static size_t emit(Program *p, Instruction_Type type, int64_t operand)
+{
+  p->code[p->count] = (Instruction){operand, type};
+
+  return p->count++;
+}
+
+/* Points the jump at index to the next instruction emitted */
+static void patch(Program *p, size_t index)
+{
+  p->code[index].operand = (int64_t)p->count;
+}
+
+/* acc += i * i % 7 for i = n down to 1 */
+static void build_loop(Program *p, int64_t n)
+{
+  p->name = "loop";
+
+  emit(p, INST_PUSH, 0);
+
+  emit(p, INST_PUSH, n);
+
+  size_t top = emit(p, INST_LOAD, 1);
+
+  size_t done = emit(p, INST_JUMP_IF_ZERO, 0);
+
+  emit(p, INST_LOAD, 0);
+
+  emit(p, INST_LOAD, 1);
+
+  emit(p, INST_DUP, 0);
+
+  emit(p, INST_MULT, 0);
+
+  emit(p, INST_PUSH, 7);
+
+  emit(p, INST_MOD, 0);
+
+  emit(p, INST_PLUS, 0);
+
+  emit(p, INST_STORE, 0);
+
+  emit(p, INST_LOAD, 1);
+
+  emit(p, INST_PUSH, 1);
+
+  emit(p, INST_MINUS, 0);
+
+  emit(p, INST_STORE, 1);
+
+  emit(p, INST_JUMP, (int64_t)top);
+
+  patch(p, done);
+
+  emit(p, INST_LOAD, 0);
+
+  emit(p, INST_HALT, 0);
+
+  p->expected = 0;
+
+  for (int64_t i = n; i > 0; i--)
+    p->expected += i * i % 7;
+}
+
+static int64_t fib(int64_t n)
+{
+  return n < 2 ? n : fib(n - 1) + fib(n - 2);
+}
+
+static void build_fib(Program *p, int64_t n)
+{
+  p->name = "fib";
+
+  emit(p, INST_PUSH, n);
+
+  size_t call = emit(p, INST_CALL, 0);
+
+  emit(p, INST_HALT, 0);
+
+  size_t start = p->count;
+
+  p->code[call].operand = (int64_t)start;
+
+  emit(p, INST_LOAD, -1);
+
+  emit(p, INST_PUSH, 2);
+
+  emit(p, INST_LT, 0);
+
+  size_t recurse = emit(p, INST_JUMP_IF_ZERO, 0);
+
+  emit(p, INST_LOAD, -1);
+
+  emit(p, INST_RET, 1);
+
+  patch(p, recurse);
+
+  emit(p, INST_LOAD, -1);
+
+  emit(p, INST_PUSH, 1);
+
+  emit(p, INST_MINUS, 0);
+
+  emit(p, INST_CALL, (int64_t)start);
+
+  emit(p, INST_LOAD, -1);
+
+  emit(p, INST_PUSH, 2);
+
+  emit(p, INST_MINUS, 0);
+
+  emit(p, INST_CALL, (int64_t)start);
+
+  emit(p, INST_PLUS, 0);
+
+  emit(p, INST_RET, 1);
+
+  p->expected = fib(n);
+}
+
+/* Locals: count, n and the divisor d */
+static void build_primes(Program *p, int64_t limit)
+{
+  p->name = "primes";
+
+  emit(p, INST_PUSH, 0);
+
+  emit(p, INST_PUSH, 2);
+
+  emit(p, INST_PUSH, 0);
+
+  size_t outer = emit(p, INST_LOAD, 1);
+
+  emit(p, INST_PUSH, limit);
+
+  emit(p, INST_LT, 0);
+
+  size_t end = emit(p, INST_JUMP_IF_ZERO, 0);
+
+  emit(p, INST_PUSH, 2);
+
+  emit(p, INST_STORE, 2);
+
+  size_t inner = emit(p, INST_LOAD, 2);
+
+  emit(p, INST_DUP, 0);
+
+  emit(p, INST_MULT, 0);
+
+  emit(p, INST_LOAD, 1);
+
+  emit(p, INST_GT, 0);
+
+  size_t prime = emit(p, INST_JUMP_IF_NOT_ZERO, 0);
+
+  emit(p, INST_LOAD, 1);
+
+  emit(p, INST_LOAD, 2);
+
+  emit(p, INST_MOD, 0);
+
+  size_t composite = emit(p, INST_JUMP_IF_ZERO, 0);
+
+  emit(p, INST_LOAD, 2);
+
+  emit(p, INST_PUSH, 1);
+
+  emit(p, INST_PLUS, 0);
+
+  emit(p, INST_STORE, 2);
+
+  emit(p, INST_JUMP, (int64_t)inner);
+
+  patch(p, prime);
+
+  emit(p, INST_LOAD, 0);
+
+  emit(p, INST_PUSH, 1);
+
+  emit(p, INST_PLUS, 0);
+
+  emit(p, INST_STORE, 0);
+
+  patch(p, composite);
+
+  emit(p, INST_LOAD, 1);
+
+  emit(p, INST_PUSH, 1);
+
+  emit(p, INST_PLUS, 0);
+
+  emit(p, INST_STORE, 1);
+
+  emit(p, INST_JUMP, (int64_t)outer);
+
+  patch(p, end);
+
+  emit(p, INST_LOAD, 0);
+
+  emit(p, INST_HALT, 0);
+
+  p->expected = 0;
+
+  for (int64_t n = 2; n < limit; n++)
+  {
+    int64_t d = 2;
+
+    while (d * d <= n && n % d != 0)
+      d++;
+
+    p->expected += d * d > n;
+  }
+}
+
+static void run(Vm *vm, const Program *p)
+{
+  uint64_t start = bench_now();
+
+  Vm_Status status = vm_run(vm, p->code, p->count);
+
+  uint64_t elapsed = bench_now() - start;
+
+  uint64_t executed = vm_executed(vm);
+
+  printf("%-8s %12llu %10.1f %10.2f %s\n", p->name, (unsigned long long)executed, executed / (elapsed / 1000.0),
+         (double)elapsed / executed, status != VM_OK ? vm_status_name(status) : vm_result(vm) == p->expected ? "ok" : "wrong result");
+}
+
+int main(int argc, char *argv[])
+{
+  int64_t scale = argc > 1 ? atoll(argv[1]) : 1;
+
+  Program loop = {0}, fibonacci = {0}, primes = {0};
+
+  build_loop(&loop, 10000000 * scale);
+
+  build_fib(&fibonacci, 27 + (scale > 1 ? scale / 2 : 0));
+
+  build_primes(&primes, 300000 * scale);
+
+  Vm *vm = vm_create();
+
+  printf("%-8s %12s %10s %10s\n", "program", "instructions", "Minst/s", "ns/inst");
+
+  run(vm, &loop);
+
+  run(vm, &fibonacci);
+
+  run(vm, &primes);
+
+  vm_destroy(vm);
+
+  return 0;
+}
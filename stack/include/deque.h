@@ -0,0 +1,42 @@
+#ifndef DEQUE_H
+#define DEQUE_H
+
+#include <stdlib.h>
+#include <stdbool.h>
+
+/*
+  A Chase-Lev work stealing deque. One owner thread pushes and pops at the
+  bottom, last in first out, while any other thread steals the oldest
+  value from the top. The owner only pays for an atomic operation when it
+  races a thief for the last value. The buffer grows when full; the
+  old buffers are kept until destroy, since a thief may still be reading
+  from one
+*/
+
+typedef enum
+{
+  DEQUE_OK,
+  DEQUE_EMPTY,
+  /* Lost a race with another thief or the owner, worth retrying */
+  DEQUE_ABORT
+} Deque_Result;
+
+typedef struct Deque Deque;
+
+Deque *deque_create(size_t capacity);
+
+/* Owner only */
+void deque_push(Deque *deque, void *value);
+
+/* Owner only, returns false when the deque is empty */
+bool deque_pop(Deque *deque, void **value);
+
+/* Any thread */
+Deque_Result deque_steal(Deque *deque, void **value);
+
+/* A snapshot, may be stale by the time it returns */
+size_t deque_count(Deque *deque);
+
+void deque_destroy(Deque *deque);
+
+#endif
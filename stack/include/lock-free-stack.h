@@ -0,0 +1,36 @@
+#ifndef LOCK_FREE_STACK_H
+#define LOCK_FREE_STACK_H
+
+#include <stdlib.h>
+#include <stdbool.h>
+
+/*
+  A Treiber stack that many threads can push to and pop from without a
+  lock. Nodes come from a pool allocated up front and are recycled through
+  a second lock free stack, so memory a thread may still be reading is
+  never freed. The heads are a node index and a tag that changes on every
+  update, so a compare and swap fails when the head was popped and pushed
+  back in between (ABA).
+
+  When a compare and swap loses under contention, a push and a pop meet in
+  an elimination array and hand the value over directly instead of
+  retrying on the head
+*/
+
+#define LOCK_FREE_STACK_ELIMINATION_SLOTS 16
+
+typedef struct Lock_Free_Stack Lock_Free_Stack;
+
+/* Holds at most capacity values at a time, capacity is below 2^32 - 1 */
+Lock_Free_Stack *lock_free_stack_create(size_t capacity);
+
+/* Returns false when the stack is full */
+bool lock_free_stack_push(Lock_Free_Stack *stack, void *value);
+
+/* Returns false when the stack is empty */
+bool lock_free_stack_pop(Lock_Free_Stack *stack, void **value);
+
+/* Not safe while other threads still use the stack */
+void lock_free_stack_destroy(Lock_Free_Stack *stack);
+
+#endif
@@ -0,0 +1,48 @@
+#ifndef POOL_H
+#define POOL_H
+
+#include <stdlib.h>
+
+/*
+  A thread pool with a work stealing deque per worker. A task submitted
+  from inside another task goes to the bottom of its worker's deque and
+  is the next one that worker runs, so a tree of tasks is walked depth
+  first with the data still in cache. Idle workers steal the oldest task,
+  usually the biggest subtree, from the top of a random other deque.
+  Tasks submitted from outside the pool go through a shared queue
+*/
+
+typedef void (*Pool_Task)(void *arg);
+
+/* Runs body over [begin, end), one chunk at a time */
+typedef void (*Pool_Range)(void *ctx, size_t begin, size_t end);
+
+typedef struct Pool Pool;
+
+/* One worker per core for 0 threads */
+Pool *pool_create(size_t threads);
+
+size_t pool_threads(Pool *pool);
+
+void pool_submit(Pool *pool, Pool_Task task, void *arg);
+
+/*
+  Blocks until every submitted task, including the ones they submit in
+  turn, has run. The calling thread runs tasks while it waits. Not to be
+  called from inside a task, which would wait for itself
+*/
+void pool_wait(Pool *pool);
+
+/*
+  Calls body on chunks of at most grain indexes covering [begin, end) and
+  returns once all of them have run. The range is split in halves, so
+  idle workers steal big pieces and the caller keeps splitting the rest.
+  A grain of 0 picks one that makes a few chunks per worker. Can be called
+  from inside a task
+*/
+void pool_parallel_for(Pool *pool, size_t begin, size_t end, size_t grain, Pool_Range body, void *ctx);
+
+/* Waits for the submitted tasks, then stops the workers */
+void pool_destroy(Pool *pool);
+
+#endif
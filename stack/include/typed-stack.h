@@ -0,0 +1,134 @@
+#ifndef TYPED_STACK_H
+#define TYPED_STACK_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+  Stacks generated for one value type:
+
+    STACK_DEFINE(int64_t)
+
+  defines Stack_int64_t with stack_int64_t_push, stack_int64_t_pop and
+  friends. Values sit inline in one contiguous buffer. The first
+  STACK_INLINE_CAPACITY of them live inside the struct itself, so a short
+  lived stack declared as a local never touches the heap. Past that the
+  buffer moves to the heap and doubles with realloc.
+
+  STACK_DEFINE_NAMED(Name, prefix, T, inline_capacity) picks the names and
+  the inline capacity, for types that are not a single identifier such as
+  pointers. The buffer can point into the struct, so a stack must not be
+  copied by value once it is in use
+*/
+
+#define STACK_INLINE_CAPACITY 16
+
+/* Elsewhere grow is left to the compiler to inline or not */
+#if defined(__GNUC__)
+#define STACK_OUT_OF_LINE __attribute__((noinline, unused))
+#else
+#define STACK_OUT_OF_LINE inline
+#endif
+
+#define STACK_DEFINE(T) STACK_DEFINE_NAMED(Stack_##T, stack_##T, T, STACK_INLINE_CAPACITY)
+
+#define STACK_DEFINE_NAMED(Name, prefix, T, inline_capacity)                          \
+                                                                                       \
+  typedef struct Name                                                                  \
+  {                                                                                    \
+    T *values;                                                                         \
+    size_t count;                                                                      \
+    size_t capacity;                                                                   \
+    T inline_values[inline_capacity];                                                  \
+  } Name;                                                                              \
+                                                                                       \
+  static inline void prefix##_init(Name *stack)                                        \
+  {                                                                                    \
+    stack->values = stack->inline_values;                                              \
+                                                                                       \
+    stack->count = 0;                                                                  \
+                                                                                       \
+    stack->capacity = inline_capacity;                                                 \
+  }                                                                                    \
+                                                                                       \
+  /* Frees the heap buffer, if any, not the stack itself */                           \
+  static inline void prefix##_destroy(Name *stack)                                     \
+  {                                                                                    \
+    if (stack->values != stack->inline_values)                                         \
+      free(stack->values);                                                             \
+                                                                                       \
+    prefix##_init(stack);                                                              \
+  }                                                                                    \
+                                                                                       \
+  static inline bool prefix##_is_inline(const Name *stack)                             \
+  {                                                                                    \
+    return stack->values == stack->inline_values;                                      \
+  }                                                                                    \
+                                                                                       \
+  static inline void prefix##_reserve(Name *stack, size_t capacity)                    \
+  {                                                                                    \
+    if (capacity <= stack->capacity)                                                   \
+      return;                                                                          \
+                                                                                       \
+    if (prefix##_is_inline(stack))                                                     \
+    {                                                                                  \
+      T *values = malloc(sizeof(T) * capacity);                                        \
+                                                                                       \
+      memcpy(values, stack->inline_values, sizeof(T) * stack->count);                  \
+                                                                                       \
+      stack->values = values;                                                          \
+    }                                                                                  \
+    else                                                                               \
+      stack->values = realloc(stack->values, sizeof(T) * capacity);                    \
+                                                                                       \
+    stack->capacity = capacity;                                                        \
+  }                                                                                    \
+                                                                                       \
+  /* Kept out of line so push inlines to a compare and a store */                     \
+  static STACK_OUT_OF_LINE void prefix##_grow(Name *stack)                            \
+  {                                                                                    \
+    prefix##_reserve(stack, stack->capacity ? stack->capacity * 2 : 16);               \
+  }                                                                                    \
+                                                                                       \
+  static inline void prefix##_push(Name *stack, T value)                               \
+  {                                                                                    \
+    if (stack->count == stack->capacity)                                               \
+      prefix##_grow(stack);                                                            \
+                                                                                       \
+    stack->values[stack->count++] = value;                                             \
+  }                                                                                    \
+                                                                                       \
+  /* Returns false when the stack is empty */                                         \
+  static inline bool prefix##_pop(Name *stack, T *value)                               \
+  {                                                                                    \
+    if (stack->count == 0)                                                             \
+      return false;                                                                    \
+                                                                                       \
+    *value = stack->values[--stack->count];                                            \
+                                                                                       \
+    return true;                                                                       \
+  }                                                                                    \
+                                                                                       \
+  /* Top of the stack, NULL when it is empty */                                       \
+  static inline T *prefix##_peek(Name *stack)                                          \
+  {                                                                                    \
+    if (stack->count == 0)                                                             \
+      return NULL;                                                                     \
+                                                                                       \
+    return &stack->values[stack->count - 1];                                           \
+  }                                                                                    \
+                                                                                       \
+  static inline size_t prefix##_count(const Name *stack)                               \
+  {                                                                                    \
+    return stack->count;                                                               \
+  }                                                                                    \
+                                                                                       \
+  /* Empties the stack and keeps its buffer */                                        \
+  static inline void prefix##_clear(Name *stack)                                       \
+  {                                                                                    \
+    stack->count = 0;                                                                  \
+  }
+
+#endif
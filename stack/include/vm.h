@@ -0,0 +1,99 @@
+#ifndef VM_H
+#define VM_H
+
+#include <stdlib.h>
+#include <stdint.h>
+
+/* Operand stack slots and call depth, both fixed */
+#define VM_STACK_SIZE 1024
+#define VM_CALL_DEPTH 256
+
+/*
+  Instructions of the stack machine. Values are int64_t, comparisons push
+  1 or 0 and jumps test for 0. Operands are immediates for PUSH, code
+  indexes for the jumps and CALL, slots relative to the frame for LOAD and
+  STORE and the argument count for RET. NOT is logical, AND, OR and XOR
+  are bitwise.
+
+  CALL saves the return address and the frame and starts a new frame at
+  the top of the stack, so the arguments pushed before it are LOAD -1 for
+  the last one, -2 for the one before and so on, and locals pushed after
+  it are LOAD 0, 1, ... RET n pops the result, drops the frame and n
+  arguments and pushes the result back.
+*/
+typedef enum
+{
+  INST_PUSH,
+  INST_PLUS,
+  INST_MINUS,
+  INST_MULT,
+  INST_DIV,
+  INST_MOD,
+  INST_NEG,
+  INST_AND,
+  INST_OR,
+  INST_XOR,
+  INST_NOT,
+  INST_SHL,
+  INST_SHR,
+  INST_EQ,
+  INST_NE,
+  INST_LT,
+  INST_LE,
+  INST_GT,
+  INST_GE,
+  INST_POP,
+  INST_DUP,
+  INST_SWAP,
+  INST_OVER,
+  INST_LOAD,
+  INST_STORE,
+  INST_JUMP,
+  INST_JUMP_IF_ZERO,
+  INST_JUMP_IF_NOT_ZERO,
+  INST_CALL,
+  INST_RET,
+  INST_PRINT,
+  INST_HALT,
+  INST_COUNT
+} Instruction_Type;
+
+typedef struct Instruction
+{
+  int64_t operand;
+  Instruction_Type type;
+} Instruction;
+
+typedef enum
+{
+  VM_OK,
+  VM_STACK_OVERFLOW,
+  VM_STACK_UNDERFLOW,
+  VM_CALL_OVERFLOW,
+  VM_DIVISION_BY_ZERO,
+  VM_BAD_INSTRUCTION,
+  VM_BAD_JUMP,
+  VM_BAD_SLOT
+} Vm_Status;
+
+typedef struct Vm Vm;
+
+Vm *vm_create(void);
+
+/*
+  Runs code until HALT or until it runs off its end. A program starts with
+  an empty stack and frame 0 at the bottom of it
+*/
+Vm_Status vm_run(Vm *vm, const Instruction *code, size_t count);
+
+/* Top of the stack after a run, 0 when it is empty */
+int64_t vm_result(Vm *vm);
+
+/* Instructions executed by the last run */
+uint64_t vm_executed(Vm *vm);
+
+const char *vm_status_name(Vm_Status status);
+
+void vm_destroy(Vm *vm);
+
+#endif
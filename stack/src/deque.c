@@ -0,0 +1,178 @@
+#include <stdint.h>
+#include <stdatomic.h>
+
+#include "deque.h"
+
+#define CACHE_LINE 64
+
+typedef struct Deque_Array
+{
+  size_t size;
+  struct Deque_Array *previous;
+  _Atomic(void *) values[];
+} Deque_Array;
+
+/*
+  top and bottom only grow, indexes into the buffer are taken modulo its
+  size. They sit on their own cache lines since thieves hammer top while
+  the owner moves bottom
+*/
+struct Deque
+{
+  _Alignas(CACHE_LINE) _Atomic int64_t top;
+  _Alignas(CACHE_LINE) _Atomic int64_t bottom;
+  _Atomic(Deque_Array *) array;
+};
+
+/* Private */
+
+static Deque_Array *deque_array_create(size_t size)
+{
+  Deque_Array *array = malloc(sizeof(Deque_Array) + sizeof(void *) * size);
+
+  array->size = size;
+
+  array->previous = NULL;
+
+  return array;
+}
+
+static _Atomic(void *) *deque_slot(Deque_Array *array, int64_t index)
+{
+  return &array->values[(size_t)index & (array->size - 1)];
+}
+
+static Deque_Array *deque_grow(Deque *deque, Deque_Array *array, int64_t top, int64_t bottom)
+{
+  Deque_Array *bigger = deque_array_create(array->size * 2);
+
+  for (int64_t i = top; i < bottom; i++)
+    atomic_store_explicit(deque_slot(bigger, i), atomic_load_explicit(deque_slot(array, i), memory_order_relaxed),
+                          memory_order_relaxed);
+
+  bigger->previous = array;
+
+  atomic_store_explicit(&deque->array, bigger, memory_order_release);
+
+  return bigger;
+}
+
+/* Public functions */
+
+void deque_push(Deque *deque, void *value)
+{
+  int64_t bottom = atomic_load_explicit(&deque->bottom, memory_order_relaxed);
+
+  int64_t top = atomic_load_explicit(&deque->top, memory_order_acquire);
+
+  Deque_Array *array = atomic_load_explicit(&deque->array, memory_order_relaxed);
+
+  if (bottom - top > (int64_t)array->size - 1)
+    array = deque_grow(deque, array, top, bottom);
+
+  atomic_store_explicit(deque_slot(array, bottom), value, memory_order_relaxed);
+
+  /* Publishes the value to a thief that reads the new bottom */
+  atomic_store_explicit(&deque->bottom, bottom + 1, memory_order_release);
+}
+
+bool deque_pop(Deque *deque, void **value)
+{
+  int64_t bottom = atomic_load_explicit(&deque->bottom, memory_order_relaxed) - 1;
+
+  Deque_Array *array = atomic_load_explicit(&deque->array, memory_order_relaxed);
+
+  atomic_store_explicit(&deque->bottom, bottom, memory_order_relaxed);
+
+  /* Orders the claim on bottom before reading top, against steal */
+  atomic_thread_fence(memory_order_seq_cst);
+
+  int64_t top = atomic_load_explicit(&deque->top, memory_order_relaxed);
+
+  if (top > bottom)
+  {
+    atomic_store_explicit(&deque->bottom, bottom + 1, memory_order_relaxed);
+
+    return false;
+  }
+
+  *value = atomic_load_explicit(deque_slot(array, bottom), memory_order_relaxed);
+
+  if (top < bottom)
+    return true;
+
+  /* The last value, thieves may want it too */
+  bool won = atomic_compare_exchange_strong_explicit(&deque->top, &top, top + 1, memory_order_seq_cst,
+                                                     memory_order_relaxed);
+
+  atomic_store_explicit(&deque->bottom, bottom + 1, memory_order_relaxed);
+
+  return won;
+}
+
+Deque_Result deque_steal(Deque *deque, void **value)
+{
+  int64_t top = atomic_load_explicit(&deque->top, memory_order_acquire);
+
+  atomic_thread_fence(memory_order_seq_cst);
+
+  int64_t bottom = atomic_load_explicit(&deque->bottom, memory_order_acquire);
+
+  if (top >= bottom)
+    return DEQUE_EMPTY;
+
+  Deque_Array *array = atomic_load_explicit(&deque->array, memory_order_acquire);
+
+  void *stolen = atomic_load_explicit(deque_slot(array, top), memory_order_relaxed);
+
+  if (!atomic_compare_exchange_strong_explicit(&deque->top, &top, top + 1, memory_order_seq_cst,
+                                               memory_order_relaxed))
+    return DEQUE_ABORT;
+
+  *value = stolen;
+
+  return DEQUE_OK;
+}
+
+size_t deque_count(Deque *deque)
+{
+  int64_t bottom = atomic_load_explicit(&deque->bottom, memory_order_relaxed);
+
+  int64_t top = atomic_load_explicit(&deque->top, memory_order_relaxed);
+
+  return bottom > top ? (size_t)(bottom - top) : 0;
+}
+
+Deque *deque_create(size_t capacity)
+{
+  size_t size = 16;
+
+  while (size < capacity)
+    size *= 2;
+
+  Deque *deque = aligned_alloc(CACHE_LINE, sizeof(Deque));
+
+  atomic_init(&deque->top, 0);
+
+  atomic_init(&deque->bottom, 0);
+
+  atomic_init(&deque->array, deque_array_create(size));
+
+  return deque;
+}
+
+void deque_destroy(Deque *deque)
+{
+  Deque_Array *array = atomic_load_explicit(&deque->array, memory_order_relaxed);
+
+  while (array != NULL)
+  {
+    Deque_Array *previous = array->previous;
+
+    free(array);
+
+    array = previous;
+  }
+
+  free(deque);
+}
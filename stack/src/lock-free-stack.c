@@ -0,0 +1,272 @@
+#include <stdint.h>
+#include <stdatomic.h>
+
+#include "lock-free-stack.h"
+
+#define NONE UINT32_MAX
+
+/* How long a push waits in the elimination array for a pop to take it */
+#define ELIMINATION_SPINS 128
+
+#define CACHE_LINE 64
+
+#if defined(__x86_64__) || defined(__i386__)
+#define cpu_relax() __builtin_ia32_pause()
+#else
+#define cpu_relax() ((void)0)
+#endif
+
+typedef enum
+{
+  POP_OK,
+  POP_EMPTY,
+  POP_CONTENDED
+} Pop_Result;
+
+typedef struct Node
+{
+  _Atomic uint32_t next;
+  void *value;
+} Node;
+
+/* One per cache line so exchanges in different slots do not share one */
+typedef struct Slot
+{
+  _Alignas(CACHE_LINE) _Atomic uintptr_t offer;
+} Slot;
+
+/*
+  Both heads pack a node index in the low half and a tag in the high half.
+  The tag is bumped by every push and pop, so a head that went from node a
+  to b and back to a still fails the compare and swap
+*/
+struct Lock_Free_Stack
+{
+  _Alignas(CACHE_LINE) _Atomic uint64_t head;
+  _Alignas(CACHE_LINE) _Atomic uint64_t free;
+  Slot slots[LOCK_FREE_STACK_ELIMINATION_SLOTS];
+  Node *nodes;
+  size_t capacity;
+};
+
+/* Markers for an elimination slot, addresses no value can have */
+static const char empty_marker, taken_marker;
+
+#define EMPTY ((uintptr_t)&empty_marker)
+#define TAKEN ((uintptr_t)&taken_marker)
+
+static _Thread_local uint32_t random_state;
+
+/* Private */
+
+static uint64_t pack(uint32_t index, uint32_t tag)
+{
+  return (uint64_t)tag << 32 | index;
+}
+
+static bool try_push(_Atomic uint64_t *head, Node *nodes, uint32_t index)
+{
+  uint64_t old = atomic_load_explicit(head, memory_order_relaxed);
+
+  atomic_store_explicit(&nodes[index].next, (uint32_t)old, memory_order_relaxed);
+
+  return atomic_compare_exchange_strong_explicit(head, &old, pack(index, (uint32_t)(old >> 32) + 1),
+                                                 memory_order_release, memory_order_relaxed);
+}
+
+/*
+  The next field read here can be stale when another thread pops the node
+  first, the tag makes the compare and swap fail in that case. The node
+  itself stays valid memory, it only ever moves between the two stacks
+*/
+static Pop_Result try_pop(_Atomic uint64_t *head, Node *nodes, uint32_t *index)
+{
+  uint64_t old = atomic_load_explicit(head, memory_order_acquire);
+
+  uint32_t top = (uint32_t)old;
+
+  if (top == NONE)
+    return POP_EMPTY;
+
+  uint32_t next = atomic_load_explicit(&nodes[top].next, memory_order_relaxed);
+
+  if (!atomic_compare_exchange_strong_explicit(head, &old, pack(next, (uint32_t)(old >> 32) + 1),
+                                               memory_order_acquire, memory_order_relaxed))
+    return POP_CONTENDED;
+
+  *index = top;
+
+  return POP_OK;
+}
+
+static void push_node(_Atomic uint64_t *head, Node *nodes, uint32_t index)
+{
+  while (!try_push(head, nodes, index))
+    ;
+}
+
+static Slot *random_slot(Lock_Free_Stack *stack)
+{
+  uint32_t x = random_state;
+
+  if (x == 0)
+    x = (uint32_t)(uintptr_t)&random_state | 1;
+
+  /* xorshift32 */
+  x ^= x << 13;
+
+  x ^= x >> 17;
+
+  x ^= x << 5;
+
+  random_state = x;
+
+  return &stack->slots[x % LOCK_FREE_STACK_ELIMINATION_SLOTS];
+}
+
+/* Offers value in a slot and waits a little for a pop to take it */
+static bool eliminate_push(Lock_Free_Stack *stack, void *value)
+{
+  Slot *slot = random_slot(stack);
+
+  uintptr_t expected = EMPTY;
+
+  if (!atomic_compare_exchange_strong_explicit(&slot->offer, &expected, (uintptr_t)value, memory_order_release,
+                                               memory_order_relaxed))
+    return false;
+
+  for (int i = 0; i < ELIMINATION_SPINS; i++)
+  {
+    if (atomic_load_explicit(&slot->offer, memory_order_acquire) == TAKEN)
+    {
+      atomic_store_explicit(&slot->offer, EMPTY, memory_order_release);
+
+      return true;
+    }
+
+    cpu_relax();
+  }
+
+  expected = (uintptr_t)value;
+
+  if (atomic_compare_exchange_strong_explicit(&slot->offer, &expected, EMPTY, memory_order_acquire,
+                                              memory_order_acquire))
+    return false;
+
+  /* A pop took it while withdrawing, only the pusher clears TAKEN */
+  atomic_store_explicit(&slot->offer, EMPTY, memory_order_release);
+
+  return true;
+}
+
+static bool eliminate_pop(Lock_Free_Stack *stack, void **value)
+{
+  Slot *slot = random_slot(stack);
+
+  uintptr_t offer = atomic_load_explicit(&slot->offer, memory_order_acquire);
+
+  if (offer == EMPTY || offer == TAKEN)
+    return false;
+
+  if (!atomic_compare_exchange_strong_explicit(&slot->offer, &offer, TAKEN, memory_order_acq_rel,
+                                               memory_order_relaxed))
+    return false;
+
+  *value = (void *)offer;
+
+  return true;
+}
+
+/* Public functions */
+
+bool lock_free_stack_push(Lock_Free_Stack *stack, void *value)
+{
+  uint32_t index;
+
+  for (;;)
+  {
+    Pop_Result result = try_pop(&stack->free, stack->nodes, &index);
+
+    if (result == POP_OK)
+      break;
+
+    if (result == POP_EMPTY)
+      return false;
+  }
+
+  stack->nodes[index].value = value;
+
+  for (;;)
+  {
+    if (try_push(&stack->head, stack->nodes, index))
+      return true;
+
+    if (eliminate_push(stack, value))
+    {
+      push_node(&stack->free, stack->nodes, index);
+
+      return true;
+    }
+  }
+}
+
+bool lock_free_stack_pop(Lock_Free_Stack *stack, void **value)
+{
+  for (;;)
+  {
+    uint32_t index;
+
+    Pop_Result result = try_pop(&stack->head, stack->nodes, &index);
+
+    if (result == POP_OK)
+    {
+      *value = stack->nodes[index].value;
+
+      push_node(&stack->free, stack->nodes, index);
+
+      return true;
+    }
+
+    if (result == POP_EMPTY)
+      return false;
+
+    if (eliminate_pop(stack, value))
+      return true;
+  }
+}
+
+Lock_Free_Stack *lock_free_stack_create(size_t capacity)
+{
+  if (capacity == 0 || capacity >= NONE)
+    return NULL;
+
+  Lock_Free_Stack *stack = aligned_alloc(CACHE_LINE, sizeof(Lock_Free_Stack));
+
+  stack->nodes = malloc(sizeof(Node) * capacity);
+
+  stack->capacity = capacity;
+
+  /* Every node starts on the free stack, linked in order */
+  for (size_t i = 0; i < capacity; i++)
+  {
+    atomic_init(&stack->nodes[i].next, i + 1 < capacity ? (uint32_t)(i + 1) : NONE);
+
+    stack->nodes[i].value = NULL;
+  }
+
+  atomic_init(&stack->head, pack(NONE, 0));
+
+  atomic_init(&stack->free, pack(0, 0));
+
+  for (size_t i = 0; i < LOCK_FREE_STACK_ELIMINATION_SLOTS; i++)
+    atomic_init(&stack->slots[i].offer, EMPTY);
+
+  return stack;
+}
+
+void lock_free_stack_destroy(Lock_Free_Stack *stack)
+{
+  free(stack->nodes);
+
+  free(stack);
+}
@@ -0,0 +1,56 @@
+#include <stdio.h>
+#include <stdint.h>
+
+#include "stack.h"
+#include "vm.h"
+
+/* 10! with a loop over two locals, n and the product */
+static const Instruction factorial[] = {
+    {10, INST_PUSH},
+    {1, INST_PUSH},
+    {0, INST_LOAD},
+    {6, INST_JUMP_IF_NOT_ZERO},
+    {1, INST_LOAD},
+    {0, INST_HALT},
+    {1, INST_LOAD},
+    {0, INST_LOAD},
+    {0, INST_MULT},
+    {1, INST_STORE},
+    {0, INST_LOAD},
+    {1, INST_PUSH},
+    {0, INST_MINUS},
+    {0, INST_STORE},
+    {2, INST_JUMP},
+};
+
+int main(void)
+{
+  Stack *stack = stack_create(1024);
+
+  stack_push(stack, (int *)100);
+
+  stack_push(stack, (int *)1);
+
+  stack_print(stack);
+
+  stack_destroy(stack);
+
+  void **s = calloc(20, sizeof(void *));
+
+  s[0] = (int *)10000;
+
+  printf("%d\n", (int)(intptr_t)s[0]);
+
+  free(s);
+
+  Vm *vm = vm_create();
+
+  Vm_Status status = vm_run(vm, factorial, sizeof(factorial) / sizeof(factorial[0]));
+
+  printf("10! -> %lld (%s, %llu instructions)\n", (long long)vm_result(vm), vm_status_name(status),
+         (unsigned long long)vm_executed(vm));
+
+  vm_destroy(vm);
+
+  return 0;
+}
@@ -0,0 +1,442 @@
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+
+#include "pool.h"
+#include "deque.h"
+#include "stack.h"
+
+typedef struct Task
+{
+  Pool_Task run;
+  void *arg;
+} Task;
+
+typedef struct Worker
+{
+  pthread_t thread;
+  Pool *pool;
+  Deque *deque;
+  uint32_t random;
+} Worker;
+
+typedef struct Parallel_For
+{
+  Pool *pool;
+  Pool_Range body;
+  void *ctx;
+  size_t grain;
+  _Atomic size_t remaining;
+} Parallel_For;
+
+typedef struct Range
+{
+  Parallel_For *job;
+  size_t begin;
+  size_t end;
+} Range;
+
+/*
+  Workers that find nothing to run sleep on wake. A submit bumps epoch
+  before it looks for sleepers, and a worker reads epoch before its last
+  look for work and only sleeps if it has not moved, so a task submitted
+  in between is never missed
+*/
+struct Pool
+{
+  Worker *workers;
+  size_t count;
+  Stack *injected;
+  pthread_mutex_t injected_lock;
+  _Atomic size_t injected_count;
+  _Atomic size_t pending;
+  _Atomic uint64_t epoch;
+  _Atomic size_t sleepers;
+  _Atomic bool stop;
+  pthread_mutex_t lock;
+  pthread_cond_t wake;
+  pthread_cond_t done;
+};
+
+/* The worker running on this thread, NULL outside of any pool */
+static _Thread_local Worker *current;
+
+/* Private */
+
+static Worker *pool_worker(Pool *pool)
+{
+  return current != NULL && current->pool == pool ? current : NULL;
+}
+
+static void pool_notify(Pool *pool)
+{
+  atomic_fetch_add(&pool->epoch, 1);
+
+  if (atomic_load(&pool->sleepers) == 0)
+    return;
+
+  pthread_mutex_lock(&pool->lock);
+
+  pthread_cond_signal(&pool->wake);
+
+  pthread_mutex_unlock(&pool->lock);
+}
+
+static Task *pool_take_injected(Pool *pool)
+{
+  if (atomic_load_explicit(&pool->injected_count, memory_order_relaxed) == 0)
+    return NULL;
+
+  pthread_mutex_lock(&pool->injected_lock);
+
+  Task *task = stack_pop(pool->injected);
+
+  if (task != NULL)
+    atomic_fetch_sub_explicit(&pool->injected_count, 1, memory_order_relaxed);
+
+  pthread_mutex_unlock(&pool->injected_lock);
+
+  return task;
+}
+
+static uint32_t pool_random(Worker *worker)
+{
+  /* xorshift32 */
+  uint32_t x = worker->random;
+
+  x ^= x << 13;
+
+  x ^= x >> 17;
+
+  x ^= x << 5;
+
+  worker->random = x;
+
+  return x;
+}
+
+/* Own deque first, then the shared queue, then the other deques from a random one on */
+static Task *pool_find(Pool *pool, Worker *worker)
+{
+  void *value;
+
+  if (worker != NULL && deque_pop(worker->deque, &value))
+    return value;
+
+  Task *task = pool_take_injected(pool);
+
+  if (task != NULL)
+    return task;
+
+  size_t start = worker != NULL ? pool_random(worker) % pool->count : 0;
+
+  bool retry = true;
+
+  while (retry)
+  {
+    retry = false;
+
+    for (size_t i = 0; i < pool->count; i++)
+    {
+      Worker *victim = &pool->workers[(start + i) % pool->count];
+
+      if (victim == worker)
+        continue;
+
+      Deque_Result result = deque_steal(victim->deque, &value);
+
+      if (result == DEQUE_OK)
+        return value;
+
+      if (result == DEQUE_ABORT)
+        retry = true;
+    }
+  }
+
+  return NULL;
+}
+
+static void pool_run(Pool *pool, Task *task)
+{
+  task->run(task->arg);
+
+  free(task);
+
+  if (atomic_fetch_sub(&pool->pending, 1) == 1)
+  {
+    pthread_mutex_lock(&pool->lock);
+
+    pthread_cond_broadcast(&pool->done);
+
+    pthread_mutex_unlock(&pool->lock);
+  }
+}
+
+static void pool_sleep(Pool *pool, Worker *worker)
+{
+  atomic_fetch_add(&pool->sleepers, 1);
+
+  uint64_t epoch = atomic_load(&pool->epoch);
+
+  Task *task = pool_find(pool, worker);
+
+  if (task != NULL)
+  {
+    atomic_fetch_sub(&pool->sleepers, 1);
+
+    pool_run(pool, task);
+
+    return;
+  }
+
+  pthread_mutex_lock(&pool->lock);
+
+  if (atomic_load(&pool->epoch) == epoch && !atomic_load(&pool->stop))
+    pthread_cond_wait(&pool->wake, &pool->lock);
+
+  pthread_mutex_unlock(&pool->lock);
+
+  atomic_fetch_sub(&pool->sleepers, 1);
+}
+
+static void *pool_work(void *arg)
+{
+  Worker *worker = arg;
+
+  Pool *pool = worker->pool;
+
+  current = worker;
+
+  while (!atomic_load_explicit(&pool->stop, memory_order_relaxed))
+  {
+    Task *task = pool_find(pool, worker);
+
+    if (task != NULL)
+      pool_run(pool, task);
+    else
+      pool_sleep(pool, worker);
+  }
+
+  return NULL;
+}
+
+static void pool_range(void *arg)
+{
+  Range *range = arg;
+
+  Parallel_For *job = range->job;
+
+  size_t begin = range->begin;
+
+  size_t end = range->end;
+
+  free(range);
+
+  /* Keeps the lower half, the upper one is up for stealing */
+  while (end - begin > job->grain)
+  {
+    size_t middle = begin + (end - begin) / 2;
+
+    Range *upper = malloc(sizeof(Range));
+
+    *upper = (Range){job, middle, end};
+
+    pool_submit(job->pool, pool_range, upper);
+
+    end = middle;
+  }
+
+  job->body(job->ctx, begin, end);
+
+  /* The last touch of job, the caller may return once it reaches 0 */
+  atomic_fetch_sub(&job->remaining, end - begin);
+}
+
+/* Public functions */
+
+void pool_submit(Pool *pool, Pool_Task run, void *arg)
+{
+  Task *task = malloc(sizeof(Task));
+
+  *task = (Task){run, arg};
+
+  atomic_fetch_add(&pool->pending, 1);
+
+  Worker *worker = pool_worker(pool);
+
+  if (worker != NULL)
+    deque_push(worker->deque, task);
+  else
+  {
+    pthread_mutex_lock(&pool->injected_lock);
+
+    stack_push(pool->injected, task);
+
+    atomic_fetch_add_explicit(&pool->injected_count, 1, memory_order_relaxed);
+
+    pthread_mutex_unlock(&pool->injected_lock);
+  }
+
+  pool_notify(pool);
+}
+
+void pool_wait(Pool *pool)
+{
+  while (atomic_load(&pool->pending) > 0)
+  {
+    Task *task = pool_find(pool, NULL);
+
+    if (task != NULL)
+    {
+      pool_run(pool, task);
+
+      continue;
+    }
+
+    pthread_mutex_lock(&pool->lock);
+
+    while (atomic_load(&pool->pending) > 0)
+      pthread_cond_wait(&pool->done, &pool->lock);
+
+    pthread_mutex_unlock(&pool->lock);
+  }
+}
+
+void pool_parallel_for(Pool *pool, size_t begin, size_t end, size_t grain, Pool_Range body, void *ctx)
+{
+  if (begin >= end)
+    return;
+
+  if (grain == 0)
+    grain = (end - begin) / (pool->count * 8);
+
+  if (grain == 0)
+    grain = 1;
+
+  Parallel_For job = {pool, body, ctx, grain, end - begin};
+
+  Worker *worker = pool_worker(pool);
+
+  while (end - begin > grain)
+  {
+    size_t middle = begin + (end - begin) / 2;
+
+    Range *upper = malloc(sizeof(Range));
+
+    *upper = (Range){&job, middle, end};
+
+    pool_submit(pool, pool_range, upper);
+
+    end = middle;
+  }
+
+  body(ctx, begin, end);
+
+  atomic_fetch_sub(&job.remaining, end - begin);
+
+  /* Helps with whatever is queued, most likely the rest of this range */
+  while (atomic_load(&job.remaining) > 0)
+  {
+    Task *task = pool_find(pool, worker);
+
+    if (task != NULL)
+      pool_run(pool, task);
+    else
+      sched_yield();
+  }
+}
+
+size_t pool_threads(Pool *pool)
+{
+  return pool->count;
+}
+
+Pool *pool_create(size_t threads)
+{
+  if (threads == 0)
+  {
+    long cores = sysconf(_SC_NPROCESSORS_ONLN);
+
+    threads = cores > 0 ? (size_t)cores : 1;
+  }
+
+  Pool *pool = malloc(sizeof(Pool));
+
+  pool->workers = calloc(threads, sizeof(Worker));
+
+  pool->count = threads;
+
+  pool->injected = stack_create(64);
+
+  pthread_mutex_init(&pool->injected_lock, NULL);
+
+  atomic_init(&pool->injected_count, 0);
+
+  atomic_init(&pool->pending, 0);
+
+  atomic_init(&pool->epoch, 0);
+
+  atomic_init(&pool->sleepers, 0);
+
+  atomic_init(&pool->stop, false);
+
+  pthread_mutex_init(&pool->lock, NULL);
+
+  pthread_cond_init(&pool->wake, NULL);
+
+  pthread_cond_init(&pool->done, NULL);
+
+  for (size_t i = 0; i < threads; i++)
+  {
+    Worker *worker = &pool->workers[i];
+
+    worker->pool = pool;
+
+    worker->deque = deque_create(256);
+
+    worker->random = (uint32_t)(i * 2654435761u) | 1;
+  }
+
+  /* All deques exist before any worker starts stealing */
+  for (size_t i = 0; i < threads; i++)
+    pthread_create(&pool->workers[i].thread, NULL, pool_work, &pool->workers[i]);
+
+  return pool;
+}
+
+void pool_destroy(Pool *pool)
+{
+  pool_wait(pool);
+
+  pthread_mutex_lock(&pool->lock);
+
+  atomic_store(&pool->stop, true);
+
+  pthread_cond_broadcast(&pool->wake);
+
+  pthread_mutex_unlock(&pool->lock);
+
+  /* Every worker is gone before any deque, the others may still steal from it */
+  for (size_t i = 0; i < pool->count; i++)
+    pthread_join(pool->workers[i].thread, NULL);
+
+  for (size_t i = 0; i < pool->count; i++)
+    deque_destroy(pool->workers[i].deque);
+
+  stack_destroy(pool->injected);
+
+  pthread_mutex_destroy(&pool->injected_lock);
+
+  pthread_mutex_destroy(&pool->lock);
+
+  pthread_cond_destroy(&pool->wake);
+
+  pthread_cond_destroy(&pool->done);
+
+  free(pool->workers);
+
+  free(pool);
+}
@@ -1,17 +1,12 @@
 #include "stack.h"
 #include <stdio.h>
+#include <stdint.h>
 
 struct Stack
 {
   size_t size;
   size_t count;
-  float load_factor;
-  Entry **elements;
-};
-
-struct Entry
-{
-  void *value;
+  Entry *elements;
 };
 
 static void stack_resize(Stack *stack, size_t new_size)
@@ -19,63 +14,33 @@ static void stack_resize(Stack *stack, size_t new_size)
   if (stack == NULL)
     return;
 
-  size_t index = 0;
-
-  Entry **newElements = calloc(new_size, sizeof(Entry));
-
-  while (index <= stack->size)
-  {
-    Entry *e = stack->elements[index];
-
-    if (e != NULL)
-      newElements[index] = e;
-
-    index++;
-  }
-
-  free(stack->elements);
+  stack->elements = realloc(stack->elements, sizeof(Entry) * new_size);
 
   stack->size = new_size;
-
-  stack->elements = newElements;
 }
 
 void stack_push(Stack *stack, void *value)
 {
-  if (stack->size * stack->load_factor < stack->count + 1)
-  {
-    stack_resize(stack, stack->size * 2);
-  }
+  if (stack->count == stack->size)
+    stack_resize(stack, stack->size ? stack->size * 2 : 1);
 
   stack->elements[stack->count++] = value;
 }
 
 void *stack_pop(Stack *stack)
 {
-  if (stack->size == 0)
+  if (stack->count == 0)
     return NULL;
 
-  Entry *e = stack->elements[stack->size - 1];
-
-  if (e == NULL)
-    return NULL;
-
-  stack->size--;
-
-  return e;
+  return stack->elements[--stack->count];
 }
 
 void *stack_peek(Stack *stack)
 {
-  if (stack->size == 0)
+  if (stack->count == 0)
     return NULL;
 
-  Entry *e = stack->elements[stack->size - 1];
-
-  if (e == NULL)
-    return NULL;
-
-  return e;
+  return stack->elements[stack->count - 1];
 }
 
 void stack_print(Stack *stack)
@@ -88,7 +53,7 @@ void stack_print(Stack *stack)
 
   for (size_t i = 0; i < stack->count; i++)
   {
-    printf("Entry: %lld\n", stack->elements[i]);
+    printf("Entry: %lld\n", (long long)(intptr_t)stack->elements[i]);
   }
 
   printf("-------------\n\n");
@@ -106,41 +71,7 @@ Stack *stack_create(size_t size)
 
   stack->size = size;
   stack->count = 0;
-  stack->load_factor = 0.75;
-  stack->elements = calloc(size, sizeof(Entry));
+  stack->elements = malloc(sizeof(Entry) * size);
 
   return stack;
 }
-
-typedef enum
-{
-  INST_PUSH,
-  INST_PLUS
-} Instruction_Type;
-
-typedef struct Instruction
-{
-  uint64_t operand;
-  Instruction_Type type;
-} Instruction;
-
-int main(void)
-{
-  Stack *stack = stack_create(1024);
-
-  stack_push(stack, (int *)100);
-
-  stack_push(stack, (int *)1);
-
-  stack_print(stack);
-
-  stack_destroy(stack);
-
-  void **s = calloc(20, sizeof(void *));
-
-  s[0] = (int *)10000;
-
-  printf("%d\n", s[0]);
-
-  return 0;
-}
\ No newline at end of file
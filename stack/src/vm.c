@@ -0,0 +1,504 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "vm.h"
+
+/*
+  The dispatch loop is direct threaded where the compiler has labels as
+  values: code is first translated into an array that holds the address of
+  the handler of every instruction, and each handler ends in a jump to the
+  handler of the next one. There is no central switch, so every handler
+  gets its own indirect branch to predict. Build with -DVM_SWITCH_DISPATCH
+  for the plain switch loop to compare against.
+*/
+
+#if defined(__GNUC__) && !defined(VM_SWITCH_DISPATCH)
+#define VM_THREADED
+#endif
+
+typedef struct Threaded
+{
+  const void *label;
+  int64_t operand;
+  Instruction_Type type;
+} Threaded;
+
+typedef struct Frame
+{
+  const Threaded *ret;
+  int64_t *fp;
+} Frame;
+
+struct Vm
+{
+  int64_t stack[VM_STACK_SIZE];
+  Frame frames[VM_CALL_DEPTH];
+  size_t count;
+  uint64_t executed;
+};
+
+static bool is_jump(Instruction_Type type)
+{
+  return type == INST_JUMP || type == INST_JUMP_IF_ZERO || type == INST_JUMP_IF_NOT_ZERO || type == INST_CALL;
+}
+
+/*
+  Plain braces instead of do while (0), a continue inside one would not
+  reach the switch loop
+*/
+#ifdef VM_THREADED
+
+#define CASE(type) op_##type:
+
+#define DISPATCH()   \
+  {                  \
+    executed++;      \
+                     \
+    goto *ip->label; \
+  }
+
+#else
+
+#define CASE(type) case type:
+
+#define DISPATCH() continue
+
+#endif
+
+#define NEXT()  \
+  {             \
+    ip++;       \
+                \
+    DISPATCH(); \
+  }
+
+#define JUMP(target) \
+  {                  \
+    ip = (target);   \
+                     \
+    DISPATCH();      \
+  }
+
+#define FAIL(error)   \
+  do                  \
+  {                   \
+    status = (error); \
+                      \
+    goto done;        \
+  } while (0)
+
+#define NEED(n)             \
+  if (sp - vm->stack < (n)) \
+  FAIL(VM_STACK_UNDERFLOW)
+
+#define ROOM(n)                             \
+  if (sp + (n) > vm->stack + VM_STACK_SIZE) \
+  FAIL(VM_STACK_OVERFLOW)
+
+/* Wraps around like the hardware does, signed overflow is undefined in C */
+#define BINARY(type, expr)    \
+  CASE(type)                  \
+  {                           \
+    NEED(2);                  \
+                              \
+    int64_t b = *--sp;        \
+                              \
+    int64_t a = sp[-1];       \
+                              \
+    sp[-1] = (int64_t)(expr); \
+                              \
+    NEXT();                   \
+  }
+
+Vm_Status vm_run(Vm *vm, const Instruction *code, size_t count)
+{
+#ifdef VM_THREADED
+  static const void *labels[INST_COUNT] = {
+      [INST_PUSH] = &&op_INST_PUSH,
+      [INST_PLUS] = &&op_INST_PLUS,
+      [INST_MINUS] = &&op_INST_MINUS,
+      [INST_MULT] = &&op_INST_MULT,
+      [INST_DIV] = &&op_INST_DIV,
+      [INST_MOD] = &&op_INST_MOD,
+      [INST_NEG] = &&op_INST_NEG,
+      [INST_AND] = &&op_INST_AND,
+      [INST_OR] = &&op_INST_OR,
+      [INST_XOR] = &&op_INST_XOR,
+      [INST_NOT] = &&op_INST_NOT,
+      [INST_SHL] = &&op_INST_SHL,
+      [INST_SHR] = &&op_INST_SHR,
+      [INST_EQ] = &&op_INST_EQ,
+      [INST_NE] = &&op_INST_NE,
+      [INST_LT] = &&op_INST_LT,
+      [INST_LE] = &&op_INST_LE,
+      [INST_GT] = &&op_INST_GT,
+      [INST_GE] = &&op_INST_GE,
+      [INST_POP] = &&op_INST_POP,
+      [INST_DUP] = &&op_INST_DUP,
+      [INST_SWAP] = &&op_INST_SWAP,
+      [INST_OVER] = &&op_INST_OVER,
+      [INST_LOAD] = &&op_INST_LOAD,
+      [INST_STORE] = &&op_INST_STORE,
+      [INST_JUMP] = &&op_INST_JUMP,
+      [INST_JUMP_IF_ZERO] = &&op_INST_JUMP_IF_ZERO,
+      [INST_JUMP_IF_NOT_ZERO] = &&op_INST_JUMP_IF_NOT_ZERO,
+      [INST_CALL] = &&op_INST_CALL,
+      [INST_RET] = &&op_INST_RET,
+      [INST_PRINT] = &&op_INST_PRINT,
+      [INST_HALT] = &&op_INST_HALT,
+  };
+#endif
+
+  Vm_Status status = VM_OK;
+
+  uint64_t executed = 0;
+
+  int64_t *sp = vm->stack;
+
+  int64_t *fp = vm->stack;
+
+  size_t depth = 0;
+
+  /* One extra HALT so running off the end needs no check */
+  Threaded *program = malloc(sizeof(Threaded) * (count + 1));
+
+  const Threaded *ip = program;
+
+  for (size_t i = 0; i <= count; i++)
+  {
+    Instruction inst = i < count ? code[i] : (Instruction){0, INST_HALT};
+
+    if ((unsigned)inst.type >= INST_COUNT)
+      FAIL(VM_BAD_INSTRUCTION);
+
+    if (is_jump(inst.type) && (inst.operand < 0 || (uint64_t)inst.operand > count))
+      FAIL(VM_BAD_JUMP);
+
+    /* A negative count would put the result above the top of the stack */
+    if (inst.type == INST_RET && inst.operand < 0)
+      FAIL(VM_BAD_INSTRUCTION);
+
+#ifdef VM_THREADED
+    program[i].label = labels[inst.type];
+#endif
+
+    program[i].operand = inst.operand;
+
+    program[i].type = inst.type;
+  }
+
+#ifdef VM_THREADED
+  DISPATCH();
+#else
+  for (;;)
+  {
+    executed++;
+
+    switch (ip->type)
+    {
+#endif
+
+  CASE(INST_PUSH)
+  {
+    ROOM(1);
+
+    *sp++ = ip->operand;
+
+    NEXT();
+  }
+
+  BINARY(INST_PLUS, (uint64_t)a + (uint64_t)b)
+
+  BINARY(INST_MINUS, (uint64_t)a - (uint64_t)b)
+
+  BINARY(INST_MULT, (uint64_t)a * (uint64_t)b)
+
+  CASE(INST_DIV)
+  CASE(INST_MOD)
+  {
+    NEED(2);
+
+    int64_t b = *--sp;
+
+    int64_t a = sp[-1];
+
+    if (b == 0)
+      FAIL(VM_DIVISION_BY_ZERO);
+
+    /* INT64_MIN / -1 traps on x86, the wrapped results are INT64_MIN and 0 */
+    if (b == -1)
+      sp[-1] = ip->type == INST_DIV ? (int64_t)(0 - (uint64_t)a) : 0;
+    else
+      sp[-1] = ip->type == INST_DIV ? a / b : a % b;
+
+    NEXT();
+  }
+
+  CASE(INST_NEG)
+  {
+    NEED(1);
+
+    sp[-1] = (int64_t)(0 - (uint64_t)sp[-1]);
+
+    NEXT();
+  }
+
+  BINARY(INST_AND, a & b)
+
+  BINARY(INST_OR, a | b)
+
+  BINARY(INST_XOR, a ^ b)
+
+  CASE(INST_NOT)
+  {
+    NEED(1);
+
+    sp[-1] = !sp[-1];
+
+    NEXT();
+  }
+
+  BINARY(INST_SHL, (uint64_t)a << (b & 63))
+
+  BINARY(INST_SHR, a >> (b & 63))
+
+  BINARY(INST_EQ, a == b)
+
+  BINARY(INST_NE, a != b)
+
+  BINARY(INST_LT, a < b)
+
+  BINARY(INST_LE, a <= b)
+
+  BINARY(INST_GT, a > b)
+
+  BINARY(INST_GE, a >= b)
+
+  CASE(INST_POP)
+  {
+    NEED(1);
+
+    sp--;
+
+    NEXT();
+  }
+
+  CASE(INST_DUP)
+  {
+    NEED(1);
+
+    ROOM(1);
+
+    *sp = sp[-1];
+
+    sp++;
+
+    NEXT();
+  }
+
+  CASE(INST_SWAP)
+  {
+    NEED(2);
+
+    int64_t top = sp[-1];
+
+    sp[-1] = sp[-2];
+
+    sp[-2] = top;
+
+    NEXT();
+  }
+
+  CASE(INST_OVER)
+  {
+    NEED(2);
+
+    ROOM(1);
+
+    *sp = sp[-2];
+
+    sp++;
+
+    NEXT();
+  }
+
+  CASE(INST_LOAD)
+  {
+    /* Checked as an integer, forming a pointer outside the stack is already undefined */
+    if (ip->operand < -(fp - vm->stack) || ip->operand >= sp - fp)
+      FAIL(VM_BAD_SLOT);
+
+    ROOM(1);
+
+    *sp++ = fp[ip->operand];
+
+    NEXT();
+  }
+
+  CASE(INST_STORE)
+  {
+    NEED(1);
+
+    if (ip->operand < -(fp - vm->stack) || ip->operand >= sp - 1 - fp)
+      FAIL(VM_BAD_SLOT);
+
+    int64_t value = *--sp;
+
+    fp[ip->operand] = value;
+
+    NEXT();
+  }
+
+  CASE(INST_JUMP)
+  {
+    JUMP(program + ip->operand);
+  }
+
+  CASE(INST_JUMP_IF_ZERO)
+  {
+    NEED(1);
+
+    if (*--sp == 0)
+      JUMP(program + ip->operand);
+
+    NEXT();
+  }
+
+  CASE(INST_JUMP_IF_NOT_ZERO)
+  {
+    NEED(1);
+
+    if (*--sp != 0)
+      JUMP(program + ip->operand);
+
+    NEXT();
+  }
+
+  CASE(INST_CALL)
+  {
+    if (depth == VM_CALL_DEPTH)
+      FAIL(VM_CALL_OVERFLOW);
+
+    vm->frames[depth++] = (Frame){ip + 1, fp};
+
+    fp = sp;
+
+    JUMP(program + ip->operand);
+  }
+
+  CASE(INST_RET)
+  {
+    NEED(1);
+
+    int64_t result = *--sp;
+
+    /* Returning from the outermost frame ends the program */
+    if (depth == 0)
+    {
+      *sp++ = result;
+
+      goto done;
+    }
+
+    /* Compared before subtracting, a huge count must not wrap the pointer */
+    if (ip->operand > fp - vm->stack)
+      FAIL(VM_STACK_UNDERFLOW);
+
+    int64_t *base = fp - ip->operand;
+
+    sp = base;
+
+    *sp++ = result;
+
+    Frame *frame = &vm->frames[--depth];
+
+    fp = frame->fp;
+
+    JUMP(frame->ret);
+  }
+
+  CASE(INST_PRINT)
+  {
+    NEED(1);
+
+    printf("%lld\n", (long long)*--sp);
+
+    NEXT();
+  }
+
+  CASE(INST_HALT)
+  {
+    goto done;
+  }
+
+#ifndef VM_THREADED
+  default:
+    FAIL(VM_BAD_INSTRUCTION);
+    }
+  }
+#endif
+
+done:
+  vm->count = (size_t)(sp - vm->stack);
+
+  vm->executed = executed;
+
+  free(program);
+
+  return status;
+}
+
+Vm *vm_create(void)
+{
+  Vm *vm = malloc(sizeof(Vm));
+
+  vm->count = 0;
+
+  vm->executed = 0;
+
+  return vm;
+}
+
+int64_t vm_result(Vm *vm)
+{
+  if (vm->count == 0)
+    return 0;
+
+  return vm->stack[vm->count - 1];
+}
+
+uint64_t vm_executed(Vm *vm)
+{
+  return vm->executed;
+}
+
+const char *vm_status_name(Vm_Status status)
+{
+  switch (status)
+  {
+  case VM_OK:
+    return "ok";
+  case VM_STACK_OVERFLOW:
+    return "stack overflow";
+  case VM_STACK_UNDERFLOW:
+    return "stack underflow";
+  case VM_CALL_OVERFLOW:
+    return "call stack overflow";
+  case VM_DIVISION_BY_ZERO:
+    return "division by zero";
+  case VM_BAD_INSTRUCTION:
+    return "bad instruction";
+  case VM_BAD_JUMP:
+    return "jump out of the program";
+  case VM_BAD_SLOT:
+    return "load or store outside the stack";
+  }
+
+  return "unknown";
+}
+
+void vm_destroy(Vm *vm)
+{
+  free(vm);
+}